@@ -0,0 +1,170 @@
+/**
+ * Arduino.h
+ * Mock Arduino HAL for building the MorseKeyer firmware on the host
+ *
+ * Provides just enough of the Arduino core for the keyer to compile with g++:
+ * a simulated clock, scripted pin levels that fire attached interrupts, a
+ * periodic timer standing in for the board's keyer tick, and a Serial that
+ * captures output and feeds queued input.
+ *
+ * Time only moves when the test driver calls hostAdvanceMicros() (or the
+ * firmware calls delay()). Interrupts run synchronously from there and from
+ * hostSetPin(), never while firmware code is running, so noInterrupts() has
+ * nothing to guard against.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define LED_BUILTIN 13
+#define HOST_PIN_COUNT 64
+
+#define digitalPinToInterrupt(pin) (pin)
+
+typedef uint8_t byte;
+
+// Program memory - the host has a single address space
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+
+// Flash strings - F() only tags the pointer, as on the ESP32
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+// Clock
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Pins
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t level);
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// Serial
+
+class HostSerial {
+public:
+  void begin(unsigned long baud) { baudRate = baud; }
+  operator bool() const { return true; }
+
+  int available() const { return (int)(input.size() - readIndex); }
+  int read();
+  int availableForWrite() const { return writeSpace; }
+
+  size_t write(uint8_t byte) { return write(&byte, 1); }
+  size_t write(const uint8_t *data, size_t length);
+
+  size_t print(const char *text) { output.append(text); return 0; }
+  size_t print(char c) { output.push_back(c); return 1; }
+  size_t print(unsigned char value) { return printNumber(value); }
+  size_t print(int value) { return value < 0 ? print('-') + printNumber(-(long)value) : printNumber(value); }
+  size_t print(unsigned int value) { return printNumber(value); }
+  size_t print(long value) { return value < 0 ? print('-') + printNumber(-value) : printNumber(value); }
+  size_t print(unsigned long value) { return printNumber(value); }
+
+  size_t println() { output.append("\r\n"); return 2; }
+  template <class T>
+  size_t println(T value) { size_t n = print(value); return n + println(); }
+
+  // Host side
+
+  unsigned long baudRate;
+  std::string output;           // Everything the firmware has written
+  std::string input;            // Bytes queued for the firmware to read
+  size_t readIndex;
+  int writeSpace;               // What availableForWrite() reports, used up by writes
+
+  void reset();
+
+private:
+  size_t printNumber(unsigned long value);
+};
+
+extern HostSerial Serial;
+
+// Host simulation controls
+
+/**
+ * Put the simulated board back to power-on: time 0, pins floating HIGH,
+ * no interrupts, no timer and empty serial buffers
+ */
+void hostReset();
+
+/**
+ * Drive an input pin. Fires the attached interrupt if the level changes.
+ */
+void hostSetPin(uint8_t pin, uint8_t level);
+
+/**
+ * Level last written to an output pin, or the level driven onto an input
+ */
+uint8_t hostPinLevel(uint8_t pin);
+
+/**
+ * A level change written to an output pin
+ */
+struct HostPinChange {
+  uint8_t pin;
+  uint8_t level;
+  uint64_t micros;
+};
+
+/**
+ * Output pin level changes since hostReset(), oldest first
+ */
+const std::vector<HostPinChange> &hostPinChanges();
+
+/**
+ * Call handler every periodMicros of simulated time, like a hardware timer
+ */
+void hostAttachTimer(void (*handler)(), uint32_t periodMicros);
+
+/**
+ * Stop or restart the timer, as a sleeping board's clocks do. A restarted
+ * timer next fires a whole period later.
+ */
+void hostPauseTimer(bool paused);
+
+/**
+ * Drive an input pin at a later simulated time, as hostSetPin() would then
+ */
+void hostSchedulePin(uint8_t pin, uint8_t level, uint64_t atMicros);
+
+/**
+ * Move simulated time forward, running any timer interrupts and scheduled
+ * pin changes that fall due, in time order
+ */
+void hostAdvanceMicros(uint32_t us);
+
+/**
+ * Simulated time as a 64-bit count, immune to the 32-bit micros() wrap
+ */
+uint64_t hostMicros64();
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,180 @@
+/**
+ * HostArduino.cpp
+ * State and simulation for the mock Arduino HAL
+ */
+
+#include "Arduino.h"
+
+HostSerial Serial;
+
+namespace {
+
+uint64_t nowMicros = 0;
+
+uint8_t pinLevels[HOST_PIN_COUNT];
+uint8_t pinModes[HOST_PIN_COUNT];
+void (*pinHandlers[HOST_PIN_COUNT])();
+int pinHandlerModes[HOST_PIN_COUNT];
+
+std::vector<HostPinChange> pinChanges;
+std::vector<HostPinChange> scheduledPins;  // Input changes to come, soonest first
+
+void (*timerHandler)() = 0;
+uint32_t timerPeriod = 0;
+uint64_t timerNext = 0;
+bool timerPaused = false;
+
+} // namespace
+
+unsigned long millis() {
+  return (unsigned long)(uint32_t)(nowMicros / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)(uint32_t)nowMicros;
+}
+
+void delay(unsigned long ms) {
+  hostAdvanceMicros(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  hostAdvanceMicros(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  pinModes[pin] = mode;
+  if (mode == INPUT_PULLUP) {
+    pinLevels[pin] = HIGH;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pinLevels[pin];
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  level = level ? HIGH : LOW;
+  if (pinModes[pin] == OUTPUT && pinLevels[pin] != level) {
+    HostPinChange change = { pin, level, nowMicros };
+    pinChanges.push_back(change);
+  }
+  pinLevels[pin] = level;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode) {
+  pinHandlers[interrupt] = handler;
+  pinHandlerModes[interrupt] = mode;
+}
+
+void detachInterrupt(uint8_t interrupt) {
+  pinHandlers[interrupt] = 0;
+}
+
+int HostSerial::read() {
+  if (readIndex >= input.size()) {
+    return -1;
+  }
+  return (uint8_t)input[readIndex++];
+}
+
+size_t HostSerial::write(const uint8_t *data, size_t length) {
+  output.append((const char *)data, length);
+  writeSpace = (size_t)writeSpace > length ? writeSpace - (int)length : 0;
+  return length;
+}
+
+size_t HostSerial::printNumber(unsigned long value) {
+  std::string digits = std::to_string(value);
+  output.append(digits);
+  return digits.size();
+}
+
+void HostSerial::reset() {
+  baudRate = 0;
+  output.clear();
+  input.clear();
+  readIndex = 0;
+  writeSpace = 1 << 30;
+}
+
+void hostReset() {
+  nowMicros = 0;
+  for (int pin = 0; pin < HOST_PIN_COUNT; pin++) {
+    pinLevels[pin] = HIGH;
+    pinModes[pin] = INPUT;
+    pinHandlers[pin] = 0;
+  }
+  pinChanges.clear();
+  scheduledPins.clear();
+  timerHandler = 0;
+  timerPaused = false;
+  Serial.reset();
+}
+
+void hostSetPin(uint8_t pin, uint8_t level) {
+  level = level ? HIGH : LOW;
+  if (pinLevels[pin] == level) {
+    return;
+  }
+  pinLevels[pin] = level;
+
+  void (*handler)() = pinHandlers[pin];
+  int mode = pinHandlerModes[pin];
+  if (handler && (mode == CHANGE || (mode == RISING && level == HIGH) || (mode == FALLING && level == LOW))) {
+    handler();
+  }
+}
+
+uint8_t hostPinLevel(uint8_t pin) {
+  return pinLevels[pin];
+}
+
+void hostAttachTimer(void (*handler)(), uint32_t periodMicros) {
+  timerHandler = handler;
+  timerPeriod = periodMicros;
+  timerNext = nowMicros + periodMicros;
+}
+
+void hostPauseTimer(bool paused) {
+  timerPaused = paused;
+  timerNext = nowMicros + timerPeriod;
+}
+
+void hostSchedulePin(uint8_t pin, uint8_t level, uint64_t atMicros) {
+  HostPinChange change = { pin, level, atMicros };
+  std::vector<HostPinChange>::iterator position = scheduledPins.begin();
+  while (position != scheduledPins.end() && position->micros <= atMicros) {
+    ++position;
+  }
+  scheduledPins.insert(position, change);
+}
+
+void hostAdvanceMicros(uint32_t us) {
+  uint64_t target = nowMicros + us;
+  for (;;) {
+    bool timerDue = timerHandler && !timerPaused && timerNext <= target;
+    bool pinDue = !scheduledPins.empty() && scheduledPins.front().micros <= target;
+    if (pinDue && (!timerDue || scheduledPins.front().micros <= timerNext)) {
+      HostPinChange change = scheduledPins.front();
+      scheduledPins.erase(scheduledPins.begin());
+      nowMicros = change.micros > nowMicros ? change.micros : nowMicros;
+      hostSetPin(change.pin, change.level);
+    } else if (timerDue) {
+      nowMicros = timerNext;
+      timerNext += timerPeriod;
+      timerHandler();
+    } else {
+      break;
+    }
+  }
+  nowMicros = target;
+}
+
+const std::vector<HostPinChange> &hostPinChanges() {
+  return pinChanges;
+}
+
+uint64_t hostMicros64() {
+  return nowMicros;
+}
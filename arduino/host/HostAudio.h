@@ -0,0 +1,169 @@
+/**
+ * HostAudio.h
+ * Receiver audio for host tests of the tone decoder
+ *
+ * Audio is held as 12-bit ADC readings around a half-scale bias, as the
+ * board's ADC would read a receiver's output, so it can go straight into a
+ * ToneDetector or KeyerSim::playAudio(). It comes from a WAV file or is
+ * made up from a keying pattern.
+ */
+
+#ifndef HOST_AUDIO_H
+#define HOST_AUDIO_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+struct AudioClip {
+  uint32_t sampleHz;
+  std::vector<int16_t> samples;  // 0..4095 around ADC_BIAS
+};
+
+const int16_t ADC_BIAS = 2048;
+
+/**
+ * A key-down in made-up audio, in samples from the start
+ */
+struct AudioKeyDown {
+  uint64_t start;
+  uint64_t end;
+};
+
+inline uint32_t readLittleEndian(const uint8_t *bytes, int count) {
+  uint32_t value = 0;
+  for (int i = count - 1; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+/**
+ * Load a PCM WAV file, 8 or 16 bits, taking the first channel
+ * @return false, with a message on stderr, if it cannot be read
+ */
+inline bool loadWav(const char *path, AudioClip &clip) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return false;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t buffer[4096];
+  size_t got;
+  while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + got);
+  }
+  fclose(file);
+
+  if (bytes.size() < 12 || std::string(bytes.begin(), bytes.begin() + 4) != "RIFF" ||
+      std::string(bytes.begin() + 8, bytes.begin() + 12) != "WAVE") {
+    fprintf(stderr, "%s: not a WAV file\n", path);
+    return false;
+  }
+
+  uint16_t channels = 0;
+  uint16_t bits = 0;
+  clip.sampleHz = 0;
+  clip.samples.clear();
+  size_t chunk = 12;
+  while (chunk + 8 <= bytes.size()) {
+    std::string id(bytes.begin() + chunk, bytes.begin() + chunk + 4);
+    size_t size = readLittleEndian(&bytes[chunk + 4], 4);
+    size_t body = chunk + 8;
+    if (size > bytes.size() - body) {
+      size = bytes.size() - body;
+    }
+    if (id == "fmt " && size >= 16) {
+      if (readLittleEndian(&bytes[body], 2) != 1) {
+        fprintf(stderr, "%s: only PCM WAV files are supported\n", path);
+        return false;
+      }
+      channels = readLittleEndian(&bytes[body + 2], 2);
+      clip.sampleHz = readLittleEndian(&bytes[body + 4], 4);
+      bits = readLittleEndian(&bytes[body + 14], 2);
+    } else if (id == "data" && channels != 0) {
+      size_t frameBytes = channels * (bits / 8);
+      for (size_t at = body; frameBytes != 0 && at + frameBytes <= body + size; at += frameBytes) {
+        int32_t value = bits == 8 ? ((int32_t)bytes[at] - 128) << 8 : (int16_t)readLittleEndian(&bytes[at], 2);
+        clip.samples.push_back((int16_t)(ADC_BIAS + (value >> 4)));
+      }
+    }
+    chunk = body + size + (size & 1);
+  }
+
+  if ((bits != 8 && bits != 16) || clip.sampleHz == 0) {
+    fprintf(stderr, "%s: need 8 or 16-bit PCM\n", path);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Audio keying a pattern of '.' and '-', with ' ' between characters and
+ * '/' between words, at PARIS timing. Each element rises and falls over
+ * 5ms, like a transmitter's shaped keying.
+ *
+ * @param amplitude Tone peak in ADC counts
+ * @param noise Peak of the white noise added, in ADC counts
+ * @param keyDowns If given, receives where each element starts and ends
+ */
+inline AudioClip keyedTone(const std::string &pattern, uint8_t wpm, uint16_t hz, int amplitude, int noise,
+                           std::vector<AudioKeyDown> *keyDowns = 0, uint32_t sampleHz = 8000) {
+  AudioClip clip;
+  clip.sampleHz = sampleHz;
+  const uint64_t unit = sampleHz * 1200ULL / wpm / 1000;
+  const uint64_t ramp = sampleHz * 5 / 1000;
+  const double pi = 3.14159265358979323846;
+
+  // Key-downs first, a unit apart within a character
+  std::vector<AudioKeyDown> downs;
+  uint64_t at = 10 * unit;
+  for (size_t i = 0; i < pattern.size(); i++) {
+    char c = pattern[i];
+    if (c == '.' || c == '-') {
+      AudioKeyDown down = { at, at + (c == '.' ? unit : 3 * unit) };
+      downs.push_back(down);
+      at = down.end + unit;
+    } else if (c == ' ') {
+      at += 2 * unit;
+    } else if (c == '/') {
+      at += 6 * unit;
+    }
+  }
+  clip.samples.assign(at + 10 * unit, ADC_BIAS);
+
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < clip.samples.size(); i++) {
+    seed = seed * 1103515245 + 12345;
+    double value = noise * (((seed >> 8) & 0xFFFF) / 32768.0 - 1.0);
+    for (size_t d = 0; d < downs.size(); d++) {
+      if (i < downs[d].start || i >= downs[d].end + ramp) {
+        continue;
+      }
+      double envelope = 1.0;
+      if (i < downs[d].start + ramp) {
+        envelope = 0.5 - 0.5 * cos(pi * (i - downs[d].start) / ramp);
+      } else if (i >= downs[d].end) {
+        envelope = 0.5 + 0.5 * cos(pi * (i - downs[d].end) / ramp);
+      }
+      value += envelope * amplitude * sin(2 * pi * hz * i / sampleHz);
+    }
+    clip.samples[i] = (int16_t)(ADC_BIAS + lround(value));
+  }
+
+  // The ramps are centred on the nominal edges, half in and half out
+  for (size_t d = 0; d < downs.size(); d++) {
+    downs[d].start += ramp / 2;
+    downs[d].end += ramp / 2;
+  }
+  if (keyDowns) {
+    *keyDowns = downs;
+  }
+  return clip;
+}
+
+#endif // HOST_AUDIO_H
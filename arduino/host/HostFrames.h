@@ -0,0 +1,161 @@
+/**
+ * HostFrames.h
+ * Host-side view of the MorseKeyer binary protocol for the host tools
+ *
+ * Encodes commands the way the app does and decodes the device's frames,
+ * reusing the firmware's own constants and CRC from KeyProtocol.h.
+ */
+
+#ifndef HOST_FRAMES_H
+#define HOST_FRAMES_H
+
+#include <string>
+#include <vector>
+
+#include <KeyProtocol.h>
+
+/**
+ * One decoded device frame, CRC already checked and stripped
+ */
+struct DeviceFrame {
+  uint8_t type;
+  std::vector<uint8_t> body;
+
+  uint8_t u8(size_t offset) const {
+    return offset < body.size() ? body[offset] : 0;
+  }
+
+  uint16_t u16(size_t offset) const {
+    return u8(offset) | (uint16_t)(u8(offset + 1) << 8);
+  }
+
+  uint32_t u32(size_t offset) const {
+    return u16(offset) | ((uint32_t)u16(offset + 2) << 16);
+  }
+
+  std::string text() const {
+    return std::string(body.begin(), body.end());
+  }
+};
+
+/**
+ * Build a host command as 0x00 <COBS frame> 0x00, as arduino.js sends it
+ */
+inline std::string encodeCommand(uint8_t type, const std::vector<uint8_t> &body) {
+  std::vector<uint8_t> raw;
+  raw.push_back(type);
+  raw.insert(raw.end(), body.begin(), body.end());
+  uint16_t crc = crc16(raw.data(), (uint8_t)raw.size());
+  raw.push_back(crc & 0xFF);
+  raw.push_back(crc >> 8);
+
+  std::string out(1, '\0');
+  size_t codeIndex = out.size();
+  out.push_back(1);
+  for (size_t i = 0; i < raw.size(); i++) {
+    if (raw[i] == 0) {
+      codeIndex = out.size();
+      out.push_back(1);
+    } else {
+      out.push_back((char)raw[i]);
+      out[codeIndex]++;
+    }
+  }
+  out.push_back('\0');
+  return out;
+}
+
+inline std::string helloCommand() {
+  return encodeCommand(CMD_HELLO, std::vector<uint8_t>(1, PROTOCOL_VERSION));
+}
+
+inline std::string setParamCommand(uint8_t param, uint16_t value) {
+  std::vector<uint8_t> body;
+  body.push_back(param);
+  body.push_back(value & 0xFF);
+  body.push_back(value >> 8);
+  return encodeCommand(CMD_SET_PARAM, body);
+}
+
+inline std::string getParamCommand(uint8_t param) {
+  return encodeCommand(CMD_GET_PARAM, std::vector<uint8_t>(1, param));
+}
+
+inline std::string telemetryCommand() {
+  return encodeCommand(CMD_TELEMETRY, std::vector<uint8_t>());
+}
+
+inline std::string recordingCommand() {
+  return encodeCommand(CMD_RECORDING, std::vector<uint8_t>());
+}
+
+/**
+ * Incremental decoder for the device byte stream. Text sent before binary
+ * mode is collected separately, up to the first delimiter.
+ */
+class FrameReader {
+public:
+  FrameReader() : synced(false), badFrames(0) {}
+
+  void push(const std::string &bytes) {
+    for (size_t i = 0; i < bytes.size(); i++) {
+      uint8_t byte = (uint8_t)bytes[i];
+      if (!synced) {
+        if (byte == 0) {
+          synced = true;
+        } else {
+          text.push_back((char)byte);
+        }
+        continue;
+      }
+      if (byte != 0) {
+        encoded.push_back(byte);
+        continue;
+      }
+      if (!encoded.empty() && !decode()) {
+        badFrames++;
+      }
+      encoded.clear();
+    }
+  }
+
+  bool synced;                      // Seen the delimiter that starts binary mode
+  std::string text;                 // Text-mode output before that
+  std::vector<DeviceFrame> frames;  // Every valid frame decoded so far
+  unsigned badFrames;
+
+private:
+  std::vector<uint8_t> encoded;
+
+  bool decode() {
+    std::vector<uint8_t> raw;
+    size_t in = 0;
+    while (in < encoded.size()) {
+      uint8_t code = encoded[in++];
+      if (code == 0 || in + code - 1 > encoded.size()) {
+        return false;
+      }
+      for (uint8_t i = 1; i < code; i++) {
+        raw.push_back(encoded[in++]);
+      }
+      if (code < 0xFF && in < encoded.size()) {
+        raw.push_back(0);
+      }
+    }
+    if (raw.size() < 3) {
+      return false;
+    }
+    uint16_t expected = raw[raw.size() - 2] | (uint16_t)(raw[raw.size() - 1] << 8);
+    if (crc16(raw.data(), (uint8_t)(raw.size() - 2)) != expected) {
+      return false;
+    }
+
+    DeviceFrame frame;
+    frame.type = raw[0];
+    frame.body.assign(raw.begin() + 1, raw.end() - 2);
+    frames.push_back(frame);
+    return true;
+  }
+};
+
+#endif // HOST_FRAMES_H
@@ -0,0 +1,71 @@
+/**
+ * HostTrace.h
+ * Trace files for the host replay tools
+ *
+ * A trace is a text file with one event per line, a time in milliseconds
+ * from the start of the trace, the event and its argument:
+ *
+ *   # comment
+ *   100    dot down
+ *
+ * Which events there are is up to the tool reading it.
+ */
+
+#ifndef HOST_TRACE_H
+#define HOST_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct TraceEvent {
+  uint64_t micros;
+  std::string what;
+  std::string argument;
+};
+
+/**
+ * Read a trace, its events in time order
+ * @return false, with a message on stderr, if it cannot be read
+ */
+inline bool loadTrace(const char *path, std::vector<TraceEvent> &events) {
+  std::ifstream file(path);
+  if (!file) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return false;
+  }
+
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    size_t comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.erase(comment);
+    }
+    std::istringstream fields(line);
+    double ms;
+    TraceEvent event;
+    if (!(fields >> ms)) {
+      continue;
+    }
+    if (!(fields >> event.what >> event.argument) || ms < 0) {
+      fprintf(stderr, "%s:%d: expected '<ms> <event> <argument>'\n", path, lineNumber);
+      return false;
+    }
+    event.micros = (uint64_t)(ms * 1000.0 + 0.5);
+    events.push_back(event);
+  }
+
+  std::stable_sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) {
+    return a.micros < b.micros;
+  });
+  return true;
+}
+
+#endif // HOST_TRACE_H
@@ -0,0 +1,448 @@
+/**
+ * KeyerSim.h
+ * Simulated keyer board for host tests and trace replay
+ *
+ * Runs the real MorseKeyer<HostBoard> against the mock HAL. The driver
+ * presses and releases the paddles, advances simulated time (calling poll()
+ * like loop() would and firing the keyer tick like the board timer would)
+ * and reads back the decoded frames. Receiver audio for the tone decoder is
+ * played in with playAudio().
+ */
+
+#ifndef KEYER_SIM_H
+#define KEYER_SIM_H
+
+#include <Arduino.h>
+#include <MorseKeyer.h>
+
+#include "HostAudio.h"
+#include "HostFrames.h"
+
+/**
+ * Sidetone that records when it sounded instead of making a noise
+ */
+struct HostSidetone {
+  static void begin(uint8_t pin) {
+    state().pin = pin;
+    state().sounding = false;
+    state().hz = SIDETONE_DEFAULT_HZ;
+    state().onCount = 0;
+  }
+
+  static void setPitch(uint16_t hz) {
+    state().hz = hz;
+  }
+
+  static void on() {
+    if (!state().sounding) {
+      state().onCount++;
+      state().onMicros = hostMicros64();
+    }
+    state().sounding = true;
+  }
+
+  static void off() {
+    if (state().sounding) {
+      state().offMicros = hostMicros64();
+    }
+    state().sounding = false;
+  }
+
+  struct State {
+    uint8_t pin;
+    bool sounding;
+    uint16_t hz;
+    uint32_t onCount;     // Tones started since begin()
+    uint64_t onMicros;    // When the last tone started
+    uint64_t offMicros;   // When the last tone stopped
+  };
+
+  static State &state() {
+    static State sidetone;
+    return sidetone;
+  }
+};
+
+/**
+ * Settings store held in RAM, counting writes. A new KeyerSim starts it
+ * erased; copy state() across to simulate a power cycle.
+ */
+struct HostParamStore {
+  static void read(ParamBlock &block) {
+    block = state().block;
+  }
+
+  static void write(const ParamBlock &block) {
+    state().block = block;
+    state().writes++;
+  }
+
+  static void erase() {
+    memset(state().block.bytes, 0xFF, sizeof(state().block.bytes));
+    state().writes = 0;
+  }
+
+  struct State {
+    ParamBlock block;
+    uint32_t writes;
+  };
+
+  static State &state() {
+    static State store;
+    return store;
+  }
+};
+
+/**
+ * Idle that counts dozes and sleeps. Sleeping stops the keyer tick and lets
+ * simulated time run until a paddle pin is LOW, so a test wakes the keyer
+ * with a press scheduled by KeyerSim::pressAt(). Sleep is off unless a test
+ * allows it, as a host with the port open would keep a real board awake.
+ */
+struct HostIdleSleep {
+  static const bool CAN_SLEEP = true;
+
+  static void doze() {
+    state().dozes++;
+  }
+
+  static bool sleepAllowed() {
+    return state().allowed;
+  }
+
+  static void sleep(uint8_t dotPin, uint8_t dashPin, uint16_t maxMs) {
+    state().sleeps++;
+    hostPauseTimer(true);
+    uint64_t end = hostMicros64() + maxMs * 1000ULL;
+    while (hostMicros64() < end && hostPinLevel(dotPin) == HIGH && hostPinLevel(dashPin) == HIGH) {
+      uint64_t step = end - hostMicros64();
+      hostAdvanceMicros(step < SLEEP_STEP_MICROS ? (uint32_t)step : SLEEP_STEP_MICROS);
+    }
+    hostPauseTimer(false);
+  }
+
+  static const uint32_t SLEEP_STEP_MICROS = 10;
+
+  struct State {
+    bool allowed;
+    uint32_t dozes;
+    uint32_t sleeps;
+  };
+
+  static State &state() {
+    static State idle;
+    return idle;
+  }
+
+  static void reset() {
+    state().allowed = false;
+    state().dozes = 0;
+    state().sleeps = 0;
+  }
+};
+
+/**
+ * ADC on a receiver's audio output. A test plays audio with
+ * KeyerSim::playAudio() whether or not the keyer samples it; between clips
+ * the ADC reads its bias point (silence).
+ */
+struct HostToneInput {
+  static const bool AVAILABLE = true;
+
+  static bool begin(uint32_t sampleHz) {
+    state().running = true;
+    state().sampleHz = sampleHz;
+    state().startMicros = hostMicros64();
+    state().taken = 0;
+    return true;
+  }
+
+  static void end() {
+    state().running = false;
+  }
+
+  static uint8_t read(int16_t *samples, uint8_t max, uint32_t &lastMicros) {
+    if (!state().running) {
+      return 0;
+    }
+    uint64_t converted = (hostMicros64() - state().startMicros) * state().sampleHz / 1000000ULL + 1;
+    uint8_t count = 0;
+    uint64_t micros = 0;
+    while (count < max && state().taken < converted) {
+      micros = state().startMicros + state().taken++ * 1000000ULL / state().sampleHz;
+      samples[count++] = level(micros);
+    }
+    lastMicros = (uint32_t)micros;
+    return count;
+  }
+
+  /**
+   * The audio at a moment, on hostMicros64()'s clock
+   */
+  static int16_t level(uint64_t micros) {
+    const AudioClip &clip = state().clip;
+    if (micros < state().clipMicros || clip.sampleHz == 0) {
+      return ADC_BIAS;
+    }
+    uint64_t index = (micros - state().clipMicros) * clip.sampleHz / 1000000ULL;
+    return index < clip.samples.size() ? clip.samples[index] : ADC_BIAS;
+  }
+
+  struct State {
+    bool running;
+    uint32_t sampleHz;
+    uint64_t startMicros;  // When begin() started sampling
+    uint64_t taken;        // Samples handed to the keyer so far
+    AudioClip clip;        // Audio playing...
+    uint64_t clipMicros;   // ...since this moment
+  };
+
+  static State &state() {
+    static State adc;
+    return adc;
+  }
+
+  static void reset() {
+    state().running = false;
+    state().clip = AudioClip();
+    state().clipMicros = 0;
+  }
+};
+
+struct HostBoard {
+  static const uint8_t DOT_PIN = 2;
+  static const uint8_t DASH_PIN = 3;
+  static const uint8_t LED_PIN = LED_BUILTIN;
+  static const uint8_t LED_ON = HIGH;
+  static const unsigned long BAUD_RATE = 115200;
+
+  static unsigned long now() { return millis(); }
+  static unsigned long nowMicros() { return micros(); }
+  static void beginTickTimer(KeyerTickHandler handler) { hostAttachTimer(handler, 1000000UL / KEYER_TICK_HZ); }
+  static void lockTick() { noInterrupts(); }
+  static void unlockTick() { interrupts(); }
+  static const uint8_t SIDETONE_PIN = 9;
+  typedef HostSidetone Sidetone;
+  static const uint8_t KEY_OUT_PIN = 10;
+  static const uint8_t PTT_PIN = 11;
+  typedef HostParamStore ParamStore;
+  typedef HostIdleSleep IdleSleep;
+  typedef HostToneInput ToneInput;
+  static const uint16_t KEYER_RAM_BUDGET = 4096;  // 64-bit pointers and alignment make the host build larger
+  static const uint16_t WATCHDOG_TIMEOUT_MS = 0;  // No watchdog
+  static void watchdogBegin() {}
+  static void watchdogReset() {}
+};
+
+/**
+ * An element as reported by FRAME_ELEMENT
+ */
+struct SimElement {
+  char element;
+  uint32_t micros;
+  uint16_t durationMs;
+};
+
+/**
+ * A stretch of time an output pin spent HIGH
+ */
+struct SimPulse {
+  uint64_t micros;
+  uint64_t durationMicros;
+};
+
+class KeyerSim {
+public:
+  enum Contact { DOT, DASH };
+
+  /**
+   * @param pollMicros How often loop() gets round to poll()
+   */
+  explicit KeyerSim(uint32_t pollMicros = 100) : pollInterval(pollMicros), hostReadRate(-1) {
+    hostReset();
+    HostParamStore::erase();
+    HostIdleSleep::reset();
+    HostToneInput::reset();
+    keyer = new MorseKeyer<HostBoard>();
+  }
+
+  ~KeyerSim() {
+    delete keyer;
+  }
+
+  /**
+   * Boot the firmware and, unless text mode is wanted, complete the handshake
+   */
+  void begin(bool binary = true) {
+    keyer->begin();
+    if (binary) {
+      send(helloCommand());
+    }
+    run(1);
+  }
+
+  void send(const std::string &bytes) {
+    Serial.input.append(bytes);
+  }
+
+  void setParam(uint8_t param, uint16_t value) {
+    send(setParamCommand(param, value));
+    run(1);
+  }
+
+  void press(Contact contact) {
+    hostSetPin(contact == DOT ? HostBoard::DOT_PIN : HostBoard::DASH_PIN, LOW);
+  }
+
+  void release(Contact contact) {
+    hostSetPin(contact == DOT ? HostBoard::DOT_PIN : HostBoard::DASH_PIN, HIGH);
+  }
+
+  /**
+   * Press a paddle ms from now, even while the keyer sleeps through run()
+   */
+  void pressAt(Contact contact, uint32_t ms) {
+    hostSchedulePin(contact == DOT ? HostBoard::DOT_PIN : HostBoard::DASH_PIN, LOW, hostMicros64() + ms * 1000ULL);
+  }
+
+  void releaseAt(Contact contact, uint32_t ms) {
+    hostSchedulePin(contact == DOT ? HostBoard::DOT_PIN : HostBoard::DASH_PIN, HIGH, hostMicros64() + ms * 1000ULL);
+  }
+
+  /**
+   * Start playing audio into the tone input, replacing any still playing
+   * @return when it starts, on hostMicros64()'s clock
+   */
+  uint64_t playAudio(const AudioClip &clip) {
+    HostToneInput::state().clip = clip;
+    HostToneInput::state().clipMicros = hostMicros64();
+    return hostMicros64();
+  }
+
+  /**
+   * Limit how many bytes the host takes per poll(), as availableForWrite()
+   * would report for a slow reader. 0 stalls the host, -1 removes the limit.
+   */
+  void setHostReadRate(int bytesPerPoll) {
+    hostReadRate = bytesPerPoll;
+    Serial.writeSpace = bytesPerPoll < 0 ? 1 << 30 : bytesPerPoll;
+  }
+
+  /**
+   * Let ms of simulated time pass
+   */
+  void run(uint32_t ms) {
+    runMicros(ms * 1000UL);
+  }
+
+  void runMicros(uint32_t us) {
+    uint64_t end = hostMicros64() + us;
+    while (hostMicros64() < end) {
+      if (hostReadRate >= 0) {
+        Serial.writeSpace = hostReadRate;
+      }
+      keyer->poll();
+      uint64_t step = end - hostMicros64();
+      hostAdvanceMicros(step < pollInterval ? (uint32_t)step : pollInterval);
+    }
+    reader.push(Serial.output);
+    Serial.output.clear();
+  }
+
+  /**
+   * Elements reported since begin(), in order
+   */
+  std::vector<SimElement> elements() const {
+    std::vector<SimElement> result;
+    for (size_t i = 0; i < reader.frames.size(); i++) {
+      const DeviceFrame &frame = reader.frames[i];
+      if (frame.type == FRAME_ELEMENT) {
+        SimElement element = { (char)frame.u8(0), frame.u32(1), frame.u16(5) };
+        result.push_back(element);
+      }
+    }
+    return result;
+  }
+
+  /**
+   * The element stream as text, with '/' for each reported word gap
+   */
+  std::string pattern() const {
+    std::string result;
+    for (size_t i = 0; i < reader.frames.size(); i++) {
+      const DeviceFrame &frame = reader.frames[i];
+      if (frame.type == FRAME_ELEMENT) {
+        result.push_back((char)frame.u8(0));
+      } else if (frame.type == FRAME_GAP) {
+        result.push_back('/');
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Characters decoded on the device, '?' for an unknown pattern and
+   * ' ' for each word gap
+   */
+  std::string decoded() const {
+    std::string result;
+    for (size_t i = 0; i < reader.frames.size(); i++) {
+      const DeviceFrame &frame = reader.frames[i];
+      if (frame.type == FRAME_CHARACTER) {
+        std::string text = frame.text().substr(5);
+        result += text.empty() ? "?" : text;
+      } else if (frame.type == FRAME_GAP) {
+        result.push_back(' ');
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Times an output pin was driven HIGH, in order. A pulse still running
+   * is measured up to now.
+   */
+  std::vector<SimPulse> pulses(uint8_t pin) const {
+    std::vector<SimPulse> result;
+    const std::vector<HostPinChange> &changes = hostPinChanges();
+    for (size_t i = 0; i < changes.size(); i++) {
+      if (changes[i].pin != pin) {
+        continue;
+      }
+      if (changes[i].level == HIGH) {
+        SimPulse pulse = { changes[i].micros, 0 };
+        result.push_back(pulse);
+      } else if (!result.empty() && result.back().durationMicros == 0) {
+        result.back().durationMicros = changes[i].micros - result.back().micros;
+      }
+    }
+    if (!result.empty() && result.back().durationMicros == 0) {
+      result.back().durationMicros = hostMicros64() - result.back().micros;
+    }
+    return result;
+  }
+
+  /**
+   * Last frame of a given type, or 0 if none has been seen
+   */
+  const DeviceFrame *lastFrame(uint8_t type) const {
+    for (size_t i = reader.frames.size(); i > 0; i--) {
+      if (reader.frames[i - 1].type == type) {
+        return &reader.frames[i - 1];
+      }
+    }
+    return 0;
+  }
+
+  MorseKeyer<HostBoard> *keyer;
+  FrameReader reader;
+
+private:
+  uint32_t pollInterval;
+  int hostReadRate;
+
+  KeyerSim(const KeyerSim &);
+  KeyerSim &operator=(const KeyerSim &);
+};
+
+#endif // KEYER_SIM_H
@@ -0,0 +1,239 @@
+/**
+ * keyer_replay.cpp
+ * Replay paddle traces through the host build of the keyer
+ *
+ * Usage: keyer_replay [-p poll_us] trace...
+ *
+ * A trace is a text file with one event per line, times in milliseconds
+ * from the start of the trace:
+ *
+ *   # comment
+ *   0      wpm 25          keyer speed, 0 to follow the operator
+ *   0      mode B          iambic mode A or B, K for a straight key, G for a bug
+ *   0      debounce 5      contact debounce in ms
+ *   0      keyout 1        key the transmitter line and PTT
+ *   0      pttlead 10      PTT lead in ms
+ *   0      ptttail 30      PTT tail in ms
+ *   0      ptthang 7       PTT hang in dits
+ *   100    dot down        paddle contact closes
+ *   160.5  dot up          paddle contact opens
+ *   200    dash down
+ *   0      expect .-/      element stream the replay must produce ('/' = word gap)
+ *
+ * Prints each element the keyer sends with its start time, duration and the
+ * delay from the paddle press that asked for it, then the element stream
+ * and latency figures. Exits non-zero if a trace's expect line does not
+ * match, so traces double as regression tests. -p sets how often loop() polls (default 100us), to
+ * check that a slow loop() does not change the keying.
+ *
+ * With keyout on, also prints the transmitter key line and PTT pulses. The
+ * replay fails if a key pulse is not its element delayed by the PTT lead,
+ * or falls outside PTT, or PTT opens less than the lead before it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "HostTrace.h"
+#include "KeyerSim.h"
+
+struct Press {
+  uint64_t micros;
+  char element;
+};
+
+static bool applyEvent(KeyerSim &sim, const TraceEvent &event, std::vector<Press> &presses, uint64_t startMicros) {
+  if (event.what == "expect") {
+    // Checked once the replay is complete
+  } else if (event.what == "dot" || event.what == "dash") {
+    KeyerSim::Contact contact = event.what == "dot" ? KeyerSim::DOT : KeyerSim::DASH;
+    if (event.argument == "down") {
+      sim.press(contact);
+      Press press = { hostMicros64() - startMicros, contact == KeyerSim::DOT ? '.' : '-' };
+      presses.push_back(press);
+    } else if (event.argument == "up") {
+      sim.release(contact);
+    } else {
+      return false;
+    }
+  } else if (event.what == "wpm") {
+    sim.setParam(PARAM_WPM, atoi(event.argument.c_str()));
+  } else if (event.what == "debounce") {
+    sim.setParam(PARAM_DEBOUNCE, atoi(event.argument.c_str()));
+  } else if (event.what == "keyout") {
+    sim.setParam(PARAM_KEY_OUTPUT, atoi(event.argument.c_str()));
+  } else if (event.what == "pttlead") {
+    sim.setParam(PARAM_PTT_LEAD, atoi(event.argument.c_str()));
+  } else if (event.what == "ptttail") {
+    sim.setParam(PARAM_PTT_TAIL, atoi(event.argument.c_str()));
+  } else if (event.what == "ptthang") {
+    sim.setParam(PARAM_PTT_HANG, atoi(event.argument.c_str()));
+  } else if (event.what == "mode") {
+    if (event.argument != "A" && event.argument != "B" && event.argument != "K" && event.argument != "G") {
+      return false;
+    }
+    sim.send(event.argument);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Print the key line and PTT pulses and check them against the elements
+ * @return false if the key line does not carry the elements as sent
+ */
+static bool checkKeyOutput(const char *path, const KeyerSim &sim, uint32_t leadMicros, uint64_t startMicros) {
+  std::vector<SimElement> elements = sim.elements();
+  std::vector<SimPulse> keyed = sim.pulses(HostBoard::KEY_OUT_PIN);
+  std::vector<SimPulse> ptt = sim.pulses(HostBoard::PTT_PIN);
+  if (keyed.empty() && ptt.empty()) {
+    return true;
+  }
+
+  printf("  key line  start_ms  duration_ms\n");
+  for (size_t i = 0; i < keyed.size(); i++) {
+    printf("            %9.3f  %11.3f\n", (keyed[i].micros - startMicros) / 1000.0, keyed[i].durationMicros / 1000.0);
+  }
+  printf("  ptt       start_ms  duration_ms\n");
+  for (size_t i = 0; i < ptt.size(); i++) {
+    printf("            %9.3f  %11.3f\n", (ptt[i].micros - startMicros) / 1000.0, ptt[i].durationMicros / 1000.0);
+  }
+
+  if (keyed.size() > elements.size()) {
+    fprintf(stderr, "%s: key line has more pulses than elements\n", path);
+    return false;
+  }
+
+  // Elements keyed with the output on are the last keyed.size() reported
+  bool ok = true;
+  size_t first = elements.size() - keyed.size();
+  for (size_t i = 0; i < keyed.size(); i++) {
+    const SimElement &element = elements[first + i];
+    if ((uint32_t)keyed[i].micros != element.micros + leadMicros ||
+        keyed[i].durationMicros != element.durationMs * 1000ULL) {
+      fprintf(stderr, "%s: key line pulse %u does not match its element\n", path, (unsigned)i);
+      ok = false;
+    }
+    bool covered = false;
+    for (size_t p = 0; p < ptt.size(); p++) {
+      if (ptt[p].micros + leadMicros <= keyed[i].micros &&
+          keyed[i].micros + keyed[i].durationMicros <= ptt[p].micros + ptt[p].durationMicros) {
+        covered = true;
+      }
+    }
+    if (!covered) {
+      fprintf(stderr, "%s: key line pulse %u is not inside PTT with its lead\n", path, (unsigned)i);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+static bool replay(const char *path, uint32_t pollMicros) {
+  std::vector<TraceEvent> events;
+  if (!loadTrace(path, events)) {
+    return false;
+  }
+
+  KeyerSim sim(pollMicros);
+  sim.begin();
+  uint64_t startMicros = hostMicros64();
+  uint32_t startDevice = micros();
+
+  std::vector<Press> presses;
+  for (size_t i = 0; i < events.size(); i++) {
+    uint64_t due = startMicros + events[i].micros;
+    if (due > hostMicros64()) {
+      sim.runMicros((uint32_t)(due - hostMicros64()));
+    }
+    if (!applyEvent(sim, events[i], presses, startMicros)) {
+      fprintf(stderr, "%s: unknown event '%s %s'\n", path, events[i].what.c_str(), events[i].argument.c_str());
+      return false;
+    }
+  }
+  // Long enough for the last element and its word gap at 5 WPM
+  sim.run(3000);
+
+  printf("%s\n", path);
+  printf("  element  start_ms  duration_ms  latency_ms\n");
+
+  std::vector<SimElement> elements = sim.elements();
+  std::vector<double> latencies;
+  for (size_t i = 0; i < elements.size(); i++) {
+    uint64_t start = (uint32_t)(elements[i].micros - startDevice);
+    printf("  %c        %9.3f  %11u", elements[i].element, start / 1000.0, elements[i].durationMs);
+
+    // Latency from the latest unanswered press of this paddle. Older ones
+    // never produced an element of their own (a Mode A release) and are dropped.
+    bool matched = false;
+    for (size_t p = presses.size(); p > 0; p--) {
+      const Press &press = presses[p - 1];
+      if (press.micros <= start && press.element == elements[i].element) {
+        double latency = (start - press.micros) / 1000.0;
+        latencies.push_back(latency);
+        printf("  %10.3f", latency);
+        for (size_t q = p; q > 0; q--) {
+          if (presses[q - 1].element == elements[i].element) {
+            presses.erase(presses.begin() + (q - 1));
+          }
+        }
+        matched = true;
+        break;
+      }
+    }
+    if (!matched) {
+      printf("           -");
+    }
+    printf("\n");
+  }
+
+  printf("  pattern: %s\n", sim.pattern().c_str());
+  printf("  elements: %u, bad frames: %u\n", (unsigned)elements.size(), sim.reader.badFrames);
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (size_t i = 0; i < latencies.size(); i++) {
+      total += latencies[i];
+    }
+    printf("  press-to-element latency ms: min %.3f, mean %.3f, max %.3f over %u presses\n",
+           latencies.front(), total / latencies.size(), latencies.back(), (unsigned)latencies.size());
+  }
+
+  uint32_t leadMicros = 0;
+  for (size_t i = 0; i < events.size(); i++) {
+    if (events[i].what == "pttlead") {
+      leadMicros = atoi(events[i].argument.c_str()) * 1000UL;
+    }
+  }
+  bool ok = checkKeyOutput(path, sim, leadMicros, startMicros) && sim.reader.badFrames == 0;
+  for (size_t i = 0; i < events.size(); i++) {
+    if (events[i].what == "expect" && events[i].argument != sim.pattern()) {
+      fprintf(stderr, "%s: expected %s, keyed %s\n", path, events[i].argument.c_str(), sim.pattern().c_str());
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  uint32_t pollMicros = 100;
+  int first = 1;
+  if (argc > 2 && strcmp(argv[1], "-p") == 0) {
+    pollMicros = (uint32_t)atol(argv[2]);
+    first = 3;
+  }
+  if (first >= argc || pollMicros == 0) {
+    fprintf(stderr, "usage: %s [-p poll_us] trace...\n", argv[0]);
+    return 2;
+  }
+
+  bool ok = true;
+  for (int i = first; i < argc; i++) {
+    ok = replay(argv[i], pollMicros) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,1397 @@
+/**
+ * keyer_test.cpp
+ * Host regression tests for the MorseKeyer iambic engine and timing
+ *
+ * Build and run with `make test` in this directory.
+ */
+
+#include <stdio.h>
+
+#include "KeyerSim.h"
+
+static int failures = 0;
+static int checks = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQ(expected, actual) checkEqual((long)(expected), (long)(actual), #actual, __FILE__, __LINE__)
+#define CHECK_PATTERN(expected, sim) checkPattern((expected), (sim).pattern(), __FILE__, __LINE__)
+
+static void check(bool ok, const char *what, const char *file, int line) {
+  checks++;
+  if (!ok) {
+    failures++;
+    printf("  FAIL %s:%d: %s\n", file, line, what);
+  }
+}
+
+static void checkEqual(long expected, long actual, const char *what, const char *file, int line) {
+  checks++;
+  if (expected != actual) {
+    failures++;
+    printf("  FAIL %s:%d: %s is %ld, expected %ld\n", file, line, what, actual, expected);
+  }
+}
+
+static void checkPattern(const std::string &expected, const std::string &actual, const char *file, int line) {
+  checks++;
+  if (expected != actual) {
+    failures++;
+    printf("  FAIL %s:%d: pattern is \"%s\", expected \"%s\"\n", file, line, actual.c_str(), expected.c_str());
+  }
+}
+
+/**
+ * A keyer at a fixed speed in the given mode, handshake done
+ */
+static void startKeyer(KeyerSim &sim, uint8_t wpm, char mode = 'A') {
+  sim.begin();
+  sim.setParam(PARAM_WPM, wpm);
+  sim.send(std::string(1, mode));
+  sim.run(10);
+}
+
+static void testHandshake() {
+  KeyerSim sim;
+  sim.begin();
+  CHECK(sim.reader.text.find("Morse Decoder Ready") != std::string::npos);
+  const DeviceFrame *hello = sim.lastFrame(FRAME_HELLO);
+  CHECK(hello != 0);
+  if (hello) {
+    CHECK_EQ(PROTOCOL_VERSION, hello->u8(0));
+    CHECK_EQ(CAP_KEY_EDGES | CAP_ELEMENTS | CAP_TIMING | CAP_TELEMETRY | CAP_CHARACTERS | CAP_SIDETONE | CAP_RECORDER |
+             CAP_KEY_OUTPUT | CAP_SAVED_PARAMS | CAP_SLEEP | CAP_TONE_DECODE,
+             hello->u16(1));
+  }
+  CHECK_EQ(0, sim.reader.badFrames);
+}
+
+static void testHeldDotRepeatsAtSpeed() {
+  // 20 WPM: 60ms dit, 60ms element space
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.press(KeyerSim::DOT);
+  sim.run(590);
+  sim.release(KeyerSim::DOT);
+  sim.run(600);
+
+  std::vector<SimElement> elements = sim.elements();
+  CHECK_EQ(5, elements.size());
+  for (size_t i = 0; i < elements.size(); i++) {
+    CHECK_EQ('.', elements[i].element);
+    CHECK_EQ(60, elements[i].durationMs);
+    if (i > 0) {
+      CHECK_EQ(120000, elements[i].micros - elements[i - 1].micros);
+    }
+  }
+  CHECK_PATTERN("...../", sim);
+}
+
+static void testHeldDahRepeatsAtSpeed() {
+  // 40 WPM: 30ms dit, dah is 90ms plus a 30ms space
+  KeyerSim sim;
+  startKeyer(sim, 40);
+  sim.press(KeyerSim::DASH);
+  sim.run(350);
+  sim.release(KeyerSim::DASH);
+  sim.run(400);
+
+  std::vector<SimElement> elements = sim.elements();
+  CHECK_EQ(3, elements.size());
+  for (size_t i = 0; i < elements.size(); i++) {
+    CHECK_EQ('-', elements[i].element);
+    CHECK_EQ(90, elements[i].durationMs);
+    if (i > 0) {
+      CHECK_EQ(120000, elements[i].micros - elements[i - 1].micros);
+    }
+  }
+}
+
+static void testSpeedLimits() {
+  KeyerSim sim;
+  startKeyer(sim, 100);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0);
+  if (param) {
+    CHECK_EQ(PARAM_WPM, param->u8(0));
+    CHECK_EQ(MAX_WPM, param->u16(1));
+  }
+  sim.press(KeyerSim::DOT);
+  sim.run(100);
+  sim.release(KeyerSim::DOT);
+  sim.run(200);
+  // 60 WPM: 20ms dit, 40ms per dit with its space
+  std::vector<SimElement> elements = sim.elements();
+  CHECK_EQ(3, elements.size());
+  if (!elements.empty()) {
+    CHECK_EQ(20, elements[0].durationMs);
+  }
+
+  KeyerSim slow;
+  startKeyer(slow, 1);
+  const DeviceFrame *timing = slow.lastFrame(FRAME_TIMING);
+  CHECK(timing != 0);
+  if (timing) {
+    CHECK_EQ(240, timing->u16(0));
+    CHECK_EQ(MIN_WPM, timing->u8(2));
+  }
+}
+
+static void testSqueezeAlternates() {
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.press(KeyerSim::DASH);
+  sim.run(20);
+  sim.press(KeyerSim::DOT);
+  sim.run(700);
+  sim.release(KeyerSim::DOT);
+  sim.release(KeyerSim::DASH);
+  sim.run(600);
+  // Dah first, then alternating while squeezed: 240 + 120 + 240 + 120ms
+  CHECK_PATTERN("-.-./", sim);
+}
+
+static void testModeAStopsOnRelease() {
+  // Squeeze released part way through the dit - Mode A stops after it
+  KeyerSim sim;
+  startKeyer(sim, 20, 'A');
+  sim.press(KeyerSim::DOT);
+  sim.press(KeyerSim::DASH);
+  sim.run(30);
+  sim.release(KeyerSim::DOT);
+  sim.release(KeyerSim::DASH);
+  sim.run(600);
+  CHECK_PATTERN("./", sim);
+}
+
+static void testModeBSendsOneMoreElement() {
+  // The same squeeze in Mode B sends the opposite element, then stops
+  KeyerSim sim;
+  startKeyer(sim, 20, 'B');
+  sim.press(KeyerSim::DOT);
+  sim.press(KeyerSim::DASH);
+  sim.run(30);
+  sim.release(KeyerSim::DOT);
+  sim.release(KeyerSim::DASH);
+  sim.run(1000);
+  CHECK_PATTERN(".-/", sim);
+}
+
+static void testModeBRemembersTap() {
+  // Dot tapped and released during a dah is still sent in Mode B, lost in Mode A
+  KeyerSim modeB;
+  startKeyer(modeB, 20, 'B');
+  modeB.press(KeyerSim::DASH);
+  modeB.run(50);
+  modeB.release(KeyerSim::DASH);
+  modeB.run(20);
+  modeB.press(KeyerSim::DOT);
+  modeB.run(40);
+  modeB.release(KeyerSim::DOT);
+  modeB.run(600);
+  CHECK_PATTERN("-./", modeB);
+
+  KeyerSim modeA;
+  startKeyer(modeA, 20, 'A');
+  modeA.press(KeyerSim::DASH);
+  modeA.run(50);
+  modeA.release(KeyerSim::DASH);
+  modeA.run(20);
+  modeA.press(KeyerSim::DOT);
+  modeA.run(40);
+  modeA.release(KeyerSim::DOT);
+  modeA.run(600);
+  CHECK_PATTERN("-/", modeA);
+}
+
+static void testDebounceLatency() {
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  uint32_t pressed = micros();
+  sim.press(KeyerSim::DOT);
+  sim.run(30);
+  sim.release(KeyerSim::DOT);
+  sim.run(300);
+
+  std::vector<SimElement> elements = sim.elements();
+  CHECK_EQ(1, elements.size());
+  if (!elements.empty()) {
+    // Accepted on the DEBOUNCE_DELAY-th tick after the press
+    CHECK(elements[0].micros - pressed <= (DEBOUNCE_DELAY + 1) * 1000UL);
+  }
+}
+
+static void testChatterIsFiltered() {
+  KeyerSim sim;
+  startKeyer(sim, 20);
+
+  // 4ms of contact bounce on press and release
+  for (int i = 0; i < 8; i++) {
+    if (i % 2 == 0) {
+      sim.press(KeyerSim::DOT);
+    } else {
+      sim.release(KeyerSim::DOT);
+    }
+    sim.runMicros(500);
+  }
+  sim.press(KeyerSim::DOT);
+  sim.run(40);
+  for (int i = 0; i < 8; i++) {
+    if (i % 2 == 0) {
+      sim.release(KeyerSim::DOT);
+    } else {
+      sim.press(KeyerSim::DOT);
+    }
+    sim.runMicros(500);
+  }
+  sim.release(KeyerSim::DOT);
+  sim.run(600);
+  CHECK_PATTERN("./", sim);
+
+  // A glitch shorter than the debounce time is ignored
+  sim.press(KeyerSim::DASH);
+  sim.run(2);
+  sim.release(KeyerSim::DASH);
+  sim.run(300);
+  CHECK_PATTERN("./", sim);
+}
+
+static void testSlowLoopKeepsTiming() {
+  // Element timing comes from the tick, not from how often poll() runs
+  KeyerSim sim(25000);
+  startKeyer(sim, 30);
+  sim.press(KeyerSim::DOT);
+  sim.run(400);
+  sim.release(KeyerSim::DOT);
+  sim.run(400);
+
+  std::vector<SimElement> elements = sim.elements();
+  CHECK_EQ(5, elements.size());
+  for (size_t i = 1; i < elements.size(); i++) {
+    CHECK_EQ(80000, elements[i].micros - elements[i - 1].micros);
+  }
+}
+
+static void testWordGap() {
+  // Word gap is reported 5 units after the last element ends
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.press(KeyerSim::DOT);
+  sim.run(30);
+  sim.release(KeyerSim::DOT);
+  sim.run(320);
+  CHECK_PATTERN(".", sim);
+  sim.run(20);
+  CHECK_PATTERN("./", sim);
+}
+
+static void testAdaptiveTiming() {
+  // With no speed set, the keyer converges on the operator's own dit length
+  KeyerSim sim;
+  sim.begin();
+  for (int i = 0; i < 30; i++) {
+    sim.press(KeyerSim::DOT);
+    sim.run(60);
+    sim.release(KeyerSim::DOT);
+    sim.run(300);
+  }
+  const DeviceFrame *timing = sim.lastFrame(FRAME_TIMING);
+  CHECK(timing != 0);
+  if (timing) {
+    CHECK_EQ(20, timing->u8(2));
+  }
+}
+
+static void testTextMode() {
+  KeyerSim sim;
+  sim.begin(false);
+  sim.send("B");
+  sim.press(KeyerSim::DASH);
+  sim.run(100);
+  sim.release(KeyerSim::DASH);
+  sim.run(2000);
+  CHECK(sim.reader.text.find("MODE:PADDLE_IAMBIC_B") != std::string::npos);
+  CHECK(sim.reader.text.find('-') != std::string::npos);
+  CHECK(sim.reader.text[sim.reader.text.size() - 1] == ' ');
+  CHECK(!sim.reader.synced);
+}
+
+static void testLedTestDoesNotBlock() {
+  // The LED blinks while the keyer carries on reporting
+  KeyerSim sim;
+  sim.begin(false);
+  uint64_t sent = hostMicros64();
+  sim.send("T");
+  sim.run(50);
+  CHECK(hostMicros64() - sent < 60000);
+  CHECK(sim.reader.text.find("Testing LED") != std::string::npos);
+  CHECK_EQ(HostBoard::LED_ON, hostPinLevel(HostBoard::LED_PIN));
+
+  sim.run(100);
+  CHECK(hostPinLevel(HostBoard::LED_PIN) != HostBoard::LED_ON);
+  sim.press(KeyerSim::DOT);
+  sim.run(30);
+  sim.release(KeyerSim::DOT);
+  sim.run(50);
+  CHECK(sim.reader.text.find('.') != std::string::npos);
+  CHECK(sim.reader.text.find("LED test complete") == std::string::npos);
+
+  sim.run(500);
+  CHECK(sim.reader.text.find("LED test complete") != std::string::npos);
+  CHECK(hostPinLevel(HostBoard::LED_PIN) != HostBoard::LED_ON);
+}
+
+static void testDebugReportsFromFlash() {
+  // Status text comes out of F() strings unchanged, with the RAM report
+  KeyerSim sim;
+  sim.begin(false);
+  sim.send("D");
+  sim.run(5);
+  const std::string &text = sim.reader.text;
+  CHECK(text.find("DEBUG_MSG: Debug mode enabled") != std::string::npos);
+  CHECK(text.find("DEBUG_MSG: DOT PIN (GPIO 2) = RELEASED (HIGH)") != std::string::npos);
+  char ram[64];
+  snprintf(ram, sizeof(ram), "DEBUG_MSG: RAM keyer %u of %u bytes\r\n",
+           MorseKeyer<HostBoard>::staticRamBytes(), HostBoard::KEYER_RAM_BUDGET);
+  CHECK(text.find(ram) != std::string::npos);
+  CHECK(text.find("stack headroom") == std::string::npos);
+
+  sim.send("K");
+  sim.run(5);
+  CHECK(text.find("MODE:STRAIGHT_KEY") != std::string::npos);
+  CHECK(text.find("DEBUG_MSG: STRAIGHT_KEY activated") != std::string::npos);
+
+  // 'S' is still the legacy alias for iambic mode A
+  size_t straight = text.size();
+  sim.send("S");
+  sim.run(5);
+  CHECK(text.find("MODE:PADDLE_IAMBIC_A", straight) != std::string::npos);
+}
+
+static void testStalledHostDoesNotBlock() {
+  // With the host not reading, the keyer keeps time and drops whole frames
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.setHostReadRate(0);
+  sim.press(KeyerSim::DOT);
+  sim.run(10000);
+  sim.release(KeyerSim::DOT);
+  sim.run(500);
+  CHECK(sim.elements().empty());
+
+  // Once the host reads again, the backlog arrives as intact frames
+  sim.setHostReadRate(-1);
+  sim.run(10);
+  std::vector<SimElement> backlog = sim.elements();
+  CHECK(!backlog.empty());
+  CHECK(backlog.size() < 10000 / 120);
+  for (size_t i = 1; i < backlog.size(); i++) {
+    CHECK_EQ(120000, backlog[i].micros - backlog[i - 1].micros);
+  }
+  CHECK_EQ(0, sim.reader.badFrames);
+
+  // New keying is reported normally
+  sim.press(KeyerSim::DASH);
+  sim.run(100);
+  sim.release(KeyerSim::DASH);
+  sim.run(600);
+  CHECK_EQ('-', sim.elements().back().element);
+  CHECK_EQ(0, sim.reader.badFrames);
+}
+
+static void keySqueeze(KeyerSim &sim) {
+  startKeyer(sim, 30);
+  sim.press(KeyerSim::DOT);
+  sim.press(KeyerSim::DASH);
+  sim.run(1000);
+  sim.release(KeyerSim::DOT);
+  sim.release(KeyerSim::DASH);
+  sim.run(1000);
+}
+
+static void testSlowHostGetsEveryFrame() {
+  // A host taking one byte per poll still receives everything, on time
+  KeyerSim fast;
+  keySqueeze(fast);
+
+  KeyerSim slow;
+  slow.setHostReadRate(1);
+  keySqueeze(slow);
+
+  CHECK_PATTERN(fast.pattern(), slow);
+  std::vector<SimElement> expected = fast.elements();
+  std::vector<SimElement> actual = slow.elements();
+  for (size_t i = 0; i < expected.size() && i < actual.size(); i++) {
+    CHECK_EQ(expected[i].micros, actual[i].micros);
+  }
+  CHECK_EQ(0, slow.reader.badFrames);
+}
+
+static void testTelemetry() {
+  // Polling off the tick grid, so events wait for the next poll()
+  KeyerSim sim(130);
+  startKeyer(sim, 20);
+  sim.press(KeyerSim::DOT);
+  sim.run(500);
+  sim.release(KeyerSim::DOT);
+  sim.run(500);
+  sim.send(telemetryCommand());
+  sim.run(1);
+
+  const DeviceFrame *report = sim.lastFrame(FRAME_TELEMETRY);
+  CHECK(report != 0);
+  if (report) {
+    CHECK(report->u32(0) > 7000 && report->u32(0) < 8000);
+    CHECK(report->u32(4) >= 130 && report->u32(4) < 1000);
+    // Events wait at most one poll before they are queued
+    CHECK(report->u32(8) <= report->u32(12));
+    CHECK(report->u32(12) <= report->u32(16));
+    CHECK(report->u32(16) <= report->u32(20));
+    CHECK(report->u32(20) > 0 && report->u32(20) <= 130);
+    CHECK(report->u16(24) > 0);
+    CHECK_EQ(TX_BUFFER_SIZE, report->u16(26));
+    CHECK_EQ(0, report->u16(28));
+    CHECK_EQ(0, report->u16(34));
+    CHECK_EQ(HostBoard::WATCHDOG_TIMEOUT_MS, report->u16(36));
+    CHECK_EQ(STACK_HEADROOM_UNKNOWN, report->u16(46));
+  }
+
+  // A loop() held up elsewhere in the sketch shows up as a long iteration and watchdog feed gap
+  CHECK(report != 0 && report->u16(40) == 0);
+  delay(650);
+  sim.run(50);
+  sim.send(telemetryCommand());
+  sim.run(1);
+  report = sim.lastFrame(FRAME_TELEMETRY);
+  if (report) {
+    CHECK(report->u32(4) >= 600000);
+    CHECK(report->u16(38) >= 600);
+    // ...and as missed scheduler deadlines
+    CHECK(report->u16(40) > 0);
+    CHECK(report->u32(42) >= 600000);
+  }
+
+  // The window restarts after each report; the feed gap does not
+  sim.run(100);
+  sim.send(telemetryCommand());
+  sim.run(1);
+  report = sim.lastFrame(FRAME_TELEMETRY);
+  if (report) {
+    CHECK(report->u32(4) < 1000);
+    CHECK_EQ(0, report->u32(20));
+    CHECK(report->u16(38) >= 600);
+    CHECK_EQ(0, report->u32(42));
+  }
+}
+
+/**
+ * Counts the runs of each task in a test schedule
+ */
+struct ScheduleProbe {
+  int everyPass;
+  int periodic;
+  int oneShot;
+
+  void runEveryPass() { everyPass++; }
+  void runPeriodic() { periodic++; }
+  void runOneShot() { oneShot++; }
+};
+
+static const ScheduledTask<ScheduleProbe> PROBE_TASKS[] = {
+  { &ScheduleProbe::runEveryPass, 0, 1000 },
+  { &ScheduleProbe::runPeriodic, 10000, 2000 },
+  { &ScheduleProbe::runOneShot, 0, 500 },
+};
+
+static void testScheduler() {
+  ScheduleProbe probe = { 0, 0, 0 };
+  CooperativeScheduler<ScheduleProbe, 3> scheduler(PROBE_TASKS);
+  scheduler.start(0, 0);
+  scheduler.start(1, 0);
+
+  // 100us passes for 50ms: the periodic task runs at 10, 20, 30 and 40ms and nothing is late
+  uint32_t now = 0;
+  for (; now < 50000; now += 100) {
+    scheduler.runDue(probe, now);
+  }
+  CHECK_EQ(500, probe.everyPass);
+  CHECK_EQ(4, probe.periodic);
+  CHECK_EQ(0, scheduler.missCount());
+
+  // A one-shot runs once, at its deadline
+  scheduler.at(2, now + 300);
+  scheduler.runDue(probe, now + 200);
+  CHECK_EQ(0, probe.oneShot);
+  scheduler.runDue(probe, now + 300);
+  scheduler.runDue(probe, now + 400);
+  CHECK_EQ(1, probe.oneShot);
+  CHECK(!scheduler.isArmed(2));
+
+  // A 35ms stall misses the every-pass deadline and the periodic one, which
+  // then catches up once rather than three times
+  now += 35000;
+  int periodicBefore = probe.periodic;
+  scheduler.runDue(probe, now);
+  scheduler.runDue(probe, now + 100);
+  CHECK_EQ(periodicBefore + 1, probe.periodic);
+  CHECK_EQ(2, scheduler.missCount());
+  CHECK(scheduler.worstLatenessMicros() >= 33000);
+  scheduler.runDue(probe, now + 10000);
+  CHECK_EQ(periodicBefore + 2, probe.periodic);
+
+  // Deadlines survive micros() wrapping
+  CooperativeScheduler<ScheduleProbe, 3> wrapping(PROBE_TASKS);
+  wrapping.at(2, 0x100);
+  wrapping.runDue(probe, 0xFFFFFF00UL);
+  CHECK_EQ(1, probe.oneShot);
+  wrapping.runDue(probe, 0x100);
+  CHECK_EQ(2, probe.oneShot);
+  CHECK_EQ(0, wrapping.missCount());
+}
+
+/**
+ * Key a Morse pattern one paddle tap per element, leaving a character gap after it
+ */
+static void keyPattern(KeyerSim &sim, const char *pattern, uint32_t ditMs) {
+  for (const char *element = pattern; *element; element++) {
+    bool dah = *element == '-';
+    sim.press(dah ? KeyerSim::DASH : KeyerSim::DOT);
+    sim.run(ditMs / 2);
+    sim.release(dah ? KeyerSim::DASH : KeyerSim::DOT);
+    sim.run((dah ? 3 : 1) * ditMs - ditMs / 2 + ditMs);
+  }
+  sim.run(2 * ditMs);
+}
+
+static void testDecodeTree() {
+  // Every character in the international table decodes from its own node
+  MorseDecoder decoder;
+  char text[MORSE_TEXT_SIZE];
+  for (uint8_t i = 0; i < INTERNATIONAL_CODE_COUNT; i++) {
+    const MorseCode &code = INTERNATIONAL_CODES[i];
+    for (const char *element = code.pattern; *element; element++) {
+      decoder.addElement(*element);
+    }
+    CHECK_EQ(morseNode(code.pattern), decoder.finish(text));
+    // Prosigns take the punctuation patterns they share
+    if (code.symbol != '+' && code.symbol != '=' && code.symbol != '(') {
+      CHECK_EQ(code.symbol, text[0]);
+      CHECK_EQ(0, text[1]);
+    }
+  }
+
+  // Eight elements are deeper than the tree
+  for (int i = 0; i < 8; i++) {
+    decoder.addElement('.');
+  }
+  CHECK_EQ(MORSE_NODE_OVERFLOW, decoder.finish(text));
+  CHECK_EQ(0, text[0]);
+  CHECK(!decoder.pending());
+}
+
+static void testDecodesCharacters() {
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.setParam(PARAM_DECODE, 1);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u16(1) == 1);
+
+  keyPattern(sim, ".--.", 60);
+  CHECK(sim.decoded() == "P");
+  keyPattern(sim, ".-", 60);
+  keyPattern(sim, ".-.", 60);
+  keyPattern(sim, "..", 60);
+  keyPattern(sim, "...", 60);
+  sim.run(300);
+  keyPattern(sim, ".-.-.", 60);
+  keyPattern(sim, "......", 60);
+  CHECK(sim.decoded() == "PARIS AR?");
+
+  // The character is stamped with the key-up that ended it
+  const DeviceFrame *character = sim.lastFrame(FRAME_CHARACTER);
+  std::vector<SimElement> elements = sim.elements();
+  CHECK(character != 0);
+  if (character && !elements.empty()) {
+    const SimElement &last = elements.back();
+    CHECK_EQ(last.micros + last.durationMs * 1000UL, character->u32(1));
+    CHECK_EQ(morseNode("......"), character->u8(0));
+  }
+}
+
+static void testDecodeRegions() {
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.setParam(PARAM_DECODE, 1);
+  keyPattern(sim, ".-.-", 60);
+  sim.setParam(PARAM_DECODE_REGION, REGION_GERMANY);
+  keyPattern(sim, ".-.-", 60);
+  keyPattern(sim, ".-", 60);
+  sim.setParam(PARAM_DECODE_REGION, REGION_RUSSIAN);
+  keyPattern(sim, ".-.-", 60);
+  keyPattern(sim, ".-", 60);
+  CHECK(sim.decoded() == "?ÄAЯА");
+
+  sim.setParam(PARAM_DECODE_REGION, MORSE_REGION_COUNT);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u16(1) == REGION_INTERNATIONAL);
+}
+
+static void testDecodeIsOptIn() {
+  // Characters only go out once the host asks for them
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  keyPattern(sim, "-.-", 60);
+  CHECK(sim.lastFrame(FRAME_CHARACTER) == 0);
+  sim.setParam(PARAM_DECODE, 1);
+  keyPattern(sim, "-.-", 60);
+  sim.setParam(PARAM_DECODE, 0);
+  keyPattern(sim, "-.-", 60);
+  CHECK(sim.decoded() == "K");
+}
+
+/**
+ * Hand-key a pattern on a straight key: each element held for its length
+ * stretched by up to +/-jitterPercent, then a one-unit space. Ends with a
+ * character gap. Returns the updated jitter state.
+ */
+static uint32_t handKey(KeyerSim &sim, const char *pattern, uint32_t ditMs, uint8_t jitterPercent, uint32_t seed) {
+  for (const char *element = pattern; *element; element++) {
+    uint32_t length = (*element == '-' ? 3 : 1) * ditMs;
+    seed = seed * 1103515245UL + 12345UL;
+    int32_t jitter = (int32_t)((seed >> 16) % (2 * jitterPercent + 1)) - jitterPercent;
+    sim.press(KeyerSim::DOT);
+    sim.run(length + (int32_t)length * jitter / 100);
+    sim.release(KeyerSim::DOT);
+    sim.run(ditMs);
+  }
+  sim.run(2 * ditMs);
+  return seed;
+}
+
+static const char *const PARIS[] = { ".--.", ".-", ".-.", "..", "..." };
+
+static void testStraightKeyClassifies() {
+  // A sloppy fist at 20 WPM still sorts into dits and dahs
+  KeyerSim sim;
+  startKeyer(sim, 20, 'K');
+  sim.setParam(PARAM_DECODE, 1);
+  const DeviceFrame *mode = sim.lastFrame(FRAME_MODE);
+  CHECK(mode != 0 && mode->u8(0) == STRAIGHT_KEY);
+
+  uint32_t seed = 1;
+  for (int word = 0; word < 3; word++) {
+    for (int i = 0; i < 5; i++) {
+      seed = handKey(sim, PARIS[i], 60, 25, seed);
+    }
+    sim.run(300);
+  }
+  CHECK(sim.decoded() == "PARIS PARIS PARIS ");
+
+  // Elements carry the operator's own lengths, stamped at key-down
+  std::vector<SimElement> elements = sim.elements();
+  CHECK(!elements.empty());
+  if (!elements.empty()) {
+    CHECK(elements[0].durationMs >= 45 && elements[0].durationMs <= 75);
+    CHECK(elements[1].durationMs >= 135 && elements[1].durationMs <= 225);
+  }
+}
+
+static void testStraightKeyTracksDrift() {
+  // The operator slows from 20 to 9 WPM, past where a 20 WPM threshold would call dits dahs
+  KeyerSim sim;
+  startKeyer(sim, 20, 'K');
+  sim.setParam(PARAM_DECODE, 1);
+
+  std::string expected;
+  uint32_t seed = 7;
+  for (int word = 0; word < 25; word++) {
+    uint32_t ditMs = 60 + word * 3;
+    for (int i = 0; i < 5; i++) {
+      seed = handKey(sim, PARIS[i], ditMs, 10, seed);
+    }
+    sim.run(5 * ditMs);
+    expected += "PARIS ";
+  }
+  CHECK(sim.decoded() == expected);
+}
+
+static void testStraightKeyReseeds() {
+  // Starting from the default 8 WPM guess, a 30 WPM operator is found within a few characters
+  KeyerSim sim;
+  sim.begin();
+  sim.send("K");
+  sim.setParam(PARAM_DECODE, 1);
+
+  uint32_t seed = 3;
+  for (int word = 0; word < 4; word++) {
+    for (int i = 0; i < 5; i++) {
+      seed = handKey(sim, PARIS[i], 40, 10, seed);
+    }
+    sim.run(200);
+  }
+  std::string decoded = sim.decoded();
+  CHECK(decoded.size() >= 12 && decoded.compare(decoded.size() - 12, 12, "PARIS PARIS ") == 0);
+
+  // The classifier also sets the speed the gaps are judged by
+  const DeviceFrame *timing = sim.lastFrame(FRAME_TIMING);
+  CHECK(timing != 0 && timing->u8(2) >= 27 && timing->u8(2) <= 33);
+  CHECK(sizeof(DitDahClassifier) <= 10);
+}
+
+static void testBugMode() {
+  // The dot paddle runs automatic dits, the dash lever is keyed by hand
+  KeyerSim sim;
+  startKeyer(sim, 20, 'G');
+  sim.press(KeyerSim::DOT);
+  sim.run(450);
+  sim.release(KeyerSim::DOT);
+  sim.run(60);
+  sim.press(KeyerSim::DASH);
+  sim.run(230);
+  sim.release(KeyerSim::DASH);
+  sim.run(100);
+  CHECK_PATTERN("....-", sim);
+
+  std::vector<SimElement> elements = sim.elements();
+  CHECK_EQ(5, elements.size());
+  if (elements.size() == 5) {
+    CHECK_EQ(60, elements[0].durationMs);
+    CHECK_EQ(230, elements[4].durationMs);
+  }
+}
+
+static void testSidetoneFollowsKey() {
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  const HostSidetone::State &sidetone = HostSidetone::state();
+  CHECK_EQ(HostBoard::SIDETONE_PIN, sidetone.pin);
+
+  // Silent until the host asks for it
+  sim.press(KeyerSim::DOT);
+  sim.run(30);
+  sim.release(KeyerSim::DOT);
+  sim.run(300);
+  CHECK_EQ(0, sidetone.onCount);
+
+  sim.setParam(PARAM_SIDETONE, 1);
+  sim.setParam(PARAM_SIDETONE_HZ, 700);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_SIDETONE_HZ && param->u16(1) == 700);
+  CHECK_EQ(700, sidetone.hz);
+
+  // The tone starts in the tick that keys the element and lasts exactly as long
+  uint64_t pressed = hostMicros64();
+  sim.press(KeyerSim::DASH);
+  sim.run(30);
+  CHECK(sidetone.sounding);
+  sim.release(KeyerSim::DASH);
+  sim.run(300);
+  CHECK(!sidetone.sounding);
+  CHECK_EQ(1, sidetone.onCount);
+  CHECK(sidetone.onMicros - pressed <= (DEBOUNCE_DELAY + 1) * 1000UL);
+  std::vector<SimElement> elements = sim.elements();
+  CHECK_EQ(2, elements.size());
+  if (elements.size() == 2) {
+    CHECK_EQ((uint32_t)sidetone.onMicros, elements[1].micros);
+    CHECK_EQ(180000, sidetone.offMicros - sidetone.onMicros);
+  }
+
+  // Pitch is held to what every board can play
+  sim.setParam(PARAM_SIDETONE_HZ, 50);
+  CHECK_EQ(SIDETONE_MIN_HZ, sidetone.hz);
+  sim.setParam(PARAM_SIDETONE_HZ, 9000);
+  CHECK_EQ(SIDETONE_MAX_HZ, sidetone.hz);
+}
+
+static void testSidetoneStopsWhenDisabled() {
+  // A straight key sounds for as long as it is held, and switching off cuts the tone
+  KeyerSim sim;
+  startKeyer(sim, 20, 'K');
+  sim.setParam(PARAM_SIDETONE, 1);
+  const HostSidetone::State &sidetone = HostSidetone::state();
+
+  sim.press(KeyerSim::DOT);
+  sim.run(400);
+  CHECK(sidetone.sounding);
+  sim.setParam(PARAM_SIDETONE, 0);
+  CHECK(!sidetone.sounding);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_SIDETONE && param->u16(1) == 0);
+  sim.release(KeyerSim::DOT);
+  sim.run(300);
+  sim.press(KeyerSim::DOT);
+  sim.run(60);
+  sim.release(KeyerSim::DOT);
+  sim.run(300);
+  CHECK_EQ(1, sidetone.onCount);
+}
+
+/**
+ * Key-edge frames seen so far, as recorder records
+ */
+static std::vector<uint32_t> reportedEdges(const KeyerSim &sim) {
+  std::vector<uint32_t> result;
+  for (size_t i = 0; i < sim.reader.frames.size(); i++) {
+    const DeviceFrame &frame = sim.reader.frames[i];
+    if (frame.type == FRAME_KEY_EDGE) {
+      result.push_back(frame.u32(2) | (frame.u8(1) ? KeyingRecorder<1>::DOWN_BIT : 0) |
+                       (frame.u8(0) == CONTACT_DASH ? KeyingRecorder<1>::DASH_BIT : 0));
+    }
+  }
+  return result;
+}
+
+/**
+ * Records dumped since the last recording command, with full timestamps
+ * rebuilt from each frame's micros
+ */
+static std::vector<uint32_t> dumpedRecords(const KeyerSim &sim, size_t fromFrame) {
+  std::vector<uint32_t> result;
+  for (size_t i = fromFrame; i < sim.reader.frames.size(); i++) {
+    const DeviceFrame &frame = sim.reader.frames[i];
+    if (frame.type != FRAME_RECORDING) {
+      continue;
+    }
+    CHECK_EQ(result.size(), frame.u16(0));
+    uint32_t frameMicros = frame.u32(4);
+    for (size_t offset = 12; offset + 4 <= frame.body.size(); offset += 4) {
+      uint32_t record = frame.u32(offset);
+      uint32_t micros = frameMicros - ((frameMicros - record) & KeyingRecorder<1>::TIME_MASK);
+      result.push_back(micros | (record & ~KeyingRecorder<1>::TIME_MASK));
+    }
+  }
+  return result;
+}
+
+static void testKeyingRecording() {
+  // A slow host takes the dump a frame at a time, between key reports
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  for (int i = 0; i < 10; i++) {
+    sim.press(i % 3 == 0 ? KeyerSim::DASH : KeyerSim::DOT);
+    sim.run(40);
+    sim.release(i % 3 == 0 ? KeyerSim::DASH : KeyerSim::DOT);
+    sim.run(160);
+  }
+  std::vector<uint32_t> keyed = reportedEdges(sim);
+  CHECK_EQ(20, keyed.size());
+
+  size_t start = sim.reader.frames.size();
+  sim.setHostReadRate(8);
+  sim.send(recordingCommand());
+  sim.run(1);
+  // Keying during the dump is reported but not recorded over what is being sent
+  sim.press(KeyerSim::DOT);
+  sim.run(40);
+  sim.release(KeyerSim::DOT);
+  sim.run(500);
+
+  const DeviceFrame *last = sim.lastFrame(FRAME_RECORDING);
+  CHECK(last != 0);
+  if (last) {
+    CHECK_EQ(20, last->u16(2));
+    CHECK_EQ(PADDLE_IAMBIC_A, last->u8(8));
+    CHECK_EQ(20, last->u8(9));
+    CHECK_EQ(20, last->u8(10));
+    CHECK_EQ(DEBOUNCE_DELAY, last->u8(11));
+  }
+  std::vector<uint32_t> dumped = dumpedRecords(sim, start);
+  CHECK_EQ(keyed.size(), dumped.size());
+  for (size_t i = 0; i < keyed.size() && i < dumped.size(); i++) {
+    CHECK_EQ(keyed[i], dumped[i]);
+  }
+  CHECK_EQ('.', sim.elements().back().element);
+  CHECK_EQ(0, sim.reader.badFrames);
+
+  // Recording resumes once the dump is done
+  sim.setHostReadRate(-1);
+  start = sim.reader.frames.size();
+  sim.send(recordingCommand());
+  sim.run(10);
+  last = sim.lastFrame(FRAME_RECORDING);
+  CHECK(last != 0 && last->u16(2) == 22);
+  CHECK_EQ(22, dumpedRecords(sim, start).size());
+}
+
+static void testKeyingRecorderLimits() {
+  KeyingRecorder<4> recorder;
+  for (uint32_t i = 0; i < 6; i++) {
+    recorder.record(false, i % 2 == 0, 1000 * i);
+  }
+  CHECK_EQ(4, recorder.size());
+  CHECK_EQ(2000 | KeyingRecorder<4>::DOWN_BIT, recorder.at(0));
+  CHECK_EQ(5000, recorder.at(3));
+
+  // Records too old to time from the newest are dropped
+  recorder.record(true, true, 3000 + KeyingRecorder<4>::MAX_AGE_MICROS);
+  CHECK_EQ(3, recorder.size());
+  CHECK_EQ(4000 | KeyingRecorder<4>::DOWN_BIT, recorder.at(0));
+
+  // ...all of them after a long enough silence, even across the micros() wrap
+  recorder.record(false, false, 0xFFFFFF00UL);
+  recorder.record(false, true, 0x100);
+  CHECK_EQ(2, recorder.size());
+  CHECK_EQ(0x100 | KeyingRecorder<4>::DOWN_BIT, recorder.at(1));
+}
+
+static void testKeyOutputFollowsElements() {
+  // Off until the host enables it, then the key line carries each element to the tick
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.press(KeyerSim::DOT);
+  sim.run(100);
+  sim.release(KeyerSim::DOT);
+  sim.run(300);
+  CHECK(sim.pulses(HostBoard::KEY_OUT_PIN).empty());
+  CHECK(sim.pulses(HostBoard::PTT_PIN).empty());
+
+  sim.setParam(PARAM_KEY_OUTPUT, 1);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_KEY_OUTPUT && param->u16(1) == 1);
+  size_t before = sim.elements().size();
+  sim.press(KeyerSim::DASH);
+  sim.run(250);
+  sim.release(KeyerSim::DASH);
+  sim.press(KeyerSim::DOT);
+  sim.run(20);
+  sim.release(KeyerSim::DOT);
+  sim.run(400);
+
+  std::vector<SimElement> elements = sim.elements();
+  std::vector<SimPulse> keyed = sim.pulses(HostBoard::KEY_OUT_PIN);
+  CHECK_EQ(elements.size() - before, keyed.size());
+  for (size_t i = 0; i < keyed.size() && before + i < elements.size(); i++) {
+    CHECK_EQ(elements[before + i].micros, keyed[i].micros);
+    CHECK_EQ(elements[before + i].durationMs * 1000UL, keyed[i].durationMicros);
+  }
+
+  // With no lead or tail, PTT covers exactly the keying
+  std::vector<SimPulse> ptt = sim.pulses(HostBoard::PTT_PIN);
+  CHECK_EQ(keyed.size(), ptt.size());
+  CHECK(!ptt.empty() && ptt[0].micros == keyed[0].micros);
+}
+
+static void testPttSequencing() {
+  // PTT leads the first element and tails the last, holding between elements
+  // as the tail is longer than a space. The elements keep their timing.
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.setParam(PARAM_KEY_OUTPUT, 1);
+  sim.setParam(PARAM_PTT_LEAD, 10);
+  sim.setParam(PARAM_PTT_TAIL, 70);
+  sim.setParam(PARAM_PTT_LEAD, 500);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u16(1) == PTT_MAX_LEAD_MS);
+  sim.setParam(PARAM_PTT_LEAD, 10);
+
+  sim.press(KeyerSim::DOT);
+  sim.run(150);
+  sim.release(KeyerSim::DOT);
+  sim.run(400);
+  std::vector<SimElement> elements = sim.elements();
+  std::vector<SimPulse> keyed = sim.pulses(HostBoard::KEY_OUT_PIN);
+  std::vector<SimPulse> ptt = sim.pulses(HostBoard::PTT_PIN);
+  CHECK_EQ(2, keyed.size());
+  CHECK_EQ(1, ptt.size());
+  if (keyed.size() == 2 && ptt.size() == 1 && elements.size() >= 2) {
+    CHECK_EQ(elements[0].micros, ptt[0].micros);
+    CHECK_EQ(elements[0].micros + 10000, keyed[0].micros);
+    CHECK_EQ(elements[1].micros + 10000, keyed[1].micros);
+    CHECK_EQ(60000, keyed[0].durationMicros);
+    CHECK_EQ(60000, keyed[1].durationMicros);
+    CHECK_EQ(keyed[1].micros + keyed[1].durationMicros + 70000, ptt[0].micros + ptt[0].durationMicros);
+  }
+
+  // Without hang, PTT drops between characters...
+  sim.press(KeyerSim::DASH);
+  sim.run(100);
+  sim.release(KeyerSim::DASH);
+  sim.run(400);
+  CHECK_EQ(2, sim.pulses(HostBoard::PTT_PIN).size());
+
+  // ...and with seven dits of hang it stays up through a word gap
+  sim.setParam(PARAM_PTT_HANG, 7);
+  for (int i = 0; i < 2; i++) {
+    sim.press(KeyerSim::DASH);
+    sim.run(100);
+    sim.release(KeyerSim::DASH);
+    sim.run(400);
+  }
+  sim.run(500);
+  ptt = sim.pulses(HostBoard::PTT_PIN);
+  keyed = sim.pulses(HostBoard::KEY_OUT_PIN);
+  CHECK_EQ(3, ptt.size());
+  if (!ptt.empty() && !keyed.empty()) {
+    CHECK_EQ(keyed.back().micros + keyed.back().durationMicros + 70000 + 7 * 60000,
+             ptt.back().micros + ptt.back().durationMicros);
+  }
+
+  // Switching the output off releases PTT at once, mid-element
+  sim.press(KeyerSim::DASH);
+  sim.run(100);
+  sim.setParam(PARAM_KEY_OUTPUT, 0);
+  CHECK_EQ(LOW, hostPinLevel(HostBoard::KEY_OUT_PIN));
+  CHECK_EQ(LOW, hostPinLevel(HostBoard::PTT_PIN));
+  sim.release(KeyerSim::DASH);
+  sim.run(400);
+  CHECK_EQ(4, sim.pulses(HostBoard::PTT_PIN).size());
+}
+
+static void testPttLongestLead() {
+  // At 60 WPM a 50ms lead holds several elements in the delay line at once,
+  // and each still comes out whole, 50ms late
+  KeyerSim sim;
+  startKeyer(sim, 60);
+  sim.setParam(PARAM_KEY_OUTPUT, 1);
+  sim.setParam(PARAM_PTT_LEAD, PTT_MAX_LEAD_MS);
+  sim.press(KeyerSim::DOT);
+  sim.press(KeyerSim::DASH);
+  sim.run(400);
+  sim.release(KeyerSim::DOT);
+  sim.release(KeyerSim::DASH);
+  sim.run(400);
+
+  std::vector<SimElement> elements = sim.elements();
+  std::vector<SimPulse> keyed = sim.pulses(HostBoard::KEY_OUT_PIN);
+  std::vector<SimPulse> ptt = sim.pulses(HostBoard::PTT_PIN);
+  CHECK(elements.size() >= 6);
+  CHECK_EQ(elements.size(), keyed.size());
+  for (size_t i = 0; i < keyed.size() && i < elements.size(); i++) {
+    CHECK_EQ(elements[i].micros + PTT_MAX_LEAD_MS * 1000UL, keyed[i].micros);
+    CHECK_EQ(elements[i].durationMs * 1000UL, keyed[i].durationMicros);
+  }
+  CHECK_EQ(1, ptt.size());
+  if (!ptt.empty() && !elements.empty()) {
+    CHECK_EQ(elements[0].micros, ptt[0].micros);
+    CHECK_EQ(keyed.back().micros + keyed.back().durationMicros, ptt[0].micros + ptt[0].durationMicros);
+  }
+}
+
+static void testElementShape() {
+  // 20 WPM, 60% weighting: elements gain 12ms and their spaces lose it
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.setParam(PARAM_WEIGHTING, 60);
+  sim.setParam(PARAM_DAH_RATIO, 35);
+  sim.press(KeyerSim::DOT);
+  sim.run(150);
+  sim.release(KeyerSim::DOT);
+  sim.run(300);
+  sim.press(KeyerSim::DASH);
+  sim.run(100);
+  sim.release(KeyerSim::DASH);
+  sim.run(400);
+
+  std::vector<SimElement> elements = sim.elements();
+  CHECK_EQ(3, elements.size());
+  if (elements.size() == 3) {
+    CHECK_EQ(72, elements[0].durationMs);
+    CHECK_EQ(72, elements[1].durationMs);
+    CHECK_EQ(120000, elements[1].micros - elements[0].micros);
+    CHECK_EQ(222, elements[2].durationMs);
+  }
+
+  sim.setParam(PARAM_WEIGHTING, 90);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_WEIGHTING && param->u16(1) == MAX_WEIGHTING);
+  sim.setParam(PARAM_DAH_RATIO, 0);
+  param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_DAH_RATIO && param->u16(1) == MIN_DAH_RATIO);
+}
+
+static void testGetParam() {
+  KeyerSim sim;
+  startKeyer(sim, 22, 'B');
+  sim.send(getParamCommand(PARAM_WPM));
+  sim.run(1);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_WPM && param->u16(1) == 22);
+  sim.send(getParamCommand(PARAM_KEY_MODE));
+  sim.run(1);
+  param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_KEY_MODE && param->u16(1) == PADDLE_IAMBIC_B);
+  sim.send(getParamCommand(PARAM_WEIGHTING));
+  sim.run(1);
+  param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_WEIGHTING && param->u16(1) == DEFAULT_WEIGHTING);
+
+  // An unknown parameter gets no answer
+  size_t frames = sim.reader.frames.size();
+  sim.send(getParamCommand(0x7F));
+  sim.run(1);
+  CHECK_EQ(frames, sim.reader.frames.size());
+}
+
+static void testSettingsSurvivePowerCycle() {
+  HostParamStore::State saved;
+  {
+    KeyerSim sim;
+    startKeyer(sim, 25, 'B');
+    sim.setParam(PARAM_WEIGHTING, 55);
+    sim.setParam(PARAM_SIDETONE_HZ, 800);
+    sim.setParam(PARAM_KEY_OUTPUT, 1);
+    sim.run(1000);
+    CHECK_EQ(0, HostParamStore::state().writes);  // Not until the settings are left alone
+    sim.run(3000);
+    CHECK_EQ(1, HostParamStore::state().writes);
+    saved = HostParamStore::state();
+  }
+
+  // Power up: the handshake is all the host sends, and the keyer is as it was left
+  KeyerSim sim;
+  HostParamStore::state() = saved;
+  sim.begin();
+  const DeviceFrame *hello = sim.lastFrame(FRAME_HELLO);
+  CHECK(hello != 0 && hello->u8(3) == PADDLE_IAMBIC_B);
+  const DeviceFrame *timing = sim.lastFrame(FRAME_TIMING);
+  CHECK(timing != 0 && timing->u8(2) == 25);
+  CHECK_EQ(800, HostSidetone::state().hz);
+
+  // 25 WPM at 55%: a 48ms dit gains 4ms
+  sim.press(KeyerSim::DOT);
+  sim.run(40);
+  sim.release(KeyerSim::DOT);
+  sim.run(300);
+  std::vector<SimElement> elements = sim.elements();
+  CHECK_EQ(1, elements.size());
+  CHECK(!elements.empty() && elements[0].durationMs == 52);
+
+  sim.send(getParamCommand(PARAM_WEIGHTING));
+  sim.run(1);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u16(1) == 55);
+
+  // The key output is never switched on by a saved setting
+  sim.send(getParamCommand(PARAM_KEY_OUTPUT));
+  sim.run(1);
+  param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u16(1) == 0);
+
+  // Setting what is already saved does not wear the store
+  sim.setParam(PARAM_WPM, 25);
+  sim.run(4000);
+  CHECK_EQ(1, HostParamStore::state().writes);
+  sim.send("K");
+  sim.run(4000);
+  CHECK_EQ(2, HostParamStore::state().writes);
+
+  // A damaged block is ignored
+  KeyerSim damaged;
+  HostParamStore::state() = saved;
+  HostParamStore::state().block.bytes[1] ^= 0x01;
+  damaged.begin();
+  timing = damaged.lastFrame(FRAME_TIMING);
+  CHECK(timing != 0 && timing->u8(2) != 25);
+  hello = damaged.lastFrame(FRAME_HELLO);
+  CHECK(hello != 0 && hello->u8(3) == PADDLE_IAMBIC_A);
+}
+
+static void testIdleSleepWakesOnPaddle() {
+  // Quiet long enough to sleep, then a dot pressed while asleep
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  HostIdleSleep::state().allowed = true;
+  // Quiet from when the settings startKeyer() sent are saved
+  const uint32_t pressMs = PARAM_SAVE_DELAY_MICROS / 1000 + IDLE_SLEEP_AFTER_MS + 2000;
+  uint64_t pressMicros = hostMicros64() + pressMs * 1000ULL;
+  sim.pressAt(KeyerSim::DOT, pressMs);
+  sim.releaseAt(KeyerSim::DOT, pressMs + 40);
+  sim.run(1000);
+  CHECK(HostIdleSleep::state().dozes > 0);
+  CHECK_EQ(0, HostIdleSleep::state().sleeps);
+  sim.run(pressMs);
+  CHECK_EQ(1, HostIdleSleep::state().sleeps);
+
+  // The waking edge is reported at the wake, and the dit follows it after the debounce
+  const DeviceFrame *edge = 0;
+  for (size_t i = 0; i < sim.reader.frames.size() && edge == 0; i++) {
+    if (sim.reader.frames[i].type == FRAME_KEY_EDGE) {
+      edge = &sim.reader.frames[i];
+    }
+  }
+  CHECK(edge != 0 && edge->u8(0) == CONTACT_DOT && edge->u8(1) == 1);
+  uint32_t edgeMicros = edge ? edge->u32(2) : 0;
+  CHECK(edgeMicros - (uint32_t)pressMicros <= HostIdleSleep::SLEEP_STEP_MICROS);
+  CHECK_PATTERN("./", sim);
+  std::vector<SimElement> elements = sim.elements();
+  uint32_t wakeLatency = elements.empty() ? 0 : elements[0].micros - edgeMicros;
+  CHECK(wakeLatency >= DEBOUNCE_DELAY * 1000UL && wakeLatency <= (DEBOUNCE_DELAY + 2) * 1000UL);
+
+  sim.send(telemetryCommand());
+  sim.run(1);
+  const DeviceFrame *report = sim.lastFrame(FRAME_SLEEP);
+  CHECK(report != 0);
+  if (report) {
+    CHECK_EQ(1, report->u16(0));
+    CHECK_EQ(1, report->u16(2));
+    CHECK_EQ(wakeLatency, report->u32(4));
+    CHECK_EQ(wakeLatency, report->u32(8));
+  }
+  // Sleeping is not a stalled loop
+  report = sim.lastFrame(FRAME_TELEMETRY);
+  CHECK(report != 0 && report->u16(38) < 10);
+}
+
+static void testIdleSleepWaitsForHost() {
+  // A host with the port open keeps the keyer dozing
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.run(IDLE_SLEEP_AFTER_MS + 5000);
+  CHECK_EQ(0, HostIdleSleep::state().sleeps);
+  CHECK(HostIdleSleep::state().dozes > 0);
+
+  // Without one it sleeps, waking on the timer to listen for a host
+  HostIdleSleep::state().allowed = true;
+  sim.run(3 * (IDLE_SLEEP_MAX_MS + IDLE_LISTEN_MS));
+  CHECK(HostIdleSleep::state().sleeps >= 3);
+  CHECK(HostIdleSleep::state().sleeps <= 4);
+
+  // ...and stays awake once a command arrives
+  HostIdleSleep::state().allowed = false;
+  uint32_t sleeps = HostIdleSleep::state().sleeps;
+  sim.send(telemetryCommand());
+  sim.run(IDLE_SLEEP_MAX_MS + IDLE_LISTEN_MS);
+  CHECK_EQ(sleeps, HostIdleSleep::state().sleeps);
+  const DeviceFrame *report = sim.lastFrame(FRAME_SLEEP);
+  CHECK(report != 0 && report->u16(0) == sleeps && report->u16(2) == 0);
+}
+
+/**
+ * FRAME_KEY_EDGEs from the receiver tone, in order
+ */
+static std::vector<DeviceFrame> toneEdges(const KeyerSim &sim) {
+  std::vector<DeviceFrame> result;
+  for (size_t i = 0; i < sim.reader.frames.size(); i++) {
+    const DeviceFrame &frame = sim.reader.frames[i];
+    if (frame.type == FRAME_KEY_EDGE && frame.u8(0) == CONTACT_TONE) {
+      result.push_back(frame);
+    }
+  }
+  return result;
+}
+
+static void testToneDecoderReportsKeying() {
+  // "PARIS" at 18 WPM on a 700Hz tone, with the receiver's noise already
+  // playing when decoding starts
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  std::vector<AudioKeyDown> keyDowns;
+  AudioClip clip = keyedTone(".--. .- .-. .. ...", 18, 700, 400, 100, &keyDowns);
+  uint64_t startMicros = sim.playAudio(clip);
+  sim.run(100);
+  sim.setParam(PARAM_TONE_DECODE, 1);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_TONE_DECODE && param->u16(1) == 1);
+  sim.run(clip.samples.size() * 1000 / clip.sampleHz);
+
+  // Each edge lands where it is in the audio, well inside a 5ms block
+  std::vector<DeviceFrame> edges = toneEdges(sim);
+  CHECK_EQ(2 * keyDowns.size(), edges.size());
+  uint32_t worstError = 0;
+  for (size_t i = 0; i < edges.size() && i / 2 < keyDowns.size(); i++) {
+    uint64_t sample = i % 2 == 0 ? keyDowns[i / 2].start : keyDowns[i / 2].end;
+    uint32_t expected = (uint32_t)(startMicros + sample * 1000000ULL / clip.sampleHz);
+    CHECK_EQ(i % 2 == 0, edges[i].u8(1));
+    int32_t error = (int32_t)(edges[i].u32(2) - expected);
+    uint32_t size = error < 0 ? -error : error;
+    worstError = size > worstError ? size : worstError;
+  }
+  CHECK(worstError <= 1000);
+
+  // Received tones never key the keyer or its sidetone
+  CHECK(sim.elements().empty());
+  CHECK_EQ(0, HostSidetone::state().onCount);
+  CHECK_EQ(0, sim.reader.badFrames);
+}
+
+static void testToneDecoderIsSelective() {
+  KeyerSim sim;
+  startKeyer(sim, 20);
+  sim.setParam(PARAM_TONE_HZ, 100);
+  const DeviceFrame *param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_TONE_HZ && param->u16(1) == TONE_MIN_HZ);
+  sim.setParam(PARAM_TONE_HZ, 600);
+
+  // A strong station 800Hz away, with a weaker one on the pitch joining half way
+  AudioClip clip = keyedTone("-.-. --.- -.-. --.-", 20, 1400, 1500, 20);
+  AudioClip wanted = keyedTone("- . ... -", 25, 600, 300, 0);
+  size_t joins = clip.samples.size() / 2;
+  for (size_t i = 0; i < wanted.samples.size() && joins + i < clip.samples.size(); i++) {
+    clip.samples[joins + i] += wanted.samples[i] - ADC_BIAS;
+  }
+  uint64_t startMicros = sim.playAudio(clip);
+  sim.setParam(PARAM_TONE_DECODE, 1);
+  sim.run(clip.samples.size() * 1000 / clip.sampleHz);
+
+  // Only the one on the pitch is heard
+  std::vector<DeviceFrame> edges = toneEdges(sim);
+  CHECK_EQ(2 * 6, edges.size());
+  CHECK(!edges.empty() && edges[0].u32(2) - (uint32_t)startMicros > joins * 1000000ULL / clip.sampleHz);
+
+  // Switched off, the audio is no longer read
+  sim.setParam(PARAM_TONE_DECODE, 0);
+  param = sim.lastFrame(FRAME_PARAM);
+  CHECK(param != 0 && param->u8(0) == PARAM_TONE_DECODE && param->u16(1) == 0);
+  sim.playAudio(wanted);
+  sim.run(wanted.samples.size() * 1000 / wanted.sampleHz);
+  CHECK_EQ(2 * 6, toneEdges(sim).size());
+}
+
+struct TestCase {
+  const char *name;
+  void (*run)();
+};
+
+static const TestCase TESTS[] = {
+  { "handshake", testHandshake },
+  { "held dot repeats at speed", testHeldDotRepeatsAtSpeed },
+  { "held dah repeats at speed", testHeldDahRepeatsAtSpeed },
+  { "speed limits", testSpeedLimits },
+  { "squeeze alternates", testSqueezeAlternates },
+  { "mode A stops on release", testModeAStopsOnRelease },
+  { "mode B sends one more element", testModeBSendsOneMoreElement },
+  { "mode B remembers a tap", testModeBRemembersTap },
+  { "debounce latency", testDebounceLatency },
+  { "chatter is filtered", testChatterIsFiltered },
+  { "slow loop keeps timing", testSlowLoopKeepsTiming },
+  { "word gap", testWordGap },
+  { "adaptive timing", testAdaptiveTiming },
+  { "text mode", testTextMode },
+  { "LED test does not block", testLedTestDoesNotBlock },
+  { "debug reports from flash", testDebugReportsFromFlash },
+  { "stalled host does not block", testStalledHostDoesNotBlock },
+  { "slow host gets every frame", testSlowHostGetsEveryFrame },
+  { "telemetry", testTelemetry },
+  { "scheduler", testScheduler },
+  { "decode tree", testDecodeTree },
+  { "decodes characters", testDecodesCharacters },
+  { "decode regions", testDecodeRegions },
+  { "decode is opt-in", testDecodeIsOptIn },
+  { "straight key classifies", testStraightKeyClassifies },
+  { "straight key tracks drift", testStraightKeyTracksDrift },
+  { "straight key reseeds", testStraightKeyReseeds },
+  { "bug mode", testBugMode },
+  { "sidetone follows the key", testSidetoneFollowsKey },
+  { "sidetone stops when disabled", testSidetoneStopsWhenDisabled },
+  { "keying recording", testKeyingRecording },
+  { "keying recorder limits", testKeyingRecorderLimits },
+  { "key output follows elements", testKeyOutputFollowsElements },
+  { "PTT sequencing", testPttSequencing },
+  { "PTT longest lead", testPttLongestLead },
+  { "element shape", testElementShape },
+  { "get param", testGetParam },
+  { "settings survive a power cycle", testSettingsSurvivePowerCycle },
+  { "idle sleep wakes on a paddle", testIdleSleepWakesOnPaddle },
+  { "idle sleep waits for the host", testIdleSleepWaitsForHost },
+  { "tone decoder reports receiver keying", testToneDecoderReportsKeying },
+  { "tone decoder is selective", testToneDecoderIsSelective },
+};
+
+int main() {
+  for (size_t i = 0; i < sizeof(TESTS) / sizeof(TESTS[0]); i++) {
+    int before = failures;
+    TESTS[i].run();
+    printf("%s %s\n", failures == before ? "ok  " : "FAIL", TESTS[i].name);
+  }
+  printf("\n%d checks, %d failed\n", checks, failures);
+  return failures == 0 ? 0 : 1;
+}
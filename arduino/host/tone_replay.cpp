@@ -0,0 +1,219 @@
+/**
+ * tone_replay.cpp
+ * Replay receiver audio through the host build of the keyer's tone decoder
+ *
+ * Usage: tone_replay trace...
+ *
+ * A tone trace is a trace file (see HostTrace.h) with these events:
+ *
+ *   # comment
+ *   0      pitch 700       tone decoder pitch in Hz
+ *   0      audio cq.wav    start playing a WAV file, relative to the trace
+ *   100    decode 1        tone decoding on or off
+ *   0      expect CQ/TEST  text the key edges must spell ('/' between words)
+ *
+ * Prints every key-down the keyer reports from the audio with its start
+ * time, duration and the gap after it, then the elements and text they
+ * read as. The shortest key-down is taken as the dit, so a clip needs at
+ * least one: a key-down under two dits is a dot, a gap of two dits ends a
+ * character and one of five a word. Last come the levels a detector at
+ * the pitch measured in each clip, to show how much margin the decoder
+ * had. Exits non-zero if a trace's expect line does not match, so
+ * recordings double as regression tests.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "HostTrace.h"
+#include "KeyerSim.h"
+
+struct KeyDown {
+  uint32_t micros;
+  uint32_t durationMicros;
+  uint32_t gapMicros;  // To the next key-down, 0 after the last
+};
+
+/**
+ * Levels at the pitch through one clip, in ADC counts
+ */
+struct ClipLevels {
+  std::string name;
+  uint16_t pitch;
+  uint16_t strongest;    // Loudest block
+  uint16_t weakestPeak;  // Signal level the detector followed a fade down to, 0 if the key never went down
+  uint16_t noise;        // Noise floor at the end of the clip
+};
+
+static std::string traceDirectory(const char *path) {
+  std::string directory(path);
+  size_t slash = directory.rfind('/');
+  return slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+}
+
+/**
+ * Run a clip through a detector of its own, block by block
+ */
+static ClipLevels measureClip(const std::string &name, const AudioClip &clip, uint16_t pitch) {
+  ToneDetector detector;
+  ClipLevels levels = { name, detector.begin(clip.sampleHz, pitch), 0, 0, 0 };
+  for (size_t i = 0; i < clip.samples.size(); i++) {
+    detector.addSample(clip.samples[i]);
+    if ((i + 1) % detector.samplesPerBlock() != 0) {
+      continue;
+    }
+    uint16_t level = detector.level();
+    if (level > levels.strongest) {
+      levels.strongest = level;
+    }
+    if (detector.isKeyDown() && (levels.weakestPeak == 0 || detector.peakLevel() < levels.weakestPeak)) {
+      levels.weakestPeak = detector.peakLevel();
+    }
+  }
+  levels.noise = detector.noiseLevel();
+  return levels;
+}
+
+/**
+ * Apply one event
+ * @return false if it is not a tone trace event or its audio cannot be read
+ */
+static bool applyEvent(KeyerSim &sim, const TraceEvent &event, const std::string &directory, uint64_t &audioEnd,
+                       uint16_t &pitch, std::vector<ClipLevels> &levels) {
+  if (event.what == "expect") {
+    // Checked once the replay is complete
+  } else if (event.what == "pitch") {
+    pitch = atoi(event.argument.c_str());
+    sim.setParam(PARAM_TONE_HZ, pitch);
+  } else if (event.what == "decode") {
+    sim.setParam(PARAM_TONE_DECODE, atoi(event.argument.c_str()));
+  } else if (event.what == "audio") {
+    AudioClip clip;
+    if (!loadWav((directory + event.argument).c_str(), clip)) {
+      return false;
+    }
+    audioEnd = sim.playAudio(clip) + clip.samples.size() * 1000000ULL / clip.sampleHz;
+    levels.push_back(measureClip(event.argument, clip, pitch));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Pair up the tone edges into key-downs
+ */
+static std::vector<KeyDown> keyDowns(const KeyerSim &sim) {
+  std::vector<KeyDown> downs;
+  bool down = false;
+  for (size_t i = 0; i < sim.reader.frames.size(); i++) {
+    const DeviceFrame &frame = sim.reader.frames[i];
+    if (frame.type != FRAME_KEY_EDGE || frame.u8(0) != CONTACT_TONE) {
+      continue;
+    }
+    uint32_t micros = frame.u32(2);
+    if (frame.u8(1) && !down) {
+      if (!downs.empty()) {
+        downs.back().gapMicros = micros - (downs.back().micros + downs.back().durationMicros);
+      }
+      KeyDown keyDown = { micros, 0, 0 };
+      downs.push_back(keyDown);
+    } else if (!frame.u8(1) && down) {
+      downs.back().durationMicros = micros - downs.back().micros;
+    }
+    down = frame.u8(1);
+  }
+  return downs;
+}
+
+static bool replay(const char *path) {
+  std::vector<TraceEvent> events;
+  if (!loadTrace(path, events)) {
+    return false;
+  }
+
+  KeyerSim sim;
+  sim.begin();
+  uint64_t startMicros = hostMicros64();
+  uint64_t audioEnd = startMicros;
+  uint16_t pitch = TONE_DEFAULT_HZ;
+  std::vector<ClipLevels> levels;
+  std::string directory = traceDirectory(path);
+  for (size_t i = 0; i < events.size(); i++) {
+    uint64_t due = startMicros + events[i].micros;
+    if (due > hostMicros64()) {
+      sim.runMicros((uint32_t)(due - hostMicros64()));
+    }
+    if (!applyEvent(sim, events[i], directory, audioEnd, pitch, levels)) {
+      fprintf(stderr, "%s: cannot apply '%s %s'\n", path, events[i].what.c_str(), events[i].argument.c_str());
+      return false;
+    }
+  }
+  if (audioEnd > hostMicros64()) {
+    sim.runMicros((uint32_t)(audioEnd - hostMicros64()));
+  }
+  sim.run(100);
+
+  std::vector<KeyDown> downs = keyDowns(sim);
+  uint32_t dit = 0;
+  for (size_t i = 0; i < downs.size(); i++) {
+    if (downs[i].durationMicros != 0 && (dit == 0 || downs[i].durationMicros < dit)) {
+      dit = downs[i].durationMicros;
+    }
+  }
+
+  printf("%s\n", path);
+  printf("  element  start_ms  duration_ms  gap_ms\n");
+  MorseDecoder decoder;
+  std::string elements;
+  std::string text;
+  for (size_t i = 0; i < downs.size() && dit != 0; i++) {
+    const KeyDown &down = downs[i];
+    char element = down.durationMicros < 2 * dit ? '.' : '-';
+    printf("  %c        %9.3f  %11.3f  %6.3f\n", element, (uint32_t)(down.micros - (uint32_t)startMicros) / 1000.0,
+           down.durationMicros / 1000.0, down.gapMicros / 1000.0);
+    elements += element;
+    decoder.addElement(element);
+    if (down.gapMicros == 0 || down.gapMicros >= 2 * dit) {
+      char character[MORSE_TEXT_SIZE];
+      decoder.finish(character);
+      text += character[0] ? character : "?";
+      elements += ' ';
+    }
+    if (down.gapMicros >= 5 * dit) {
+      text += '/';
+      elements += "/ ";
+    }
+  }
+
+  printf("  elements: %s\n", elements.c_str());
+  printf("  text: %s\n", text.c_str());
+  printf("  key-downs: %u, dit %.3f ms (%.1f WPM), bad frames: %u\n", (unsigned)downs.size(), dit / 1000.0,
+         dit ? 1200000.0 / dit : 0.0, sim.reader.badFrames);
+  for (size_t i = 0; i < levels.size(); i++) {
+    printf("  %s at %u Hz: strongest %u, faded to %u, noise floor %u ADC counts\n", levels[i].name.c_str(),
+           levels[i].pitch, levels[i].strongest, levels[i].weakestPeak, levels[i].noise);
+  }
+
+  bool ok = sim.reader.badFrames == 0;
+  for (size_t i = 0; i < events.size(); i++) {
+    if (events[i].what == "expect" && events[i].argument != text) {
+      fprintf(stderr, "%s: expected %s, decoded %s\n", path, events[i].argument.c_str(), text.c_str());
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s trace...\n", argv[0]);
+    return 2;
+  }
+
+  bool ok = true;
+  for (int i = 1; i < argc; i++) {
+    ok = replay(argv[i]) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+/**
+ * DitDahClassifier.h
+ * Online two-cluster classifier for hand-timed key-down lengths
+ *
+ * A straight key leaves the element lengths to the operator, so a dit and a
+ * dah are told apart by length alone. The classifier keeps one centroid for
+ * each, k-means style: a key-down goes to the nearer centroid, which then
+ * moves a quarter of the way towards it. The centroids follow the
+ * operator's fist as it speeds up, slows down or changes weighting, in a
+ * few bytes of RAM.
+ *
+ * Two guards keep the clusters meaningful:
+ *   - the dah centroid is kept at least twice the dit centroid, so the two
+ *     cannot merge;
+ *   - if RESEED_RUN key-downs in a row land in one cluster but span more
+ *     than 2:1, the operator has changed speed past the threshold. The
+ *     centroids are then reseeded from the shortest and longest of the run.
+ *
+ * Lengths are in keyer ticks. Centroids carry CENTROID_FRACTION_BITS of
+ * fraction so a slow drift is not lost to rounding.
+ */
+
+#ifndef MORSE_KEYER_DIT_DAH_CLASSIFIER_H
+#define MORSE_KEYER_DIT_DAH_CLASSIFIER_H
+
+#include <Arduino.h>
+
+class DitDahClassifier {
+public:
+  // Longest key-down that moves a centroid; longer holds count as this
+  static const uint16_t MAX_SAMPLE_TICKS = 2000;
+  // One-cluster run that triggers a reseed
+  static const uint8_t RESEED_RUN = 16;
+
+  DitDahClassifier() {
+    reset(150);
+  }
+
+  /**
+   * Start again from a dit length, with the dah at three dits
+   */
+  void reset(uint16_t ditTicks) {
+    ditCentroid = scale(ditTicks);
+    dahCentroid = scale(3 * ditTicks);
+    runLength = 0;
+    runIsDah = false;
+    runShortest = 0;
+    runLongest = 0;
+  }
+
+  /**
+   * Classify one key-down and update the clusters
+   * @return '.' or '-'
+   */
+  char classify(uint16_t ticks) {
+    if (ticks > MAX_SAMPLE_TICKS) {
+      ticks = MAX_SAMPLE_TICKS;
+    }
+
+    bool isDah = nearerDah(ticks);
+    trackRun(isDah, ticks);
+    if (runLength >= RESEED_RUN && runLongest >= 2 * runShortest) {
+      ditCentroid = scale(runShortest);
+      dahCentroid = scale(runLongest);
+      runLength = 0;
+      isDah = nearerDah(ticks);
+    }
+
+    // A held key counts as twice the dah, so it nudges rather than drags the centroid
+    uint32_t sample = scale(ticks);
+    if (isDah) {
+      if (sample > 2UL * dahCentroid) {
+        sample = 2UL * dahCentroid;
+      }
+      dahCentroid = moveTowards(dahCentroid, sample);
+      if (dahCentroid < 2 * ditCentroid) {
+        ditCentroid = dahCentroid / 2;
+      }
+    } else {
+      ditCentroid = moveTowards(ditCentroid, sample);
+      if (dahCentroid < 2 * ditCentroid) {
+        dahCentroid = 2 * ditCentroid;
+      }
+    }
+    return isDah ? '-' : '.';
+  }
+
+  /**
+   * Unit length implied by both clusters, in ticks
+   */
+  uint16_t unitTicks() const {
+    return (ditCentroid + dahCentroid / 3) >> (CENTROID_FRACTION_BITS + 1);
+  }
+
+  uint16_t ditTicks() const {
+    return ditCentroid >> CENTROID_FRACTION_BITS;
+  }
+
+  uint16_t dahTicks() const {
+    return dahCentroid >> CENTROID_FRACTION_BITS;
+  }
+
+private:
+  static const uint8_t CENTROID_FRACTION_BITS = 4;
+  static const uint8_t CENTROID_SMOOTHING_SHIFT = 2;  // Weight of a new sample (1/4)
+
+  uint16_t ditCentroid;   // Ticks << CENTROID_FRACTION_BITS
+  uint16_t dahCentroid;
+  uint8_t runLength;      // Key-downs in a row in the same cluster
+  bool runIsDah;
+  uint16_t runShortest;   // Ticks
+  uint16_t runLongest;
+
+  static uint16_t scale(uint16_t ticks) {
+    return (ticks > MAX_SAMPLE_TICKS ? MAX_SAMPLE_TICKS : ticks) << CENTROID_FRACTION_BITS;
+  }
+
+  static uint16_t moveTowards(uint16_t centroid, uint32_t sample) {
+    return centroid - (centroid >> CENTROID_SMOOTHING_SHIFT) + (sample >> CENTROID_SMOOTHING_SHIFT);
+  }
+
+  bool nearerDah(uint16_t ticks) const {
+    return 2UL * scale(ticks) > (uint32_t)ditCentroid + dahCentroid;
+  }
+
+  void trackRun(bool isDah, uint16_t ticks) {
+    if (runLength == 0 || isDah != runIsDah) {
+      runLength = 0;
+      runIsDah = isDah;
+      runShortest = ticks;
+      runLongest = ticks;
+    }
+    if (runLength < 255) {
+      runLength++;
+    }
+    if (ticks < runShortest) {
+      runShortest = ticks;
+    }
+    if (ticks > runLongest) {
+      runLongest = ticks;
+    }
+  }
+};
+
+#endif // MORSE_KEYER_DIT_DAH_CLASSIFIER_H
@@ -0,0 +1,308 @@
+/**
+ * IambicKeyer.h
+ * Tick-driven iambic keyer engine
+ *
+ * Runs from the 1 kHz keyer tick interrupt. Each tick takes the debounced
+ * paddle states and advances a three-state machine:
+ *
+ *   IDLE -> KEY_DOWN (1 or 3 units) -> ELEMENT_SPACE (1 unit) -> KEY_DOWN or IDLE
+ *
+ * Element and spacing lengths are counted in ticks, so they stay exact no
+ * matter what loop() is doing, and the next element starts on the tick the
+ * spacing ends.
+ *
+ * The element shape can be set: a dah lasts the dah ratio in dits (3 by
+ * default), and weighting moves time between each element and the space
+ * after it. At 50% weighting a dit and its space are one unit each; at 60%
+ * the key is down for 1.2 units and up for 0.8, so the element rhythm stays
+ * on the unit grid.
+ *
+ * Mode A (Curtis A): the next element is chosen from the paddles as they are
+ * at the end of the element space. Squeezing alternates; releasing both
+ * paddles stops the keyer after the element in progress.
+ *
+ * Mode B: a paddle pressed while an element is being sent is remembered, so
+ * releasing a squeeze sends one more alternating element, then stops.
+ *
+ * The hand-keyed modes share the tick and its events:
+ *
+ * Straight key: either contact keys directly. The key-down is timed in
+ * ticks and classified as a dit or dah by a DitDahClassifier when the key
+ * comes up, so the element is reported at key-up with its measured length.
+ *
+ * Bug: the dot paddle sends automatic dits at the keyer speed, as above;
+ * the dash lever keys directly and always makes a dah.
+ */
+
+#ifndef MORSE_KEYER_IAMBIC_KEYER_H
+#define MORSE_KEYER_IAMBIC_KEYER_H
+
+#include <Arduino.h>
+#include "DitDahClassifier.h"
+
+// Key mode definitions
+enum KeyMode {
+  PADDLE_IAMBIC_A,  // Paddle used in iambic mode A (Curtis A - true implementation)
+  PADDLE_IAMBIC_B,  // Paddle used in iambic mode B
+  STRAIGHT_KEY,     // Straight key on either contact
+  BUG               // Semi-automatic key: automatic dits, manual dahs
+};
+
+// Element shape limits
+const uint8_t DEFAULT_WEIGHTING = 50;   // Percent of a dit and its space spent key-down
+const uint8_t MIN_WEIGHTING = 25;
+const uint8_t MAX_WEIGHTING = 75;
+const uint8_t DEFAULT_DAH_RATIO = 30;   // Dah length in tenths of a dit
+const uint8_t MIN_DAH_RATIO = 20;
+const uint8_t MAX_DAH_RATIO = 45;
+
+class IambicKeyer {
+public:
+  // Events returned by tick()
+  static const uint8_t KEY_DOWN = 0x01;  // The key went down
+  static const uint8_t KEY_UP = 0x02;    // The key came up
+  static const uint8_t ELEMENT = 0x04;   // element()/elementTicks() describe a new element -
+                                         // with KEY_DOWN when timed by the keyer, KEY_UP when keyed by hand
+
+  IambicKeyer()
+    : state(IDLE),
+      mode(PADDLE_IAMBIC_A),
+      ditTicks(150),
+      weighting(DEFAULT_WEIGHTING),
+      dahRatio(DEFAULT_DAH_RATIO),
+      remaining(0),
+      currentElement('\0'),
+      elementLength(0),
+      dotMemory(false),
+      dashMemory(false),
+      dotWasPressed(false),
+      dashWasPressed(false) {}
+
+  /**
+   * Change mode and return to idle. Call with the keyer tick locked.
+   */
+  void setMode(KeyMode newMode) {
+    mode = newMode;
+    state = IDLE;
+    currentElement = '\0';
+    dotMemory = false;
+    dashMemory = false;
+    classifier.reset(ditTicks);
+  }
+
+  /**
+   * Restart the dit/dah classifier from the current unit length, e.g. after
+   * the host sets a speed. Call with the keyer tick locked.
+   */
+  void resetClassifier() {
+    classifier.reset(ditTicks);
+  }
+
+  const DitDahClassifier &ditDahClassifier() const {
+    return classifier;
+  }
+
+  /**
+   * True for the modes where the operator times elements by hand
+   */
+  bool isManual() const {
+    return mode == STRAIGHT_KEY || mode == BUG;
+  }
+
+  /**
+   * Set the unit length. Takes effect from the next element or space.
+   * Call with the keyer tick locked.
+   */
+  void setDitTicks(uint16_t ticks) {
+    ditTicks = ticks > 0 ? ticks : 1;
+  }
+
+  /**
+   * Set the weighting (percent) and dah ratio (tenths of a dit), clamped to
+   * their limits. Takes effect from the next element. Call with the keyer
+   * tick locked.
+   */
+  void setShape(uint8_t newWeighting, uint8_t newDahRatio) {
+    weighting = newWeighting < MIN_WEIGHTING ? MIN_WEIGHTING : (newWeighting > MAX_WEIGHTING ? MAX_WEIGHTING : newWeighting);
+    dahRatio = newDahRatio < MIN_DAH_RATIO ? MIN_DAH_RATIO : (newDahRatio > MAX_DAH_RATIO ? MAX_DAH_RATIO : newDahRatio);
+  }
+
+  uint8_t weightingPercent() const {
+    return weighting;
+  }
+
+  uint8_t dahRatioTenths() const {
+    return dahRatio;
+  }
+
+  KeyMode keyMode() const {
+    return mode;
+  }
+
+  /**
+   * True when no element or element space is under way
+   */
+  bool isIdle() const {
+    return state == IDLE;
+  }
+
+  /**
+   * True from a KEY_DOWN event until its KEY_UP
+   */
+  bool isKeyDown() const {
+    return state == KEY_DOWN_STATE || state == MANUAL_DOWN;
+  }
+
+  /**
+   * Element started by the last KEY_DOWN event ('.' or '-')
+   */
+  char element() const {
+    return currentElement;
+  }
+
+  /**
+   * Key-down length of the last element, in ticks
+   */
+  uint16_t elementTicks() const {
+    return elementLength;
+  }
+
+  /**
+   * Advance the keyer by one tick
+   * @return a mask of KEY_DOWN and KEY_UP events
+   */
+  uint8_t tick(bool dotPressed, bool dashPressed) {
+    if (mode == STRAIGHT_KEY) {
+      return manualTick(dotPressed || dashPressed);
+    }
+    if (mode == BUG) {
+      // The lever keys by hand whenever no automatic dit is in progress
+      if (state == MANUAL_DOWN || (state == IDLE && dashPressed)) {
+        return manualTick(dashPressed);
+      }
+      dashPressed = false;
+    }
+
+    uint8_t events = 0;
+
+    if (state != IDLE) {
+      latchPaddles(dotPressed, dashPressed);
+      if (--remaining == 0) {
+        if (state == KEY_DOWN_STATE) {
+          state = ELEMENT_SPACE;
+          remaining = ditTicks - weightTicks();
+          events |= KEY_UP;
+        } else {
+          state = IDLE;
+        }
+      }
+    }
+
+    if (state == IDLE) {
+      char next = nextElement(dotPressed, dashPressed);
+      if (next != '\0') {
+        currentElement = next;
+        elementLength = (next == '-' ? (uint32_t)ditTicks * dahRatio / 10 : ditTicks) + weightTicks();
+        state = KEY_DOWN_STATE;
+        remaining = elementLength;
+        events |= KEY_DOWN | ELEMENT;
+      }
+    }
+
+    dotWasPressed = dotPressed;
+    dashWasPressed = dashPressed;
+    return events;
+  }
+
+private:
+  enum State { IDLE, KEY_DOWN_STATE, ELEMENT_SPACE, MANUAL_DOWN };
+
+  State state;
+  KeyMode mode;
+  uint16_t ditTicks;
+  uint8_t weighting;
+  uint8_t dahRatio;
+  uint16_t remaining;         // Ticks left in the current element or space
+  char currentElement;        // Element being sent, or the last one sent while keying continues
+  uint16_t elementLength;     // Key-down ticks of currentElement
+  bool dotMemory;
+  bool dashMemory;
+  bool dotWasPressed;
+  bool dashWasPressed;
+  DitDahClassifier classifier;
+
+  /**
+   * Ticks weighting adds to each element and takes from the space after it
+   */
+  int16_t weightTicks() const {
+    return (int32_t)ditTicks * (weighting - 50) / 50;
+  }
+
+  /**
+   * Key directly from a contact, counting the key-down ticks in remaining
+   */
+  uint8_t manualTick(bool pressed) {
+    if (state != MANUAL_DOWN) {
+      if (!pressed) {
+        return 0;
+      }
+      state = MANUAL_DOWN;
+      remaining = 1;
+      return KEY_DOWN;
+    }
+
+    if (pressed) {
+      if (remaining < 0xFFFF) {
+        remaining++;
+      }
+      return 0;
+    }
+
+    state = IDLE;
+    elementLength = remaining;
+    currentElement = mode == BUG ? '-' : classifier.classify(remaining);
+    return KEY_UP | ELEMENT;
+  }
+
+  /**
+   * Remember paddle presses made while an element or its space is in progress:
+   * the opposite paddle at any time, or a fresh press of the same paddle
+   */
+  void latchPaddles(bool dotPressed, bool dashPressed) {
+    if (dotPressed && (currentElement == '-' || !dotWasPressed)) {
+      dotMemory = true;
+    }
+    if (dashPressed && (currentElement == '.' || !dashWasPressed)) {
+      dashMemory = true;
+    }
+  }
+
+  /**
+   * Pick the element to send after the element space, or '\0' to go idle
+   */
+  char nextElement(bool dotPressed, bool dashPressed) {
+    bool wantDot = dotPressed;
+    bool wantDash = dashPressed;
+    if (mode == PADDLE_IAMBIC_B) {
+      wantDot = wantDot || dotMemory;
+      wantDash = wantDash || dashMemory;
+    }
+    dotMemory = false;
+    dashMemory = false;
+
+    if (wantDot && wantDash) {
+      // Squeeze - alternate, starting with a dot from idle
+      return currentElement == '.' ? '-' : '.';
+    }
+    if (wantDot) {
+      return '.';
+    }
+    if (wantDash) {
+      return '-';
+    }
+    currentElement = '\0';
+    return '\0';
+  }
+};
+
+#endif // MORSE_KEYER_IAMBIC_KEYER_H
@@ -0,0 +1,87 @@
+/**
+ * IsrQueue.h
+ * Lock-free single-producer/single-consumer ring buffer for interrupt handlers
+ *
+ * Interrupt handlers push records and loop() drains them. Handlers never
+ * nest with each other on the supported boards, so all handlers feeding one
+ * queue together act as its single producer. The ESP32 keyer task
+ * (KeyerTick.h) is a producer in the same way: it runs above the loop task
+ * and is the only writer of the queue it feeds. The producer only writes head
+ * and the consumer only writes tail, so no interrupt masking is needed on
+ * either side.
+ */
+
+#ifndef MORSE_KEYER_ISR_QUEUE_H
+#define MORSE_KEYER_ISR_QUEUE_H
+
+#include <Arduino.h>
+
+// Interrupt handlers must live in IRAM on the ESP32 family
+#if defined(ARDUINO_ARCH_ESP32)
+#define KEYER_ISR_ATTR IRAM_ATTR
+#else
+#define KEYER_ISR_ATTR
+#endif
+
+// Stop the compiler from reordering buffer accesses past the index update.
+// All supported boards are single core, so a compiler barrier is enough.
+#define KEYER_MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+template <class T, uint8_t SIZE>
+class IsrQueue {
+public:
+  // Index arithmetic relies on masking
+  static_assert((SIZE & (SIZE - 1)) == 0, "IsrQueue size must be a power of two");
+
+  IsrQueue() : head(0), tail(0), dropped(0) {}
+
+  /**
+   * Append a record. Called from interrupt context only.
+   * @return false if the queue was full and the record was dropped
+   */
+  bool KEYER_ISR_ATTR push(const T &record) {
+    uint8_t next = (head + 1) & (SIZE - 1);
+    if (next == tail) {
+      dropped++;
+      return false;
+    }
+    buffer[head] = record;
+    KEYER_MEMORY_BARRIER();
+    head = next;
+    return true;
+  }
+
+  /**
+   * Remove the oldest record. Called from loop() only.
+   * @return false if the queue was empty
+   */
+  bool pop(T &record) {
+    if (tail == head) {
+      return false;
+    }
+    KEYER_MEMORY_BARRIER();
+    record = buffer[tail];
+    KEYER_MEMORY_BARRIER();
+    tail = (tail + 1) & (SIZE - 1);
+    return true;
+  }
+
+  bool isEmpty() const {
+    return tail == head;
+  }
+
+  /**
+   * Number of records dropped because the queue was full
+   */
+  uint16_t droppedCount() const {
+    return dropped;
+  }
+
+private:
+  T buffer[SIZE];
+  volatile uint8_t head;      // Written by the producer only
+  volatile uint8_t tail;      // Written by the consumer only
+  volatile uint16_t dropped;  // Written by the producer only
+};
+
+#endif // MORSE_KEYER_ISR_QUEUE_H
@@ -0,0 +1,380 @@
+/**
+ * KeyProtocol.h
+ * Binary key-event protocol between the keyer and the SuperMorse app
+ *
+ * Frame layout, before framing:
+ *
+ *   type (u8) | body (0..MAX_FRAME_BODY bytes) | CRC-16/CCITT-FALSE (u16, little-endian)
+ *
+ * The frame is COBS-encoded and terminated by a 0x00 delimiter. Multi-byte
+ * fields are little-endian and timestamps are device micros(), so the host
+ * reconstructs timing from the device clock rather than arrival times.
+ *
+ * The device starts in text mode so the sketches stay readable in a serial
+ * monitor. The host switches it to binary mode by sending a CMD_HELLO frame;
+ * the device answers with FRAME_HELLO (protocol version and capabilities)
+ * and from then on sends frames only. Host frames are sent as
+ * 0x00 <COBS data> 0x00, so a leading 0x00 tells them apart from the legacy
+ * single-character commands (A, B, D, T...).
+ *
+ * Keep the constants in sync with src/renderer/js/key-protocol.js.
+ */
+
+#ifndef MORSE_KEYER_KEY_PROTOCOL_H
+#define MORSE_KEYER_KEY_PROTOCOL_H
+
+#include <Arduino.h>
+#include <string.h>
+#include "TxBuffer.h"
+
+const uint8_t PROTOCOL_VERSION = 1;
+
+// Device -> host frame types
+const uint8_t FRAME_HELLO = 0x01;     // version u8, capabilities u16, key mode u8
+const uint8_t FRAME_TEXT = 0x02;      // UTF-8 status or debug text
+const uint8_t FRAME_KEY_EDGE = 0x10;  // contact u8, down u8, micros u32
+const uint8_t FRAME_ELEMENT = 0x11;   // element u8 ('.' or '-'), start micros u32, duration ms u16
+const uint8_t FRAME_GAP = 0x12;       // gap kind u8, micros u32
+const uint8_t FRAME_MODE = 0x13;      // key mode u8
+const uint8_t FRAME_TIMING = 0x14;    // dit ms u16, WPM u8
+const uint8_t FRAME_PARAM = 0x15;     // parameter u8, value u16 - the value now in force
+const uint8_t FRAME_TELEMETRY = 0x16; // see MorseKeyer::sendTelemetry()
+const uint8_t FRAME_CHARACTER = 0x17; // pattern u8 (node in MorseTables.h), end micros u32, UTF-8 text
+const uint8_t FRAME_RECORDING = 0x18; // see MorseKeyer::sendRecordingChunk()
+const uint8_t FRAME_SLEEP = 0x19;     // see MorseKeyer::sendTelemetry()
+
+// Host -> device command types
+const uint8_t CMD_HELLO = 0x01;       // host protocol version u8
+const uint8_t CMD_SET_PARAM = 0x02;   // parameter u8, value u16
+const uint8_t CMD_TELEMETRY = 0x03;   // no body - reply with FRAME_TELEMETRY and start a new window
+const uint8_t CMD_RECORDING = 0x04;   // no body - reply with the keying recording as FRAME_RECORDINGs
+const uint8_t CMD_GET_PARAM = 0x05;   // parameter u8 - reply with FRAME_PARAM
+
+// Parameters for CMD_SET_PARAM, CMD_GET_PARAM and FRAME_PARAM
+const uint8_t PARAM_WPM = 0x01;       // Keyer speed 5-60, 0 adapts to the operator
+const uint8_t PARAM_DEBOUNCE = 0x02;  // Contact debounce in ms, 1-50
+const uint8_t PARAM_DECODE = 0x03;    // 1 sends FRAME_CHARACTER for each keyed character, 0 stops
+const uint8_t PARAM_DECODE_REGION = 0x04; // Regional table for decoding, see MorseTables.h
+const uint8_t PARAM_SIDETONE = 0x05;  // 1 sounds the on-board sidetone with the key, 0 silences it
+const uint8_t PARAM_SIDETONE_HZ = 0x06; // On-board sidetone pitch in Hz, 250-2000
+const uint8_t PARAM_KEY_OUTPUT = 0x07;  // 1 keys the transmitter line and PTT with the key, 0 releases them
+const uint8_t PARAM_PTT_LEAD = 0x08;    // PTT lead before the key line closes, ms 0-50
+const uint8_t PARAM_PTT_TAIL = 0x09;    // PTT tail after the key line opens, ms 0-1000
+const uint8_t PARAM_PTT_HANG = 0x0A;    // Extra PTT hold after the tail, in dits 0-21
+const uint8_t PARAM_WEIGHTING = 0x0B;   // Key-down share of a dit plus its space, percent 25-75
+const uint8_t PARAM_DAH_RATIO = 0x0C;   // Dah length in dits, tenths 20-45
+const uint8_t PARAM_KEY_MODE = 0x0D;    // Key mode 0-3 as in FRAME_MODE
+const uint8_t PARAM_TONE_DECODE = 0x0E; // 1 decodes receiver audio into CONTACT_TONE edges, 0 stops
+const uint8_t PARAM_TONE_HZ = 0x0F;     // Receiver tone pitch in Hz, 300-1200
+
+// Contacts reported in FRAME_KEY_EDGE
+const uint8_t CONTACT_DOT = 0;
+const uint8_t CONTACT_DASH = 1;
+const uint8_t CONTACT_TONE = 2;   // A tone in the receiver audio (KeyerToneInput.h)
+
+// Gap kinds reported in FRAME_GAP
+const uint8_t GAP_WORD = 2;
+
+// Capability bits reported in FRAME_HELLO
+const uint16_t CAP_KEY_EDGES = 0x0001;
+const uint16_t CAP_ELEMENTS = 0x0002;
+const uint16_t CAP_TIMING = 0x0004;
+const uint16_t CAP_TELEMETRY = 0x0008;
+const uint16_t CAP_CHARACTERS = 0x0010;
+const uint16_t CAP_SIDETONE = 0x0020;
+const uint16_t CAP_RECORDER = 0x0040;
+const uint16_t CAP_KEY_OUTPUT = 0x0080;
+const uint16_t CAP_SAVED_PARAMS = 0x0100;  // CMD_GET_PARAM, and settings survive a power cycle
+const uint16_t CAP_SLEEP = 0x0200;         // Sleeps when idle and reports FRAME_SLEEP with telemetry
+const uint16_t CAP_TONE_DECODE = 0x0400;   // PARAM_TONE_DECODE and PARAM_TONE_HZ
+
+// Largest frame body either side will send
+const uint8_t MAX_FRAME_BODY = 48;
+// Most TX buffer space one frame takes: type, body, CRC, COBS code byte and delimiter
+const uint8_t MAX_ENCODED_FRAME = MAX_FRAME_BODY + 5;
+
+/**
+ * CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), bitwise to keep it out of RAM
+ */
+inline uint16_t crc16Update(uint16_t crc, uint8_t data) {
+  crc ^= (uint16_t)data << 8;
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+inline uint16_t crc16(const uint8_t *data, uint8_t length) {
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < length; i++) {
+    crc = crc16Update(crc, data[i]);
+  }
+  return crc;
+}
+
+/**
+ * Serial link to the host - writes frames or text, reads commands
+ *
+ * Output is queued in a TxBuffer and only reaches Serial when drain() finds
+ * room, so a host that stops reading can never stall the keyer. A frame or
+ * text line that does not fit is dropped whole.
+ */
+class HostLink {
+public:
+  HostLink() : binary(false), frameLength(0), inFrame(false), commandLength(0), badFrames(0) {}
+
+  bool isBinary() const {
+    return binary;
+  }
+
+  /**
+   * Switch to binary frames. A delimiter ends any partial text line
+   * so the host can find the first frame.
+   */
+  void enableBinary() {
+    binary = true;
+    if (tx.reserve(1)) {
+      tx.put(0);
+    }
+  }
+
+  /**
+   * Pass queued output to Serial without blocking. Call every poll().
+   */
+  void drain() {
+    tx.drain();
+  }
+
+  const TxBuffer &txBuffer() const {
+    return tx;
+  }
+
+  // Frame construction
+
+  void beginFrame(uint8_t type) {
+    frame[0] = type;
+    frameLength = 1;
+  }
+
+  void put8(uint8_t value) {
+    if (frameLength < sizeof(frame) - 2) {
+      frame[frameLength++] = value;
+    }
+  }
+
+  void put16(uint16_t value) {
+    put8(value & 0xFF);
+    put8(value >> 8);
+  }
+
+  void put32(uint32_t value) {
+    put16(value & 0xFFFF);
+    put16(value >> 16);
+  }
+
+  /**
+   * Append the CRC, COBS-encode the frame and queue it with its delimiter
+   */
+  void endFrame() {
+    uint16_t crc = crc16(frame, frameLength);
+    frame[frameLength++] = crc & 0xFF;
+    frame[frameLength++] = crc >> 8;
+    // Frames are far shorter than a 254-byte COBS block: one code byte per
+    // zero plus the leading code byte and the delimiter
+    if (tx.reserve(frameLength + 2)) {
+      writeCobs(frame, frameLength);
+      tx.put(0);
+    }
+  }
+
+  // Text output - a line in text mode, a FRAME_TEXT in binary mode
+
+  void beginText() {
+    beginFrame(FRAME_TEXT);
+  }
+
+  void text(const char *message) {
+    while (*message) {
+      put8((uint8_t)*message++);
+    }
+  }
+
+  /**
+   * Text kept in flash with F(), read a byte at a time so it never takes RAM
+   */
+  void text(const __FlashStringHelper *message) {
+    const char *p = reinterpret_cast<const char *>(message);
+    for (uint8_t c = pgm_read_byte(p); c != 0; c = pgm_read_byte(++p)) {
+      put8(c);
+    }
+  }
+
+  void text(uint32_t value) {
+    char digits[11];
+    uint8_t count = 0;
+    do {
+      digits[count++] = '0' + (value % 10);
+      value /= 10;
+    } while (value > 0);
+    while (count > 0) {
+      put8(digits[--count]);
+    }
+  }
+
+  void endText() {
+    if (binary) {
+      endFrame();
+      return;
+    }
+    if (tx.reserve(frameLength + 1)) {
+      for (uint8_t i = 1; i < frameLength; i++) {
+        tx.put(frame[i]);
+      }
+      tx.put('\r');
+      tx.put('\n');
+    }
+  }
+
+  /**
+   * Send a complete line of status text
+   */
+  void textLine(const __FlashStringHelper *message) {
+    beginText();
+    text(message);
+    endText();
+  }
+
+  /**
+   * Text-mode output that is not a whole line (elements, word spaces)
+   */
+  void rawText(const char *message) {
+    uint16_t length = strlen(message);
+    if (tx.reserve(length)) {
+      while (*message) {
+        tx.put((uint8_t)*message++);
+      }
+    }
+  }
+
+  // Command input
+
+  /**
+   * Read the next command byte or frame from the host.
+   * @return 0 if nothing complete is available, the legacy command character,
+   *         or CMD_FRAME when a valid frame is waiting in command()/commandSize()
+   */
+  static const int CMD_FRAME = -1;
+
+  int readCommand() {
+    while (Serial.available() > 0) {
+      uint8_t byte = Serial.read();
+
+      if (!inFrame) {
+        if (byte == 0) {
+          inFrame = true;
+          commandLength = 0;
+          continue;
+        }
+        return byte;
+      }
+
+      if (byte != 0) {
+        if (commandLength < sizeof(commandBuffer)) {
+          commandBuffer[commandLength++] = byte;
+        } else {
+          commandLength = sizeof(commandBuffer) + 1; // Oversized, drop at the delimiter
+        }
+        continue;
+      }
+
+      // Delimiter - an empty frame just resynchronises
+      if (commandLength == 0) {
+        continue;
+      }
+      inFrame = false;
+      if (decodeCommand()) {
+        return CMD_FRAME;
+      }
+      badFrames++;
+    }
+    return 0;
+  }
+
+  const uint8_t *command() const {
+    return commandBuffer;
+  }
+
+  uint8_t commandSize() const {
+    return commandLength;
+  }
+
+  uint16_t badFrameCount() const {
+    return badFrames;
+  }
+
+private:
+  bool binary;
+
+  uint8_t frame[MAX_FRAME_BODY + 3];
+  uint8_t frameLength;
+
+  bool inFrame;
+  uint8_t commandBuffer[MAX_FRAME_BODY + 4];
+  uint8_t commandLength;
+  uint16_t badFrames;
+
+  TxBuffer tx;
+
+  /**
+   * Queue a frame as COBS blocks (never emits 0x00). Frames are shorter
+   * than one 254-byte block, so every block but the last ends at a zero.
+   */
+  void writeCobs(const uint8_t *data, uint8_t length) {
+    uint8_t start = 0;
+    while (start <= length) {
+      uint8_t end = start;
+      while (end < length && data[end] != 0) {
+        end++;
+      }
+      tx.put((uint8_t)(end - start + 1));
+      for (uint8_t i = start; i < end; i++) {
+        tx.put(data[i]);
+      }
+      start = end + 1;
+    }
+  }
+
+  /**
+   * COBS-decode the command buffer in place and check its CRC
+   */
+  bool decodeCommand() {
+    if (commandLength > sizeof(commandBuffer)) {
+      return false;
+    }
+    uint8_t in = 0;
+    uint8_t out = 0;
+    while (in < commandLength) {
+      uint8_t code = commandBuffer[in++];
+      if (code == 0 || in + code - 1 > commandLength) {
+        return false;
+      }
+      for (uint8_t i = 1; i < code; i++) {
+        commandBuffer[out++] = commandBuffer[in++];
+      }
+      if (code < 0xFF && in < commandLength) {
+        commandBuffer[out++] = 0;
+      }
+    }
+    if (out < 3) {
+      return false;
+    }
+    uint16_t expected = commandBuffer[out - 2] | ((uint16_t)commandBuffer[out - 1] << 8);
+    if (crc16(commandBuffer, out - 2) != expected) {
+      return false;
+    }
+    commandLength = out - 2;
+    return true;
+  }
+};
+
+#endif // MORSE_KEYER_KEY_PROTOCOL_H
@@ -0,0 +1,182 @@
+/**
+ * KeyerOutput.h
+ * Transmitter keying line with PTT sequencing
+ *
+ * Drives an opto-isolator or transistor that keys a transmitter straight
+ * from the keyer tick, so the paddle-to-RF path never goes through the PC
+ * and element lengths are exact to the tick. An optional PTT line switches
+ * the transmitter (or an amplifier's relays) over before the first element
+ * and back after the last:
+ *
+ *   - lead: PTT goes active this long before the key line closes. The key
+ *     line runs the keyed elements through a delay line of this length, so
+ *     every element keeps its length and spacing, just later. The delay
+ *     line is a short ring of the key changes still to come out, each with
+ *     the tick it is due, so the tick only does 8-bit work on it.
+ *   - tail and hang: once the key line opens, PTT stays active for the tail
+ *     (fixed, in ms, for relays that must not switch hot) plus the hang
+ *     (in dits, so it scales with speed and can carry PTT through the gaps
+ *     between characters or words).
+ *
+ * Both lines are active HIGH. Either pin may be NO_PIN on a board that
+ * does not wire it. The output is off until the host enables it, so a
+ * practice session never keys a transmitter by surprise.
+ */
+
+#ifndef MORSE_KEYER_KEYER_OUTPUT_H
+#define MORSE_KEYER_KEYER_OUTPUT_H
+
+#include <Arduino.h>
+
+// Board pin that is not connected
+const uint8_t NO_PIN = 0xFF;
+
+// PTT limits the host may set
+const uint8_t PTT_MAX_LEAD_MS = 50;       // Must be under 128 ticks, for the delay line's 8-bit clock
+const uint16_t PTT_MAX_TAIL_MS = 1000;
+const uint8_t PTT_MAX_HANG_DITS = 21;     // Three word gaps
+
+template <uint8_t KEY_PIN, uint8_t PTT_PIN>
+class KeyingOutput {
+public:
+  // Key changes the delay line holds, a power of two. Seven fit, which
+  // covers a lead of 50 ticks with a change every 8 ticks, faster than any
+  // fist or the keyer at 60 WPM. A change that does not fit cancels the
+  // newest one held.
+  static const uint8_t DELAY_CHANGES = 8;
+
+  KeyingOutput()
+      : enabled(false), keyIn(false), keyOut(false), pttOn(false), leadTicks(0), releaseTicks(0), upTicks(0),
+        clock(0), head(0), tail(0) {}
+
+  /**
+   * Claim the pins, both inactive
+   */
+  void begin() {
+    if (KEY_PIN != NO_PIN) {
+      pinMode(KEY_PIN, OUTPUT);
+      digitalWrite(KEY_PIN, LOW);
+    }
+    if (PTT_PIN != NO_PIN) {
+      pinMode(PTT_PIN, OUTPUT);
+      digitalWrite(PTT_PIN, LOW);
+    }
+  }
+
+  // Setters - call with the keyer tick locked
+
+  /**
+   * Switch the output on or off. Switching off releases both lines at once.
+   */
+  void setEnabled(bool on) {
+    enabled = on;
+    if (!on) {
+      keyIn = false;
+      head = tail;
+      upTicks = 0;
+      writeKey(false);
+      writePtt(false);
+    }
+  }
+
+  void setLeadTicks(uint8_t ticks) {
+    leadTicks = ticks > 127 ? 127 : ticks;
+  }
+
+  /**
+   * Ticks PTT is held after the key line opens: the tail plus the hang
+   */
+  void setReleaseTicks(uint16_t ticks) {
+    releaseTicks = ticks;
+  }
+
+  /**
+   * Advance one tick with the keyer's current key state
+   */
+  void tick(bool keyed) {
+    if (!enabled) {
+      return;
+    }
+    clock++;
+    if (keyed != keyIn) {
+      keyIn = keyed;
+      queueChange(keyed);
+    }
+
+    if (keyed && !pttOn) {
+      writePtt(true);
+    }
+    if (!pttOn) {
+      return;
+    }
+    while (head != tail && (int8_t)(clock - changes[tail].due) >= 0) {
+      writeKey(changes[tail].down);
+      tail = (tail + 1) & (DELAY_CHANGES - 1);
+    }
+
+    // PTT is busy while the key line is closed or a change is still to come out
+    if (keyOut || head != tail) {
+      upTicks = 0;
+    } else if (++upTicks > releaseTicks) {
+      writePtt(false);
+    }
+  }
+
+  bool isEnabled() const {
+    return enabled;
+  }
+
+private:
+  struct KeyChange {
+    uint8_t due;          // clock value the key line follows it at
+    bool down;
+  };
+
+  bool enabled;
+  bool keyIn;             // Keyer's key state at the last tick
+  bool keyOut;            // Key line state as last written
+  bool pttOn;             // PTT line state as last written
+  uint8_t leadTicks;
+  uint16_t releaseTicks;
+  uint16_t upTicks;       // Ticks since the key line last opened
+  uint8_t clock;          // Ticks, wrapping; never more than 127 from a due time
+  uint8_t head;           // Next free change
+  uint8_t tail;           // Oldest change still to come out
+  KeyChange changes[DELAY_CHANGES];
+
+  /**
+   * Queue a key change to come out leadTicks from now
+   */
+  void queueChange(bool down) {
+    if (((head + 1) & (DELAY_CHANGES - 1)) == tail) {
+      // Changes alternate, so this one undoes the newest: drop both and the
+      // line still ends up right
+      head = (head - 1) & (DELAY_CHANGES - 1);
+      return;
+    }
+    changes[head].due = clock + leadTicks;
+    changes[head].down = down;
+    head = (head + 1) & (DELAY_CHANGES - 1);
+  }
+
+  void writeKey(bool on) {
+    if (on != keyOut) {
+      keyOut = on;
+      if (KEY_PIN != NO_PIN) {
+        digitalWrite(KEY_PIN, on ? HIGH : LOW);
+      }
+    }
+  }
+
+  void writePtt(bool on) {
+    if (on != pttOn) {
+      pttOn = on;
+      upTicks = 0;
+      if (PTT_PIN != NO_PIN) {
+        digitalWrite(PTT_PIN, on ? HIGH : LOW);
+      }
+    }
+  }
+};
+
+#endif // MORSE_KEYER_KEYER_OUTPUT_H
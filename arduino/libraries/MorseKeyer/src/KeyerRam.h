@@ -0,0 +1,76 @@
+/**
+ * KeyerRam.h
+ * Stack headroom measurement for the RAM-tight AVR boards
+ *
+ * The ATmega328P and ATmega32U4 have 2-2.5 KB of RAM shared by the keyer's
+ * static buffers, the heap and the stack, with nothing to stop the stack
+ * growing into the rest. At boot, StackPaint fills the free RAM between the
+ * heap and the stack with a canary byte. The canaries still intact above
+ * the heap later show how close the stack has come, which is the headroom
+ * left for bigger buffers or tables.
+ *
+ * The keyer's own static RAM is checked at compile time instead: see
+ * MorseKeyer::staticRamBytes() and the board's KEYER_RAM_BUDGET.
+ *
+ * Other boards have RAM to spare and report the headroom as unknown.
+ */
+
+#ifndef MORSE_KEYER_RAM_H
+#define MORSE_KEYER_RAM_H
+
+#include <Arduino.h>
+
+// Headroom reported where it is not measured
+const uint16_t STACK_HEADROOM_UNKNOWN = 0xFFFF;
+
+#if defined(__AVR__)
+
+extern uint8_t __heap_start;
+extern void *__brkval;
+
+struct StackPaint {
+  static const uint8_t CANARY = 0xA5;
+  static const uint8_t PAINT_MARGIN = 32;   // Left unpainted below the live stack
+
+  /**
+   * Paint the gap between the heap and the stack. Call early in setup().
+   */
+  static void paint() {
+    uint8_t marker;
+    uint8_t *end = &marker - PAINT_MARGIN;
+    for (uint8_t *p = heapEnd(); p < end; p++) {
+      *p = CANARY;
+    }
+  }
+
+  /**
+   * Painted bytes the stack has never reached
+   */
+  static uint16_t headroom() {
+    uint8_t marker;
+    uint8_t *p = heapEnd();
+    while (p < &marker && *p == CANARY) {
+      p++;
+    }
+    return p - heapEnd();
+  }
+
+private:
+  static uint8_t *heapEnd() {
+    return __brkval != 0 ? (uint8_t *)__brkval : &__heap_start;
+  }
+};
+
+#else
+
+struct StackPaint {
+  static void paint() {}
+
+  static uint16_t headroom() {
+    return STACK_HEADROOM_UNKNOWN;
+  }
+};
+
+#endif
+
+#endif // MORSE_KEYER_RAM_H
@@ -0,0 +1,145 @@
+/**
+ * KeyerScheduler.h
+ * Static-table cooperative scheduler for the keyer's loop() work
+ *
+ * Each piece of loop() work is a task in a table fixed at compile time. The
+ * table order is the priority order: every pass of runDue() walks it once
+ * and runs each armed task that is due. There are three kinds of task:
+ *
+ *   - every-pass tasks (period 0) run on each pass, and must run again
+ *     within their slack or the pass counts as a miss
+ *   - periodic tasks run every period from when they were armed. One that
+ *     falls a whole period behind skips the periods it missed rather than
+ *     running several times in a row
+ *   - one-shot tasks (armed with at()) run once, when their deadline passes
+ *
+ * A run later than its slack counts as a deadline miss, and the worst
+ * lateness is kept, so an overrunning loop shows up in telemetry instead of
+ * only as sluggish keying. Deadlines are micros() values compared with
+ * wrap-safe arithmetic.
+ */
+
+#ifndef MORSE_KEYER_SCHEDULER_H
+#define MORSE_KEYER_SCHEDULER_H
+
+#include <Arduino.h>
+
+/**
+ * One row of a scheduler table
+ */
+template <class Owner>
+struct ScheduledTask {
+  void (Owner::*run)();
+  uint32_t periodMicros;  // 0 for every-pass and one-shot tasks
+  uint32_t slackMicros;   // Lateness allowed before a run counts as a miss
+};
+
+template <class Owner, uint8_t COUNT>
+class CooperativeScheduler {
+public:
+  static_assert(COUNT <= 8, "CooperativeScheduler keeps its armed flags in one byte");
+
+  explicit CooperativeScheduler(const ScheduledTask<Owner> *table)
+    : tasks(table), armedTasks(0), everyPassTasks(0), misses(0), worstLateness(0) {}
+
+  /**
+   * Arm a task to run every pass (period 0) or every period from now
+   */
+  void start(uint8_t id, uint32_t nowMicros) {
+    if (tasks[id].periodMicros != 0) {
+      due[id] = nowMicros + tasks[id].periodMicros;
+      everyPassTasks &= ~(1 << id);
+    } else {
+      due[id] = nowMicros + tasks[id].slackMicros;
+      everyPassTasks |= 1 << id;
+    }
+    armedTasks |= 1 << id;
+  }
+
+  /**
+   * Arm a task to run once at a deadline, replacing any earlier one
+   */
+  void at(uint8_t id, uint32_t dueMicros) {
+    due[id] = dueMicros;
+    everyPassTasks &= ~(1 << id);
+    armedTasks |= 1 << id;
+  }
+
+  void cancel(uint8_t id) {
+    armedTasks &= ~(1 << id);
+  }
+
+  bool isArmed(uint8_t id) const {
+    return (armedTasks & (1 << id)) != 0;
+  }
+
+  /**
+   * Run every armed task that is due, in table order
+   */
+  void runDue(Owner &owner, uint32_t nowMicros) {
+    for (uint8_t id = 0; id < COUNT; id++) {
+      if (!isArmed(id)) {
+        continue;
+      }
+      const ScheduledTask<Owner> &task = tasks[id];
+      bool everyPass = isEveryPass(id);
+      int32_t lateness = (int32_t)(nowMicros - due[id]);
+      if (lateness < 0 && !everyPass) {
+        continue;
+      }
+
+      // An every-pass task's deadline is its slack, so any lateness is a miss
+      uint32_t allowed = everyPass ? 0 : task.slackMicros;
+      if (lateness > 0 && (uint32_t)lateness > allowed) {
+        misses++;
+      }
+      if (lateness > 0 && (uint32_t)lateness > worstLateness) {
+        worstLateness = lateness;
+      }
+
+      if (everyPass) {
+        due[id] = nowMicros + task.slackMicros;
+      } else if (task.periodMicros != 0) {
+        due[id] += task.periodMicros;
+        if ((int32_t)(nowMicros - due[id]) >= 0) {
+          due[id] = nowMicros + task.periodMicros;
+        }
+      } else {
+        armedTasks &= ~(1 << id);  // Before running, so the task may re-arm itself
+      }
+      (owner.*task.run)();
+    }
+  }
+
+  /**
+   * Runs that came later than their slack, since boot
+   */
+  uint16_t missCount() const {
+    return misses;
+  }
+
+  /**
+   * Latest any task has run past its deadline in this window
+   */
+  uint32_t worstLatenessMicros() const {
+    return worstLateness;
+  }
+
+  void resetWindow() {
+    worstLateness = 0;
+  }
+
+private:
+  const ScheduledTask<Owner> *tasks;
+  uint32_t due[COUNT];
+  uint8_t armedTasks;
+  uint8_t everyPassTasks;     // Armed with start() and a period of 0
+  uint16_t misses;
+  uint32_t worstLateness;
+
+  bool isEveryPass(uint8_t id) const {
+    return (everyPassTasks & (1 << id)) != 0;
+  }
+};
+
+#endif // MORSE_KEYER_SCHEDULER_H
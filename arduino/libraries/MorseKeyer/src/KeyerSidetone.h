@@ -0,0 +1,233 @@
+/**
+ * KeyerSidetone.h
+ * On-board sidetone sources for the supported boards
+ *
+ * The keyer tick switches the sidetone on and off in the same tick that
+ * keys the element, so the tone follows the key within a millisecond
+ * instead of waiting for the host to hear about it over USB. Board traits
+ * pick one of these as their Sidetone type. Each drives a piezo or small
+ * speaker on any output pin from a timer the keyer and Arduino core leave
+ * free on that board:
+ *
+ *   ATmega328P (Nano)  Timer2 in CTC mode, toggling the pin from its interrupt
+ *   ATmega32U4 (Micro) Timer3 in CTC mode, toggling the pin from its interrupt
+ *   SAMD21 (Xiao)      TC4 in match-frequency mode, toggling the pin from its interrupt
+ *   ESP32 family       An LEDC PWM channel at 50% duty
+ *
+ * On AVR these are the timers tone() uses, so a sketch with a sidetone pin
+ * must not call tone(). Every source provides:
+ *
+ *   static void begin(uint8_t pin);     // Claim the pin and timer, silent
+ *   static void setPitch(uint16_t hz);  // Call with the keyer tick locked
+ *   static void on();                   // Safe in the keyer tick
+ *   static void off();                  // Safe in the keyer tick
+ *
+ * The interrupt vectors are defined here. MorseKeyer.h includes this header,
+ * so include MorseKeyer.h from the sketch only, once.
+ */
+
+#ifndef MORSE_KEYER_KEYER_SIDETONE_H
+#define MORSE_KEYER_KEYER_SIDETONE_H
+
+#include <Arduino.h>
+
+const uint16_t SIDETONE_DEFAULT_HZ = 600;
+const uint16_t SIDETONE_MIN_HZ = 250;   // Lowest pitch Timer2 can reach at clk/128
+const uint16_t SIDETONE_MAX_HZ = 2000;
+
+#if defined(__AVR__)
+
+/**
+ * Square wave toggled from a timer interrupt through the pin's PORT register
+ */
+struct AvrSidetonePin {
+  static void begin(uint8_t pin) {
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    port() = portOutputRegister(digitalPinToPort(pin));
+    mask() = digitalPinToBitMask(pin);
+  }
+
+  static void toggle() {
+    *port() ^= mask();
+  }
+
+  static void low() {
+    *port() &= ~mask();
+  }
+
+  static volatile uint8_t *&port() {
+    static volatile uint8_t *outputPort = 0;
+    return outputPort;
+  }
+
+  static uint8_t &mask() {
+    static uint8_t bitMask = 0;
+    return bitMask;
+  }
+};
+
+#if defined(TIMER2_COMPA_vect)
+
+struct Timer2Sidetone {
+  static void begin(uint8_t pin) {
+    AvrSidetonePin::begin(pin);
+    TCCR2A = _BV(WGM21);    // CTC on OCR2A
+    TCCR2B = 0;             // Stopped until on()
+    setPitch(SIDETONE_DEFAULT_HZ);
+  }
+
+  static void setPitch(uint16_t hz) {
+    OCR2A = F_CPU / 128 / 2 / hz - 1;
+  }
+
+  static void on() {
+    TCNT2 = 0;
+    TCCR2B = _BV(CS22) | _BV(CS20);   // clk/128
+    TIMSK2 |= _BV(OCIE2A);
+  }
+
+  static void off() {
+    TCCR2B = 0;
+    TIMSK2 &= ~_BV(OCIE2A);
+    AvrSidetonePin::low();
+  }
+};
+
+ISR(TIMER2_COMPA_vect) {
+  AvrSidetonePin::toggle();
+}
+
+#endif
+
+#if defined(TIMER3_COMPA_vect)
+
+struct Timer3Sidetone {
+  static void begin(uint8_t pin) {
+    AvrSidetonePin::begin(pin);
+    TCCR3A = 0;
+    TCCR3B = _BV(WGM32);    // CTC on OCR3A, stopped until on()
+    setPitch(SIDETONE_DEFAULT_HZ);
+  }
+
+  static void setPitch(uint16_t hz) {
+    OCR3A = F_CPU / 8 / 2 / hz - 1;
+  }
+
+  static void on() {
+    TCNT3 = 0;
+    TCCR3B = _BV(WGM32) | _BV(CS31);  // clk/8
+    TIMSK3 |= _BV(OCIE3A);
+  }
+
+  static void off() {
+    TCCR3B = _BV(WGM32);
+    TIMSK3 &= ~_BV(OCIE3A);
+    AvrSidetonePin::low();
+  }
+};
+
+ISR(TIMER3_COMPA_vect) {
+  AvrSidetonePin::toggle();
+}
+
+#endif
+
+#elif defined(ARDUINO_ARCH_SAMD)
+
+struct Tc4Sidetone {
+  static void begin(uint8_t pin) {
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    group() = &PORT->Group[g_APinDescription[pin].ulPort];
+    mask() = 1UL << g_APinDescription[pin].ulPin;
+
+    // Clock TC4 from the 48 MHz main clock
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_TC4_TC5;
+    while (GCLK->STATUS.bit.SYNCBUSY);
+
+    TC4->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    sync();
+    TC4->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER_DIV16;
+    sync();
+    setPitch(SIDETONE_DEFAULT_HZ);
+
+    TC4->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+    NVIC_EnableIRQ(TC4_IRQn);
+  }
+
+  static void setPitch(uint16_t hz) {
+    TC4->COUNT16.CC[0].reg = F_CPU / 16 / 2 / hz - 1;
+    sync();
+  }
+
+  static void on() {
+    TC4->COUNT16.COUNT.reg = 0;
+    sync();
+    TC4->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+    sync();
+  }
+
+  static void off() {
+    TC4->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    sync();
+    group()->OUTCLR.reg = mask();
+  }
+
+  static void toggle() {
+    group()->OUTTGL.reg = mask();
+  }
+
+  static PortGroup *&group() {
+    static PortGroup *portGroup = 0;
+    return portGroup;
+  }
+
+  static uint32_t &mask() {
+    static uint32_t bitMask = 0;
+    return bitMask;
+  }
+
+private:
+  static void sync() {
+    while (TC4->COUNT16.STATUS.bit.SYNCBUSY);
+  }
+};
+
+void TC4_Handler() {
+  TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+  Tc4Sidetone::toggle();
+}
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+struct LedcSidetone {
+  static const uint8_t RESOLUTION_BITS = 8;
+
+  static void begin(uint8_t pin) {
+    outputPin() = pin;
+    ledcAttach(pin, SIDETONE_DEFAULT_HZ, RESOLUTION_BITS);
+    ledcWrite(pin, 0);
+  }
+
+  static void setPitch(uint16_t hz) {
+    ledcChangeFrequency(outputPin(), hz, RESOLUTION_BITS);
+  }
+
+  static void on() {
+    ledcWrite(outputPin(), 1 << (RESOLUTION_BITS - 1));
+  }
+
+  static void off() {
+    ledcWrite(outputPin(), 0);
+  }
+
+  static uint8_t &outputPin() {
+    static uint8_t pin = 0;
+    return pin;
+  }
+};
+
+#endif
+
+#endif // MORSE_KEYER_KEYER_SIDETONE_H
@@ -0,0 +1,117 @@
+/**
+ * KeyerSleep.h
+ * Low-power idle for the supported boards
+ *
+ * When poll() finds nothing to do it dozes: the CPU waits for the next
+ * interrupt instead of spinning, which the keyer tick or a paddle edge
+ * ends within a millisecond. After a long quiet spell, on a board that can,
+ * the keyer sleeps properly until a paddle contact closes:
+ *
+ *   ATmega328P/32U4 (Nano, Micro)  Idle mode between interrupts; never sleeps
+ *                                  deeper, as the UART to the host must run
+ *   SAMD21 (Xiao)                  WFI to doze; standby through the Arduino
+ *                                  Low Power library to sleep
+ *   ESP32 family                   A one-tick delay to doze; light sleep
+ *                                  with GPIO and timer wake to sleep
+ *
+ * Standby and light sleep stop the USB link, so those boards only sleep
+ * while no host has the port open (on the ESP32, while no USB host is
+ * present at all). Every source provides:
+ *
+ *   static const bool CAN_SLEEP;
+ *   static void doze();                 // Wait for the next interrupt
+ *   static bool sleepAllowed();         // Checked after the quiet spell
+ *   static void sleep(uint8_t dotPin, uint8_t dashPin, uint16_t maxMs);
+ *
+ * sleep() returns when either pin reads LOW or maxMs have passed. The keyer
+ * detaches its paddle interrupts first and attaches them again after, so a
+ * source may reconfigure the pins' interrupts for wake-up; the keyer then
+ * queues the edge that woke it itself. Wake-up is on the LOW level, so a
+ * contact that closes just before the CPU stops still wakes it at once.
+ */
+
+#ifndef MORSE_KEYER_KEYER_SLEEP_H
+#define MORSE_KEYER_KEYER_SLEEP_H
+
+#include <Arduino.h>
+
+#if defined(__AVR__)
+
+#include <avr/sleep.h>
+
+struct AvrIdleSleep {
+  static const bool CAN_SLEEP = false;
+
+  static void doze() {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+  }
+
+  static bool sleepAllowed() {
+    return false;
+  }
+
+  static void sleep(uint8_t, uint8_t, uint16_t) {}
+};
+
+#elif defined(ARDUINO_ARCH_SAMD)
+
+#include <ArduinoLowPower.h>
+
+struct SamdStandbySleep {
+  static const bool CAN_SLEEP = true;
+
+  static void doze() {
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;  // Standby leaves it set
+    __DSB();
+    __WFI();
+  }
+
+  static bool sleepAllowed() {
+    return !Serial;  // No host has the USB port open
+  }
+
+  static void sleep(uint8_t dotPin, uint8_t dashPin, uint16_t maxMs) {
+    LowPower.attachInterruptWakeup(dotPin, onWake, LOW);
+    LowPower.attachInterruptWakeup(dashPin, onWake, LOW);
+    if (digitalRead(dotPin) == HIGH && digitalRead(dashPin) == HIGH) {
+      LowPower.sleep((int)maxMs);
+    }
+    detachInterrupt(digitalPinToInterrupt(dotPin));
+    detachInterrupt(digitalPinToInterrupt(dashPin));
+  }
+
+  static void onWake() {}
+};
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+
+struct EspLightSleep {
+  static const bool CAN_SLEEP = true;
+
+  static void doze() {
+    delay(1);  // Blocks the loop task so the idle task can wait for interrupts
+  }
+
+  static bool sleepAllowed() {
+    return !Serial;  // No USB host
+  }
+
+  static void sleep(uint8_t dotPin, uint8_t dashPin, uint16_t maxMs) {
+    gpio_wakeup_enable((gpio_num_t)dotPin, GPIO_INTR_LOW_LEVEL);
+    gpio_wakeup_enable((gpio_num_t)dashPin, GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+    esp_sleep_enable_timer_wakeup(maxMs * 1000ULL);
+    esp_light_sleep_start();
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+    gpio_wakeup_disable((gpio_num_t)dotPin);
+    gpio_wakeup_disable((gpio_num_t)dashPin);
+  }
+};
+
+#endif
+
+#endif // MORSE_KEYER_KEYER_SLEEP_H
@@ -0,0 +1,94 @@
+/**
+ * KeyerStore.h
+ * Non-volatile storage for the keyer's settings on the supported boards
+ *
+ * The keyer keeps the settings the host last gave it in a small block of
+ * non-volatile memory and applies them at boot, so it comes up at the
+ * operator's speed and mode without waiting for the app. Board traits pick
+ * one of these as their ParamStore type:
+ *
+ *   ATmega328P/32U4 (Nano, Micro)  EEPROM at address 0
+ *   SAMD21 (Xiao)                  One flash row through the FlashStorage library
+ *   ESP32 family                   An NVS blob through Preferences
+ *
+ * The block layout and its check are MorseKeyer's (see saveParams()); a
+ * store only reads and writes the bytes. Erased memory reads as 0xFF,
+ * which fails the check, so a new board starts from the defaults. Every
+ * store provides:
+ *
+ *   static void read(ParamBlock &block);
+ *   static void write(const ParamBlock &block);  // Only called when the block changed
+ *
+ * Flash and EEPROM wear out, so the keyer writes a few seconds after the
+ * last change rather than on every one. The SAMD21 store defines the flash
+ * area here. MorseKeyer.h includes this header, so include MorseKeyer.h
+ * from the sketch only, once.
+ */
+
+#ifndef MORSE_KEYER_KEYER_STORE_H
+#define MORSE_KEYER_KEYER_STORE_H
+
+#include <Arduino.h>
+
+const uint8_t PARAM_BLOCK_SIZE = 32;
+
+struct ParamBlock {
+  uint8_t bytes[PARAM_BLOCK_SIZE];
+};
+
+#if defined(__AVR__)
+
+#include <EEPROM.h>
+
+struct EepromParamStore {
+  static void read(ParamBlock &block) {
+    EEPROM.get(0, block);
+  }
+
+  static void write(const ParamBlock &block) {
+    EEPROM.put(0, block);  // Rewrites only the bytes that differ
+  }
+};
+
+#elif defined(ARDUINO_ARCH_SAMD)
+
+#include <FlashStorage.h>
+
+FlashStorage(keyerParamFlash, ParamBlock);
+
+struct FlashParamStore {
+  static void read(ParamBlock &block) {
+    block = keyerParamFlash.read();
+  }
+
+  static void write(const ParamBlock &block) {
+    keyerParamFlash.write(block);
+  }
+};
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#include <Preferences.h>
+
+struct NvsParamStore {
+  static void read(ParamBlock &block) {
+    Preferences preferences;
+    memset(block.bytes, 0xFF, sizeof(block.bytes));
+    if (preferences.begin("keyer", true)) {
+      preferences.getBytes("params", block.bytes, sizeof(block.bytes));
+      preferences.end();
+    }
+  }
+
+  static void write(const ParamBlock &block) {
+    Preferences preferences;
+    if (preferences.begin("keyer", false)) {
+      preferences.putBytes("params", block.bytes, sizeof(block.bytes));
+      preferences.end();
+    }
+  }
+};
+
+#endif
+
+#endif // MORSE_KEYER_KEYER_STORE_H
@@ -0,0 +1,215 @@
+/**
+ * KeyerTelemetry.h
+ * Loop timing and latency statistics reported to the host on request
+ *
+ * Measures, per reporting window:
+ *
+ *   - poll() iterations per second and the longest gap between iterations
+ *   - latency from an edge or element being captured in an interrupt to
+ *     its frame being queued for the host, as a log2 histogram so the
+ *     percentiles cost a fixed 32 bytes of RAM
+ *
+ * and since boot the longest gap between watchdog feeds, how often the
+ * keyer slept and how often a paddle woke it, and the time from a paddle
+ * wake to the key-down of the first element (KeyerSleep.h).
+ */
+
+#ifndef MORSE_KEYER_TELEMETRY_H
+#define MORSE_KEYER_TELEMETRY_H
+
+#include <Arduino.h>
+
+// Latency histogram: bucket i counts latencies below LATENCY_BUCKET_BASE << i,
+// so 16 buckets cover 16us to 512ms and the last one takes everything longer
+const uint8_t LATENCY_BUCKETS = 16;
+const uint32_t LATENCY_BUCKET_BASE = 16;
+
+class KeyerTelemetry {
+public:
+  KeyerTelemetry()
+    : windowStart(0),
+      lastIteration(0),
+      iterations(0),
+      maxIteration(0),
+      maxLatency(0),
+      latencyCount(0),
+      worstFeedGap(0),
+      sleeps(0),
+      paddleWakes(0),
+      awaitingWakeElement(false),
+      wakeMicros(0),
+      lastWakeLatency(0),
+      worstWakeLatency(0) {
+    clearLatencies();
+  }
+
+  /**
+   * Start the first window. Call once the keyer is set up.
+   */
+  void begin(uint32_t nowMicros) {
+    windowStart = nowMicros;
+    lastIteration = nowMicros;
+  }
+
+  /**
+   * Note the start of a poll(), which is also when the watchdog is fed
+   */
+  void beginIteration(uint32_t nowMicros) {
+    uint32_t gap = nowMicros - lastIteration;
+    lastIteration = nowMicros;
+    iterations++;
+    if (gap > maxIteration) {
+      maxIteration = gap;
+    }
+    if (gap > worstFeedGap) {
+      worstFeedGap = gap;
+    }
+  }
+
+  /**
+   * Record the delay between capturing an event and queueing it for the host
+   */
+  void recordLatency(uint32_t micros) {
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && micros >= (LATENCY_BUCKET_BASE << bucket)) {
+      bucket++;
+    }
+    if (latencies[bucket] < 0xFFFF) {
+      latencies[bucket]++;
+    }
+    if (latencyCount < 0xFFFF) {
+      latencyCount++;
+    }
+    if (micros > maxLatency) {
+      maxLatency = micros;
+    }
+  }
+
+  /**
+   * Note the end of a sleep. Sleeping is not a slow loop iteration, so the
+   * iteration and watchdog feed gaps restart from here.
+   */
+  void recordWake(uint32_t nowMicros, bool byPaddle) {
+    lastIteration = nowMicros;
+    if (sleeps < 0xFFFF) {
+      sleeps++;
+    }
+    if (byPaddle) {
+      if (paddleWakes < 0xFFFF) {
+        paddleWakes++;
+      }
+      wakeMicros = nowMicros;
+      awaitingWakeElement = true;
+    }
+  }
+
+  /**
+   * Note a key-down. The first after a paddle wake ends the wake latency.
+   */
+  void recordKeyDown(uint32_t micros) {
+    if (!awaitingWakeElement) {
+      return;
+    }
+    awaitingWakeElement = false;
+    lastWakeLatency = micros - wakeMicros;
+    if (lastWakeLatency > worstWakeLatency) {
+      worstWakeLatency = lastWakeLatency;
+    }
+  }
+
+  uint32_t loopsPerSecond(uint32_t nowMicros) const {
+    uint32_t elapsed = nowMicros - windowStart;
+    if (elapsed == 0) {
+      return 0;
+    }
+    return (uint32_t)((uint64_t)iterations * 1000000UL / elapsed);
+  }
+
+  uint32_t maxIterationMicros() const {
+    return maxIteration;
+  }
+
+  /**
+   * Latency below which the given share of this window's events fell,
+   * rounded up to a histogram bucket boundary
+   * @param percent 1-100
+   */
+  uint32_t latencyPercentile(uint8_t percent) const {
+    if (latencyCount == 0) {
+      return 0;
+    }
+    uint32_t wanted = ((uint32_t)latencyCount * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+      seen += latencies[bucket];
+      if (seen >= wanted && bucket < LATENCY_BUCKETS - 1) {
+        uint32_t bound = LATENCY_BUCKET_BASE << bucket;
+        return bound < maxLatency ? bound : maxLatency;
+      }
+    }
+    return maxLatency;
+  }
+
+  uint32_t maxLatencyMicros() const {
+    return maxLatency;
+  }
+
+  /**
+   * Longest gap between watchdog feeds since boot
+   */
+  uint32_t worstFeedGapMicros() const {
+    return worstFeedGap;
+  }
+
+  uint16_t sleepCount() const {
+    return sleeps;
+  }
+
+  uint16_t paddleWakeCount() const {
+    return paddleWakes;
+  }
+
+  uint32_t lastWakeLatencyMicros() const {
+    return lastWakeLatency;
+  }
+
+  uint32_t worstWakeLatencyMicros() const {
+    return worstWakeLatency;
+  }
+
+  /**
+   * Start a new reporting window
+   */
+  void resetWindow(uint32_t nowMicros) {
+    windowStart = nowMicros;
+    iterations = 0;
+    maxIteration = 0;
+    maxLatency = 0;
+    latencyCount = 0;
+    clearLatencies();
+  }
+
+private:
+  uint32_t windowStart;
+  uint32_t lastIteration;
+  uint32_t iterations;
+  uint32_t maxIteration;
+  uint32_t maxLatency;
+  uint16_t latencyCount;
+  uint16_t latencies[LATENCY_BUCKETS];
+  uint32_t worstFeedGap;
+  uint16_t sleeps;
+  uint16_t paddleWakes;
+  bool awaitingWakeElement;
+  uint32_t wakeMicros;        // When the last paddle wake happened
+  uint32_t lastWakeLatency;
+  uint32_t worstWakeLatency;
+
+  void clearLatencies() {
+    for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+      latencies[bucket] = 0;
+    }
+  }
+};
+
+#endif // MORSE_KEYER_TELEMETRY_H
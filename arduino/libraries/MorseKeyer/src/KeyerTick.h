@@ -0,0 +1,193 @@
+/**
+ * KeyerTick.h
+ * 1 kHz keyer tick sources for the supported boards
+ *
+ * Board traits pick one of these in beginTickTimer(). Each uses a hardware
+ * timer the Arduino core leaves free on that board:
+ *
+ *   AVR (Nano, Micro)  Timer1 in CTC mode (millis() uses Timer0, tone() Timer2)
+ *   SAMD21 (Xiao)      TC3 in match-frequency mode (tone() uses TC5)
+ *   ESP32 family       A general-purpose timer through the Arduino timer API,
+ *                      waking a high-priority keyer task that calls the
+ *                      handler
+ *
+ * Each also provides lock() and unlock(), which keep the handler from
+ * running in between so loop() can change what it reads. On AVR and SAMD21
+ * that masks interrupts. On the ESP32 it suspends the keyer task instead:
+ * masking interrupts is no guard against another task, and the handler
+ * makes driver calls that cannot run inside a critical section.
+ *
+ * The interrupt vectors are defined here. MorseKeyer.h includes this header,
+ * so include MorseKeyer.h from the sketch only, once.
+ */
+
+#ifndef MORSE_KEYER_KEYER_TICK_H
+#define MORSE_KEYER_KEYER_TICK_H
+
+#include <Arduino.h>
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_task_wdt.h>
+#endif
+
+const uint16_t KEYER_TICK_HZ = 1000;
+
+typedef void (*KeyerTickHandler)();
+
+#if defined(__AVR__)
+
+struct Timer1Tick {
+  static void begin(KeyerTickHandler tickHandler) {
+    handler() = tickHandler;
+    noInterrupts();
+    TCCR1A = 0;
+    TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10);   // CTC on OCR1A, clk/64
+    TCNT1 = 0;
+    OCR1A = F_CPU / 64 / KEYER_TICK_HZ - 1;
+    TIMSK1 |= _BV(OCIE1A);
+    interrupts();
+  }
+
+  static void lock() {
+    noInterrupts();
+  }
+
+  static void unlock() {
+    interrupts();
+  }
+
+  static KeyerTickHandler &handler() {
+    static KeyerTickHandler tickHandler = 0;
+    return tickHandler;
+  }
+};
+
+ISR(TIMER1_COMPA_vect) {
+  Timer1Tick::handler()();
+}
+
+#elif defined(ARDUINO_ARCH_SAMD)
+
+struct Tc3Tick {
+  static void begin(KeyerTickHandler tickHandler) {
+    handler() = tickHandler;
+
+    // Clock TC3 from the 48 MHz main clock
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_TCC2_TC3;
+    while (GCLK->STATUS.bit.SYNCBUSY);
+
+    TC3->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    sync();
+    TC3->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER_DIV64;
+    sync();
+    TC3->COUNT16.CC[0].reg = F_CPU / 64 / KEYER_TICK_HZ - 1;
+    sync();
+
+    TC3->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+    NVIC_EnableIRQ(TC3_IRQn);
+
+    TC3->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+    sync();
+  }
+
+  static void lock() {
+    noInterrupts();
+  }
+
+  static void unlock() {
+    interrupts();
+  }
+
+  static KeyerTickHandler &handler() {
+    static KeyerTickHandler tickHandler = 0;
+    return tickHandler;
+  }
+
+private:
+  static void sync() {
+    while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+  }
+};
+
+void TC3_Handler() {
+  TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+  Tc3Tick::handler()();
+}
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+/**
+ * Keyer tick in its own FreeRTOS task. The timer interrupt only wakes the
+ * task, which runs the handler ahead of every other application task, so the
+ * Arduino loop task is left as a low-priority comms task: serial commands
+ * and a host that stops reading can hold it up without moving an element.
+ * The task feeds the task watchdog once it has been added with
+ * esp_task_wdt_add(EspTaskTick::task()).
+ *
+ * The task is pinned to the core that calls begin(), the loop task's. As it
+ * outranks the loop task there, it is always between ticks while loop()
+ * runs, so lock() can suspend it without stopping a tick part way. Ticks
+ * that fall due while it is suspended run as soon as unlock() resumes it.
+ */
+struct EspTaskTick {
+  static const UBaseType_t PRIORITY = configMAX_PRIORITIES - 3;  // Below the esp_timer task
+  static const uint32_t STACK_SIZE = 3072;
+
+  static void begin(KeyerTickHandler tickHandler) {
+    handler() = tickHandler;
+    xTaskCreatePinnedToCore(run, "keyer", STACK_SIZE, 0, PRIORITY, &task(), xPortGetCoreID());
+
+    hw_timer_t *timer = timerBegin(1000000);           // 1 MHz timer clock
+    timerAttachInterrupt(timer, wake);
+    timerAlarm(timer, 1000000 / KEYER_TICK_HZ, true, 0);  // Auto-reload, run forever
+  }
+
+  // Settings applied in begin() come before the task exists
+  static void lock() {
+    if (task()) {
+      vTaskSuspend(task());
+    }
+  }
+
+  static void unlock() {
+    if (task()) {
+      vTaskResume(task());
+    }
+  }
+
+  static TaskHandle_t &task() {
+    static TaskHandle_t keyerTask = 0;
+    return keyerTask;
+  }
+
+private:
+  static KeyerTickHandler &handler() {
+    static KeyerTickHandler tickHandler = 0;
+    return tickHandler;
+  }
+
+  static void IRAM_ATTR wake() {
+    BaseType_t higherPriorityWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(task(), &higherPriorityWoken);
+    portYIELD_FROM_ISR(higherPriorityWoken);
+  }
+
+  static void run(void *) {
+    uint16_t ticksSinceFeed = 0;
+    for (;;) {
+      // Resuming from lock() can return with no tick due, or several
+      for (uint32_t due = ulTaskNotifyTake(pdTRUE, portMAX_DELAY); due > 0; due--) {
+        handler()();
+      }
+
+      // Feeding takes a lock, so ten times a second is plenty
+      if (++ticksSinceFeed >= KEYER_TICK_HZ / 10) {
+        ticksSinceFeed = 0;
+        esp_task_wdt_reset();
+      }
+    }
+  }
+};
+
+#endif
+
+#endif // MORSE_KEYER_KEYER_TICK_H
@@ -0,0 +1,151 @@
+/**
+ * KeyerTiming.h
+ * Morse timing model for the keyer
+ *
+ * The speed is either set by the host (5-60 WPM) or, when the host sets
+ * WPM 0, adapted to the operator: an exponentially weighted running
+ * estimate of the dit length from the key-down durations the keyer
+ * captures. Every other threshold is derived from the dit using standard
+ * PARIS proportions:
+ *
+ *   dit = 1 unit, dah = 3 units, element gap = 1 unit,
+ *   character gap = 3 units, word gap = 7 units, dit ms = 1200 / WPM
+ *
+ * The same model is reported to the host so the app decodes with the
+ * thresholds the keyer uses.
+ */
+
+#ifndef MORSE_KEYER_TIMING_H
+#define MORSE_KEYER_TIMING_H
+
+#include <Arduino.h>
+
+// Speed range the estimate is allowed to track
+const uint8_t MIN_WPM = 5;
+const uint8_t MAX_WPM = 60;
+
+// Dit length at the starting speed, matches the old fixed 150ms dit
+const uint32_t DEFAULT_DIT_MICROS = 150000UL;
+
+// Key-down shorter than this is contact noise, not keying (half a dit at 60 WPM)
+const uint32_t MIN_KEY_DOWN_MICROS = 10000UL;
+
+// Weight of a new sample in the running estimate, as a shift (1/4)
+const uint8_t TIMING_SMOOTHING_SHIFT = 2;
+
+class KeyerTiming {
+public:
+  KeyerTiming() : ditMicros(DEFAULT_DIT_MICROS), fixedWpm(0), reportedWpm(0) {}
+
+  uint32_t ditMs() const {
+    return ditMicros / 1000;
+  }
+
+  uint32_t dahMs() const {
+    return 3 * ditMicros / 1000;
+  }
+
+  /**
+   * Key-up time that ends a character - halfway between
+   * the 1 unit element gap and the 3 unit character gap
+   */
+  uint32_t characterGapMs() const {
+    return 2 * ditMicros / 1000;
+  }
+
+  /**
+   * Key-up time that ends a word - halfway between
+   * the 3 unit character gap and the 7 unit word gap
+   */
+  uint32_t wordGapMs() const {
+    return 5 * ditMicros / 1000;
+  }
+
+  uint8_t wpm() const {
+    return (1200000UL + ditMicros / 2) / ditMicros;
+  }
+
+  /**
+   * Fix the speed, or pass 0 to adapt to the operator from the current speed
+   * @return the WPM now in force (0 for adaptive)
+   */
+  uint8_t setWpm(uint8_t newWpm) {
+    if (newWpm == 0) {
+      fixedWpm = 0;
+      return 0;
+    }
+    fixedWpm = newWpm < MIN_WPM ? MIN_WPM : (newWpm > MAX_WPM ? MAX_WPM : newWpm);
+    ditMicros = 1200000UL / fixedWpm;
+    return fixedWpm;
+  }
+
+  /**
+   * WPM set by the host, or 0 while adapting
+   */
+  uint8_t configuredWpm() const {
+    return fixedWpm;
+  }
+
+  /**
+   * Feed one captured key-down duration into the estimate.
+   * A key-down shorter than two dits is taken as a dit and one up to five
+   * dits as a dah (a third of it is a dit). Anything longer is a held
+   * paddle and says nothing about speed. Ignored while the speed is fixed.
+   * @return true if the estimate moved to a new whole WPM
+   */
+  bool calibrateTiming(uint32_t keyDownMicros) {
+    if (fixedWpm != 0 || keyDownMicros < MIN_KEY_DOWN_MICROS) {
+      return false;
+    }
+
+    uint32_t sample;
+    if (keyDownMicros < 2 * ditMicros) {
+      sample = keyDownMicros;
+    } else if (keyDownMicros < 5 * ditMicros) {
+      sample = keyDownMicros / 3;
+    } else {
+      return false;
+    }
+
+    // ditMicros += (sample - ditMicros) / 4, kept unsigned
+    ditMicros = ditMicros - (ditMicros >> TIMING_SMOOTHING_SHIFT) + (sample >> TIMING_SMOOTHING_SHIFT);
+    clamp();
+
+    return wpm() != reportedWpm;
+  }
+
+  /**
+   * Follow a dit length measured elsewhere, such as the straight-key
+   * classifier. This overrides a fixed speed until setWpm() is called again.
+   * @return true if the estimate moved to a new whole WPM
+   */
+  bool followDit(uint32_t newDitMicros) {
+    ditMicros = newDitMicros;
+    clamp();
+    return wpm() != reportedWpm;
+  }
+
+  /**
+   * Remember which speed the host has last been told about
+   */
+  void markReported() {
+    reportedWpm = wpm();
+  }
+
+private:
+  uint32_t ditMicros;
+  uint8_t fixedWpm;       // Host-set speed, 0 while adapting
+  uint8_t reportedWpm;
+
+  void clamp() {
+    const uint32_t fastest = 1200000UL / MAX_WPM;
+    const uint32_t slowest = 1200000UL / MIN_WPM;
+    if (ditMicros < fastest) {
+      ditMicros = fastest;
+    } else if (ditMicros > slowest) {
+      ditMicros = slowest;
+    }
+  }
+};
+
+#endif // MORSE_KEYER_TIMING_H
@@ -0,0 +1,281 @@
+/**
+ * KeyerToneInput.h
+ * Receiver audio input for decoding CW tones on the device
+ *
+ * With tone decoding switched on, the keyer samples a receiver's audio on an
+ * ADC pin at TONE_SAMPLE_HZ and runs it through a ToneDetector. Each key
+ * change the detector finds is reported like a paddle edge, as a
+ * FRAME_KEY_EDGE from CONTACT_TONE, so the host gets clean timing events
+ * rather than raw audio. Board traits pick one of these as their ToneInput
+ * type:
+ *
+ *   ESP32 family       The ADC's continuous (DMA) mode on one pin, timed by
+ *                      the ADC's own clock
+ *   Other boards       NoToneInput: no tone decoding
+ *
+ * Samples are read from loop() in batches, so a pass that runs late only
+ * delays the report: every edge is stamped from its sample's place in the
+ * stream, not from when loop() got to it. An input provides:
+ *
+ *   static const bool AVAILABLE;
+ *   static bool begin(uint32_t sampleHz);  // Start sampling; false if the ADC cannot
+ *   static void end();
+ *   static uint8_t read(int16_t *samples, uint8_t max, uint32_t &lastMicros);
+ *
+ * read() copies out up to max samples taken since the last read, oldest
+ * first, without waiting. lastMicros gets the time the last one was taken.
+ * The audio should sit on a bias at half the ADC range, through a coupling
+ * capacitor, so both halves of the wave are sampled.
+ */
+
+#ifndef MORSE_KEYER_KEYER_TONE_INPUT_H
+#define MORSE_KEYER_KEYER_TONE_INPUT_H
+
+#include <Arduino.h>
+#include "ToneDetector.h"
+
+const uint16_t TONE_SAMPLE_HZ = 8000;
+const uint8_t TONE_READ_SAMPLES = 32;    // Samples per read, under a block so a read holds at most one change
+const uint32_t TONE_SAMPLE_MICROS = 1000000UL / TONE_SAMPLE_HZ;
+
+static_assert(TONE_READ_SAMPLES <= TONE_SAMPLE_HZ / TONE_BLOCK_HZ, "A tone read must not span two detector blocks");
+static_assert(1000000UL % TONE_SAMPLE_HZ == 0, "Tone samples must be a whole number of microseconds apart");
+
+struct NoToneInput {
+  static const bool AVAILABLE = false;
+};
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <esp_adc/adc_continuous.h>
+
+template <uint8_t PIN>
+struct EspAdcToneInput {
+  static const bool AVAILABLE = true;
+
+  static bool begin(uint32_t sampleHz) {
+    adc_unit_t unit;
+    adc_channel_t channel;
+    if (adc_continuous_io_to_channel(PIN, &unit, &channel) != ESP_OK) {
+      return false;
+    }
+
+    adc_continuous_handle_cfg_t handleConfig = {};
+    handleConfig.max_store_buf_size = POOL_BYTES;
+    handleConfig.conv_frame_size = FRAME_BYTES;
+    if (adc_continuous_new_handle(&handleConfig, &handle()) != ESP_OK) {
+      return false;
+    }
+
+    adc_digi_pattern_config_t pattern = {};
+    pattern.atten = ADC_ATTEN_DB_12;
+    pattern.channel = channel;
+    pattern.unit = unit;
+    pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    adc_continuous_config_t config = {};
+    config.pattern_num = 1;
+    config.adc_pattern = &pattern;
+    config.sample_freq_hz = sampleHz;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+
+    adc_continuous_evt_cbs_t callbacks = {};
+    callbacks.on_conv_done = onFrame;
+
+    samplePeriodMicros() = 1000000UL / sampleHz;
+    convertedSamples() = 0;
+    readSamples() = 0;
+    if (adc_continuous_config(handle(), &config) != ESP_OK ||
+        adc_continuous_register_event_callbacks(handle(), &callbacks, 0) != ESP_OK ||
+        adc_continuous_start(handle()) != ESP_OK) {
+      adc_continuous_deinit(handle());
+      return false;
+    }
+    return true;
+  }
+
+  static void end() {
+    adc_continuous_stop(handle());
+    adc_continuous_deinit(handle());
+  }
+
+  static uint8_t read(int16_t *samples, uint8_t max, uint32_t &lastMicros) {
+    uint8_t raw[TONE_READ_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES];
+    uint32_t length = 0;
+    if (max > TONE_READ_SAMPLES) {
+      max = TONE_READ_SAMPLES;
+    }
+    // Returns a timeout for a short read, but still hands over what it has
+    adc_continuous_read(handle(), raw, max * SOC_ADC_DIGI_RESULT_BYTES, &length, 0);
+    uint8_t count = 0;
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+      const adc_digi_output_data_t *result = (const adc_digi_output_data_t *)&raw[i];
+      samples[count++] = result->type2.data;
+    }
+    if (count == 0) {
+      return 0;
+    }
+
+    portENTER_CRITICAL(&lock());
+    uint32_t converted = convertedSamples();
+    uint32_t frameMicros = convertedMicros();
+    portEXIT_CRITICAL(&lock());
+
+    // A short read emptied the pool, so its last sample ends the last frame.
+    // That also gets back in step after the pool overflowed.
+    readSamples() += count;
+    if (count < max || readSamples() > converted) {
+      readSamples() = converted;
+    }
+    lastMicros = frameMicros - (converted - readSamples()) * samplePeriodMicros();
+    return count;
+  }
+
+private:
+  static const uint32_t FRAME_BYTES = TONE_READ_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES;
+  static const uint32_t POOL_BYTES = 32 * FRAME_BYTES;  // 128ms at 8kHz
+
+  static adc_continuous_handle_t &handle() {
+    static adc_continuous_handle_t adcHandle = 0;
+    return adcHandle;
+  }
+
+  static portMUX_TYPE &lock() {
+    static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    return mux;
+  }
+
+  static volatile uint32_t &convertedSamples() {
+    static volatile uint32_t samples = 0;
+    return samples;
+  }
+
+  static volatile uint32_t &convertedMicros() {
+    static volatile uint32_t frameEnd = 0;
+    return frameEnd;
+  }
+
+  static uint32_t &readSamples() {
+    static uint32_t samples = 0;
+    return samples;
+  }
+
+  static uint32_t &samplePeriodMicros() {
+    static uint32_t period = 0;
+    return period;
+  }
+
+  /**
+   * A DMA frame is complete: its last sample was taken just now
+   */
+  static bool IRAM_ATTR onFrame(adc_continuous_handle_t, const adc_continuous_evt_data_t *frame, void *) {
+    portENTER_CRITICAL_ISR(&lock());
+    convertedSamples() += frame->size / SOC_ADC_DIGI_RESULT_BYTES;
+    convertedMicros() = micros();
+    portEXIT_CRITICAL_ISR(&lock());
+    return false;
+  }
+};
+
+#endif
+
+/**
+ * A key change found in the audio
+ */
+struct ToneEdge {
+  bool changed;     // The key changed in the samples just read
+  bool down;
+  uint32_t micros;  // When the tone started or stopped
+};
+
+/**
+ * Tone decoding for a board's ToneInput: the detector, and whether it runs.
+ * Boards without a tone input get the empty version below.
+ */
+template <class Input, bool = Input::AVAILABLE>
+class ToneReceiver {
+public:
+  ToneReceiver() : enabled(false) {}
+
+  /**
+   * Start or stop sampling. Starting again forgets the levels heard before.
+   * @return whether the receiver now runs
+   */
+  bool setEnabled(bool on) {
+    if (on == enabled) {
+      return enabled;
+    }
+    if (on) {
+      detector.begin(TONE_SAMPLE_HZ, detector.pitchHz());
+      enabled = Input::begin(TONE_SAMPLE_HZ);
+    } else {
+      Input::end();
+      enabled = false;
+    }
+    return enabled;
+  }
+
+  bool isEnabled() const {
+    return enabled;
+  }
+
+  uint16_t setPitch(uint16_t hz) {
+    return detector.setPitch(hz);
+  }
+
+  uint16_t pitchHz() const {
+    return detector.pitchHz();
+  }
+
+  /**
+   * Run the next batch of samples through the detector
+   * @return the samples read, 0 once caught up
+   */
+  uint8_t read(ToneEdge &edge) {
+    int16_t samples[TONE_READ_SAMPLES];
+    uint32_t lastMicros;
+    uint8_t count = enabled ? Input::read(samples, TONE_READ_SAMPLES, lastMicros) : 0;
+    edge.changed = false;
+    edge.down = false;
+    edge.micros = 0;
+    for (uint8_t i = 0; i < count; i++) {
+      if (detector.addSample(samples[i])) {
+        edge.changed = true;
+        edge.down = detector.isKeyDown();
+        edge.micros = lastMicros - (uint32_t)(count - 1 - i + detector.lagSamples()) * TONE_SAMPLE_MICROS;
+      }
+    }
+    return count;
+  }
+
+private:
+  ToneDetector detector;
+  bool enabled;
+};
+
+template <class Input>
+class ToneReceiver<Input, false> {
+public:
+  bool setEnabled(bool) {
+    return false;
+  }
+
+  bool isEnabled() const {
+    return false;
+  }
+
+  uint16_t setPitch(uint16_t) {
+    return 0;
+  }
+
+  uint16_t pitchHz() const {
+    return 0;
+  }
+
+  uint8_t read(ToneEdge &edge) {
+    edge.changed = false;
+    return 0;
+  }
+};
+
+#endif // MORSE_KEYER_KEYER_TONE_INPUT_H
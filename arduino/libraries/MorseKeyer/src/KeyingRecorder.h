@@ -0,0 +1,99 @@
+/**
+ * KeyingRecorder.h
+ * RAM ring buffer of the last raw paddle edges, for "it dropped my dah" reports
+ *
+ * Every edge drained from the edge queue is also kept here, oldest
+ * overwritten first, so the last few seconds of keying can be dumped to the
+ * host after the fact and replayed through the host keyer simulation. Each
+ * record is one u32:
+ *
+ *   bit 31      contact (CONTACT_DOT or CONTACT_DASH)
+ *   bit 30      1 if the contact closed, 0 if it opened
+ *   bits 0-29   micros() at the edge, low 30 bits
+ *
+ * The host rebuilds full timestamps backwards from the micros() sent with
+ * the dump. That only works while every record is less than 2^30 us (about
+ * 18 minutes) older than the newest, so records more than MAX_AGE_MICROS
+ * older than a new edge are dropped as it arrives.
+ *
+ * A dump reads the records while the recorder is frozen, so edges keyed
+ * during a slow dump do not overwrite what is being sent.
+ */
+
+#ifndef MORSE_KEYER_KEYING_RECORDER_H
+#define MORSE_KEYER_KEYING_RECORDER_H
+
+#include <Arduino.h>
+
+template <uint16_t SIZE>
+class KeyingRecorder {
+public:
+  static const uint32_t TIME_MASK = 0x3FFFFFFFUL;
+  static const uint32_t DOWN_BIT = 0x40000000UL;
+  static const uint32_t DASH_BIT = 0x80000000UL;
+  static const uint32_t MAX_AGE_MICROS = 0x20000000UL;  // About 9 minutes
+
+  KeyingRecorder() : first(0), count(0), lastMicros(0), frozen(false) {}
+
+  /**
+   * Keep one edge, dropping any too old to be timed from the newest
+   */
+  void record(bool dash, bool down, uint32_t micros) {
+    if (frozen) {
+      return;
+    }
+    if (count > 0 && micros - lastMicros >= MAX_AGE_MICROS) {
+      count = 0;
+    }
+    while (count > 0 && ((micros - records[first]) & TIME_MASK) >= MAX_AGE_MICROS) {
+      drop();
+    }
+    if (count == SIZE) {
+      drop();
+    }
+
+    uint16_t slot = first + count;
+    if (slot >= SIZE) {
+      slot -= SIZE;
+    }
+    records[slot] = (micros & TIME_MASK) | (down ? DOWN_BIT : 0) | (dash ? DASH_BIT : 0);
+    count++;
+    lastMicros = micros;
+  }
+
+  /**
+   * Stop or resume recording while a dump reads the records
+   */
+  void freeze(bool on) {
+    frozen = on;
+  }
+
+  uint16_t size() const {
+    return count;
+  }
+
+  /**
+   * Record by age, 0 being the oldest
+   */
+  uint32_t at(uint16_t index) const {
+    uint16_t slot = first + index;
+    if (slot >= SIZE) {
+      slot -= SIZE;
+    }
+    return records[slot];
+  }
+
+private:
+  uint32_t records[SIZE];
+  uint16_t first;       // Slot of the oldest record
+  uint16_t count;
+  uint32_t lastMicros;  // Full timestamp of the newest record
+  bool frozen;
+
+  void drop() {
+    first = first + 1 == SIZE ? 0 : first + 1;
+    count--;
+  }
+};
+
+#endif // MORSE_KEYER_KEYING_RECORDER_H
@@ -0,0 +1,112 @@
+/**
+ * MorseDecoder.h
+ * On-device character decoding for the keyer
+ *
+ * The keyer feeds every element it sends into addElement(), which walks the
+ * Morse tree in MorseTables.h one node per element. When the key has been
+ * up for a character gap the keyer calls finish() to look the character up
+ * and start the next one. The character boundary therefore comes from the
+ * keyer's own timing model instead of a pause timer on the host.
+ */
+
+#ifndef MORSE_KEYER_MORSE_DECODER_H
+#define MORSE_KEYER_MORSE_DECODER_H
+
+#include <Arduino.h>
+#include "MorseTables.h"
+
+// Node reported for a pattern longer than the tree holds
+const uint8_t MORSE_NODE_OVERFLOW = 0;
+
+class MorseDecoder {
+public:
+  MorseDecoder() : node(1), region(REGION_INTERNATIONAL) {}
+
+  /**
+   * Select the regional table checked before the international one
+   * @return the region now in force (international for an unknown region)
+   */
+  uint8_t setRegion(uint8_t newRegion) {
+    region = newRegion < MORSE_REGION_COUNT ? newRegion : (uint8_t)REGION_INTERNATIONAL;
+    return region;
+  }
+
+  uint8_t regionInUse() const {
+    return region;
+  }
+
+  void addElement(char element) {
+    if (node == MORSE_NODE_OVERFLOW) {
+      return;
+    }
+    // A node past the deepest level has no room for another element
+    node = node >= MORSE_TREE_SIZE / 2 ? MORSE_NODE_OVERFLOW : (uint8_t)(2 * node + (element == '-'));
+  }
+
+  /**
+   * True once an element has been added since the last character
+   */
+  bool pending() const {
+    return node != 1;
+  }
+
+  /**
+   * Drop a partly keyed character
+   */
+  void reset() {
+    node = 1;
+  }
+
+  /**
+   * End the current character and look it up
+   * @param text receives the UTF-8 text, empty if the pattern is not a character
+   * @return the pattern's tree node, MORSE_NODE_OVERFLOW if it was too long
+   */
+  uint8_t finish(char text[MORSE_TEXT_SIZE]) {
+    uint8_t finished = node;
+    lookup(finished, text);
+    node = 1;
+    return finished;
+  }
+
+  /**
+   * Text for a tree node: the selected region first, then the prosigns,
+   * then the international tree
+   */
+  void lookup(uint8_t pattern, char text[MORSE_TEXT_SIZE]) const {
+    text[0] = '\0';
+    if (pattern == MORSE_NODE_OVERFLOW) {
+      return;
+    }
+
+    uint8_t count;
+    const MorseSymbol *symbols = regionSymbols(region, count);
+    if (findSymbol(symbols, count, pattern, text)) {
+      return;
+    }
+    if (findSymbol(MORSE_PROSIGNS, sizeof(MORSE_PROSIGNS) / sizeof(MORSE_PROSIGNS[0]), pattern, text)) {
+      return;
+    }
+
+    text[0] = pgm_read_byte(&MorseTree::nodes[pattern]);
+    text[1] = '\0';
+  }
+
+private:
+  uint8_t node;     // Tree node reached by the elements so far
+  uint8_t region;
+
+  static bool findSymbol(const MorseSymbol *symbols, uint8_t count, uint8_t pattern, char text[MORSE_TEXT_SIZE]) {
+    for (uint8_t i = 0; i < count; i++) {
+      if (pgm_read_byte(&symbols[i].node) == pattern) {
+        for (uint8_t j = 0; j < MORSE_TEXT_SIZE; j++) {
+          text[j] = pgm_read_byte(&symbols[i].text[j]);
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+#endif // MORSE_KEYER_MORSE_DECODER_H
@@ -0,0 +1,1253 @@
+/**
+ * MorseKeyer.h
+ * Shared iambic keyer core for the SuperMorse Arduino firmware
+ *
+ * Every board sketch instantiates MorseKeyer with a board traits struct
+ * describing its pins, LED polarity, serial speed, timer source and watchdog.
+ * The traits are compile-time constants, so pin numbers are folded into the
+ * keyer loop and there is no runtime branching on board type. A keyer fix
+ * made here lands on every board at once.
+ *
+ * Paddle contacts are captured by pin-change interrupts into an edge queue,
+ * so no edge is missed while loop() is busy writing to Serial and every edge
+ * carries a microsecond timestamp taken at the moment it happened.
+ *
+ * Elements are generated by an IambicKeyer clocked from a 1 kHz hardware
+ * timer tick. The tick samples each contact through its own integrator
+ * debounce filter, advances the keyer and queues key-down/key-up events for
+ * loop() to report, so element timing does not depend on how long loop()
+ * takes. On the ESP32 the tick runs in a high-priority task woken by the
+ * timer rather than in the interrupt itself. In the straight-key and bug
+ * modes the tick times the operator's key-downs instead, and hand-keyed
+ * elements are reported when they end.
+ *
+ * Element lengths and gap thresholds come from a KeyerTiming model, either
+ * set by the host or adapted to the operator's speed from the captured
+ * key-down durations.
+ *
+ * Output goes through a HostLink: plain text until the app sends its
+ * handshake, then the binary frames described in KeyProtocol.h. The link
+ * buffers output and drains it without blocking, so a host that is slow to
+ * read never delays the keyer.
+ *
+ * With decoding switched on, a MorseDecoder turns the keyed elements into
+ * characters on the device. A character ends when the key has been up for
+ * the timing model's character gap.
+ *
+ * With the sidetone switched on, the tick also sounds a piezo or speaker on
+ * the board in step with the key, so the operator hears the element in the
+ * tick that keys it rather than after a round trip through the host.
+ *
+ * With the key output switched on, the tick also keys a transmitter line
+ * and sequences its PTT line (KeyerOutput.h), so the paddle-to-RF path
+ * never waits on the host either.
+ *
+ * loop() work is run by a CooperativeScheduler from a static task table, in
+ * priority order: key events every pass, character and word gaps as
+ * one-shot deadlines armed at key-up, host commands, receiver audio, a
+ * recording dump, then the LED test, then saving changed settings.
+ * The scheduler counts missed deadlines, which telemetry reports.
+ *
+ * Status text is kept in flash with F() and formatted straight into the
+ * link's frame buffer, so the keyer never touches the heap. Its static RAM
+ * is checked against the board's budget at compile time, and on AVR the
+ * stack headroom is measured at run time (KeyerRam.h).
+ *
+ * KeyerTelemetry keeps loop timing and capture-to-host latency figures,
+ * which the host reads with CMD_TELEMETRY.
+ *
+ * A KeyingRecorder keeps the last raw paddle edges in RAM. CMD_RECORDING
+ * dumps them a frame at a time, as TX buffer space allows, so the host can
+ * save what was keyed when an operator reports a dropped element.
+ *
+ * When there is nothing to do, poll() dozes until the next interrupt, and
+ * after IDLE_SLEEP_AFTER_MS without keying, commands or output a board that
+ * can sleeps until a paddle closes (KeyerSleep.h). The edge that wakes it is
+ * queued with the wake time, and the time from wake to the first element's
+ * key-down is reported with telemetry.
+ *
+ * On a board with a ToneInput, the keyer can also decode CW from a
+ * receiver's audio (KeyerToneInput.h). A Goertzel detector finds the tone's
+ * key-downs and key-ups, and they are reported as FRAME_KEY_EDGEs from
+ * CONTACT_TONE, stamped from the audio sample clock. Received tones never
+ * key the keyer, the sidetone or the transmitter.
+ *
+ * The operator's settings (speed, element shape, debounce, key mode,
+ * sidetone and PTT timing) are kept in the board's ParamStore (KeyerStore.h)
+ * a few seconds after the last change and applied at boot, so the keyer
+ * comes up as it was left before the host has said anything. The host reads
+ * them back with CMD_GET_PARAM.
+ *
+ * A board traits struct must provide:
+ *
+ *   static const uint8_t DOT_PIN;          // Paddle dot contact, left paddle
+ *   static const uint8_t DASH_PIN;         // Paddle dash contact, right paddle
+ *   static const uint8_t LED_PIN;          // Diagnostic LED
+ *   static const uint8_t LED_ON;           // Level that lights the LED (HIGH or LOW)
+ *   static const unsigned long BAUD_RATE;  // Serial speed
+ *   static unsigned long now();            // Millisecond timer source
+ *   static unsigned long nowMicros();      // Microsecond timer source, safe in interrupts
+ *   static void beginTickTimer(KeyerTickHandler handler);  // Call handler at KEYER_TICK_HZ
+ *   static void lockTick();                // Hold off the handler, never called from it
+ *   static void unlockTick();              // Let it run again
+ *   static const uint8_t SIDETONE_PIN;     // Piezo or speaker output
+ *   typedef ... Sidetone;                  // Tone source from KeyerSidetone.h
+ *   static const uint8_t KEY_OUT_PIN;      // Transmitter keying line, NO_PIN if not wired
+ *   static const uint8_t PTT_PIN;          // Transmitter PTT line, NO_PIN if not wired
+ *   typedef ... ParamStore;                // Settings storage from KeyerStore.h
+ *   typedef ... IdleSleep;                 // Low-power idle from KeyerSleep.h
+ *   typedef ... ToneInput;                 // Receiver audio from KeyerToneInput.h
+ *   static const uint16_t KEYER_RAM_BUDGET;     // Most static RAM the keyer may take, in bytes
+ *   static const uint16_t WATCHDOG_TIMEOUT_MS;  // Watchdog period, 0 if there is none
+ *   static void watchdogBegin();           // Start the watchdog (may be empty)
+ *   static void watchdogReset();           // Feed the watchdog (may be empty)
+ */
+
+#ifndef MORSE_KEYER_H
+#define MORSE_KEYER_H
+
+#include <Arduino.h>
+#include "IsrQueue.h"
+#include "IambicKeyer.h"
+#include "KeyProtocol.h"
+#include "KeyerOutput.h"
+#include "KeyerRam.h"
+#include "KeyerScheduler.h"
+#include "KeyerSidetone.h"
+#include "KeyerSleep.h"
+#include "KeyerStore.h"
+#include "KeyerTelemetry.h"
+#include "KeyerTick.h"
+#include "KeyerTiming.h"
+#include "KeyerToneInput.h"
+#include "KeyingRecorder.h"
+#include "MorseDecoder.h"
+
+// Timing constants (in milliseconds)
+const uint8_t DEBOUNCE_DELAY = 5;               // Default contact debounce, settable with PARAM_DEBOUNCE
+const uint8_t MAX_DEBOUNCE_DELAY = 50;          // Longest debounce the host may set
+const unsigned long SERIAL_WAIT_TIMEOUT = 5000; // Give up waiting for the host after 5s
+const uint8_t LED_TEST_BLINKS = 3;              // 'T' blinks the LED this many times
+const uint8_t LED_TEST_STEP_MS = 100;           // ...spending this long on and off
+const uint32_t IDLE_SLEEP_AFTER_MS = 30000;     // Sleep once nothing has happened for this long
+const uint16_t IDLE_SLEEP_MAX_MS = 4000;        // Wake at least this often to feed the watchdog...
+const uint16_t IDLE_LISTEN_MS = 500;            // ...and stay up this long for a host to connect
+
+// Scheduler deadlines (in microseconds)
+const uint32_t EVENT_SLACK_MICROS = 1000000UL / KEYER_TICK_HZ;  // Drain key events every tick
+const uint32_t GAP_SLACK_MICROS = 5000;         // Report a character or word gap within 5ms
+const uint32_t COMMAND_SLACK_MICROS = 10000;    // Read host commands every 10ms
+const uint32_t TONE_SLACK_MICROS = 20000;       // Read receiver audio every 20ms, well inside its DMA pool
+const uint32_t RECORDING_SLACK_MICROS = 20000;  // Offer a recording frame every 20ms while dumping
+const uint32_t LED_TEST_SLACK_MICROS = 20000;
+const uint32_t PARAM_SAVE_DELAY_MICROS = 3000000UL;  // Save settings once they have been left alone 3s
+const uint32_t PARAM_SAVE_SLACK_MICROS = 100000;
+
+// Captured paddle edges and keyer events waiting for loop() (powers of two)
+const uint8_t EDGE_QUEUE_SIZE = 32;
+const uint8_t KEYER_EVENT_QUEUE_SIZE = 16;
+
+// Paddle edges kept for CMD_RECORDING, four bytes each
+#if defined(__AVR__)
+const uint16_t KEYING_RECORDER_SIZE = 48;
+#else
+const uint16_t KEYING_RECORDER_SIZE = 512;
+#endif
+const uint8_t RECORDS_PER_FRAME = 8;
+
+// Receiver audio read per pass while decoding tones, in TONE_READ_SAMPLES batches
+const uint8_t TONE_BATCHES_PER_PASS = 8;
+
+// Settings kept in the ParamStore, in the order they are applied at boot.
+// The block is a layout version, each value as u16 and a CRC-16 of the
+// rest; bump the version when this list changes. The key output itself is
+// not kept, so a board never keys a transmitter before the host enables it.
+const uint8_t SAVED_PARAMS[] PROGMEM = {
+  PARAM_WPM, PARAM_WEIGHTING, PARAM_DAH_RATIO, PARAM_DEBOUNCE, PARAM_KEY_MODE,
+  PARAM_SIDETONE_HZ, PARAM_SIDETONE, PARAM_PTT_LEAD, PARAM_PTT_TAIL, PARAM_PTT_HANG
+};
+const uint8_t SAVED_PARAMS_VERSION = 1;
+const uint8_t SAVED_PARAMS_LENGTH = 1 + 2 * sizeof(SAVED_PARAMS);  // Before the CRC
+
+/**
+ * A paddle contact changing level
+ */
+struct KeyEdge {
+  uint8_t pin;      // Board pin that changed
+  uint8_t level;    // Pin level read in the handler (LOW = pressed)
+  uint32_t micros;  // Board::nowMicros() when the edge was seen
+};
+
+/**
+ * A key-down or key-up produced by the keyer tick
+ */
+struct KeyerEvent {
+  uint8_t events;       // IambicKeyer::KEY_DOWN, KEY_UP and ELEMENT
+  char element;         // Element reported by ELEMENT
+  uint16_t durationMs;  // Key-down length of that element
+  uint32_t micros;      // Board::nowMicros() at the tick
+};
+
+/**
+ * Per-contact integrator debounce state, advanced once per tick
+ */
+struct ContactDebounce {
+  bool pressed;         // Debounced state
+  uint8_t integrator;   // 0 (released) .. debounce ticks (pressed)
+};
+
+template <class Board>
+class MorseKeyer {
+public:
+  MorseKeyer()
+    : debugMode(false),
+      decoding(false),
+      debounceTicks(DEBOUNCE_DELAY),
+      sidetoneEnabled(false),
+      sidetoneHz(SIDETONE_DEFAULT_HZ),
+      dotKeyState(HIGH),
+      dashKeyState(HIGH),
+      lastDroppedEdges(0),
+      dotDownMicros(0),
+      dashDownMicros(0),
+      lastKeyUpMicros(0),
+      wordGapPending(false),
+      ledTestSteps(0),
+      pttLeadMs(0),
+      pttTailMs(0),
+      pttHangDits(0),
+      nextRecord(0),
+      quietSinceMicros(0),
+      scheduler(TASKS) {
+    dotContact.pressed = false;
+    dotContact.integrator = 0;
+    dashContact.pressed = false;
+    dashContact.integrator = 0;
+  }
+
+  /**
+   * Configure pins, serial, keyer tick and watchdog. Call once from setup().
+   */
+  void begin() {
+    static_assert(staticRamBytes() <= Board::KEYER_RAM_BUDGET,
+                  "The keyer's static RAM is over this board's KEYER_RAM_BUDGET");
+    static_assert(SAVED_PARAMS_LENGTH + 2 <= PARAM_BLOCK_SIZE, "SAVED_PARAMS does not fit a ParamBlock");
+    static_assert(Board::WATCHDOG_TIMEOUT_MS == 0 || IDLE_SLEEP_MAX_MS < Board::WATCHDOG_TIMEOUT_MS,
+                  "The keyer would sleep through the watchdog");
+    StackPaint::paint();
+
+    Serial.begin(Board::BAUD_RATE);
+
+    // Paddles connect to ground when pressed
+    pinMode(Board::DOT_PIN, INPUT_PULLUP);
+    pinMode(Board::DASH_PIN, INPUT_PULLUP);
+
+    pinMode(Board::LED_PIN, OUTPUT);
+    setLed(false);
+
+    Board::Sidetone::begin(Board::SIDETONE_PIN);
+    keyOutput.begin();
+
+    // Capture every paddle edge with its timestamp
+    dotKeyState = digitalRead(Board::DOT_PIN);
+    dashKeyState = digitalRead(Board::DASH_PIN);
+    attachInterrupt(digitalPinToInterrupt(Board::DOT_PIN), onDotEdge, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(Board::DASH_PIN), onDashEdge, CHANGE);
+
+    // Come up with the operator's settings, then start the element clock
+    loadParams();
+    applyTiming();
+    instance = this;
+    Board::beginTickTimer(onTick);
+
+    Board::watchdogBegin();
+
+    // Wait for the host, but never hang a board that runs without one
+    unsigned long serialTimeout = Board::now() + SERIAL_WAIT_TIMEOUT;
+    while (!Serial && Board::now() < serialTimeout) {
+      ; // Wait for serial port to connect or timeout
+    }
+
+    link.textLine(F("Morse Decoder Ready"));
+    telemetry.begin(Board::nowMicros());
+    scheduler.start(TASK_KEYER_EVENTS, Board::nowMicros());
+    scheduler.start(TASK_COMMANDS, Board::nowMicros());
+    quietSinceMicros = Board::nowMicros();
+  }
+
+  /**
+   * RAM taken by the keyer object and its interrupt queues. Serial's own
+   * buffers and the stack come on top.
+   */
+  static constexpr uint16_t staticRamBytes() {
+    return sizeof(MorseKeyer) + sizeof(edges) + sizeof(keyerEvents) + sizeof(instance);
+  }
+
+  /**
+   * Run one iteration of the keyer. Call from loop().
+   */
+  void poll() {
+    Board::watchdogReset();
+    telemetry.beginIteration(Board::nowMicros());
+
+    scheduler.runDue(*this, Board::nowMicros());
+
+    link.drain();
+    idle();
+  }
+
+private:
+  // Scheduler tasks, in priority order
+  enum {
+    TASK_KEYER_EVENTS,    // Every pass: report edges and elements
+    TASK_CHARACTER_GAP,   // One-shot at key-up + character gap
+    TASK_WORD_GAP,        // One-shot at key-up + word gap
+    TASK_COMMANDS,        // Every pass: host commands
+    TASK_TONE,            // Every pass while decoding receiver audio
+    TASK_RECORDING,       // Every pass while CMD_RECORDING is dumped
+    TASK_LED_TEST,        // Periodic while 'T' runs
+    TASK_SAVE_PARAMS,     // One-shot a few seconds after a setting changes
+    TASK_COUNT
+  };
+  static const ScheduledTask<MorseKeyer> TASKS[TASK_COUNT];
+
+  static IsrQueue<KeyEdge, EDGE_QUEUE_SIZE> edges;
+  static IsrQueue<KeyerEvent, KEYER_EVENT_QUEUE_SIZE> keyerEvents;
+  static MorseKeyer *instance;
+
+  HostLink link;
+  KeyerTiming timing;
+  KeyerTelemetry telemetry;
+  MorseDecoder decoder;
+  bool debugMode;
+  bool decoding;                  // Send FRAME_CHARACTER for each keyed character
+
+  // Tick state - touched by loop() only with the tick locked (Board::lockTick())
+  IambicKeyer keyer;
+  uint8_t debounceTicks;
+  bool sidetoneEnabled;           // Sound the on-board sidetone with the key
+  uint16_t sidetoneHz;
+  KeyingOutput<Board::KEY_OUT_PIN, Board::PTT_PIN> keyOutput;
+  ContactDebounce dotContact;
+  ContactDebounce dashContact;
+
+  // State variables
+  uint8_t dotKeyState;            // Dot contact level as of the last drained edge
+  uint8_t dashKeyState;           // Dash contact level as of the last drained edge
+  uint16_t lastDroppedEdges;      // Edge queue overflow count already handled
+  uint32_t dotDownMicros;         // When the dot contact last closed
+  uint32_t dashDownMicros;        // When the dash contact last closed
+  uint32_t lastKeyUpMicros;       // When the last element ended
+  bool wordGapPending;            // An element has ended and no word gap has been sent since
+  uint8_t ledTestSteps;           // LED test on/off steps still to run
+  uint8_t pttLeadMs;
+  uint16_t pttTailMs;             // PTT hold after the key line opens...
+  uint8_t pttHangDits;            // ...plus this many dits at the current speed
+
+  ToneReceiver<typename Board::ToneInput> tone;
+  KeyingRecorder<KEYING_RECORDER_SIZE> recorder;
+  uint16_t nextRecord;            // Next record a dump in progress sends
+  uint32_t quietSinceMicros;      // When the keyer last had something to do
+
+  CooperativeScheduler<MorseKeyer, TASK_COUNT> scheduler;
+
+  /**
+   * With nothing to do, wait for the next interrupt rather than spin. After
+   * a long enough quiet spell, sleep until a paddle closes if the board can.
+   */
+  void idle() {
+    uint32_t nowMicros = Board::nowMicros();
+    if (!isQuiet()) {
+      quietSinceMicros = nowMicros;
+      return;
+    }
+    if (Board::IdleSleep::CAN_SLEEP && nowMicros - quietSinceMicros >= IDLE_SLEEP_AFTER_MS * 1000UL &&
+        Board::IdleSleep::sleepAllowed()) {
+      sleepUntilPaddle();
+    } else {
+      Board::IdleSleep::doze();
+    }
+  }
+
+  /**
+   * True when no key, queued work, pending deadline or host traffic needs loop()
+   */
+  bool isQuiet() {
+    if (!edges.isEmpty() || !keyerEvents.isEmpty() || link.txBuffer().used() != 0 || Serial.available() > 0 ||
+        tone.isEnabled()) {
+      return false;
+    }
+    if (scheduler.isArmed(TASK_CHARACTER_GAP) || scheduler.isArmed(TASK_WORD_GAP) || scheduler.isArmed(TASK_RECORDING) ||
+        scheduler.isArmed(TASK_LED_TEST) || scheduler.isArmed(TASK_SAVE_PARAMS)) {
+      return false;
+    }
+    Board::lockTick();
+    bool keyIdle = keyer.isIdle() && dotContact.integrator == 0 && dashContact.integrator == 0;
+    Board::unlockTick();
+    return keyIdle;
+  }
+
+  /**
+   * Sleep with the paddle interrupts off, then queue the edge that woke the
+   * keyer, stamped with the wake time. The contact is still closed, so the
+   * keyer tick starts the element as if it had been awake.
+   *
+   * The edges are queued before the interrupts are attached again, so
+   * loop() is never a second producer on the queue the interrupts feed.
+   * Keying does not depend on the queue, as the tick reads the contacts
+   * itself; a change in the microseconds before the attach is only
+   * reported with the contact's next edge.
+   */
+  void sleepUntilPaddle() {
+    detachInterrupt(digitalPinToInterrupt(Board::DOT_PIN));
+    detachInterrupt(digitalPinToInterrupt(Board::DASH_PIN));
+    Board::IdleSleep::sleep(Board::DOT_PIN, Board::DASH_PIN, IDLE_SLEEP_MAX_MS);
+    uint32_t wakeMicros = Board::nowMicros();
+
+    bool byPaddle = false;
+    uint8_t dotLevel = digitalRead(Board::DOT_PIN);
+    uint8_t dashLevel = digitalRead(Board::DASH_PIN);
+    if (dotLevel != dotKeyState) {
+      KeyEdge edge = { Board::DOT_PIN, dotLevel, wakeMicros };
+      edges.push(edge);
+      byPaddle = true;
+    }
+    if (dashLevel != dashKeyState) {
+      KeyEdge edge = { Board::DASH_PIN, dashLevel, wakeMicros };
+      edges.push(edge);
+      byPaddle = true;
+    }
+    attachInterrupt(digitalPinToInterrupt(Board::DOT_PIN), onDotEdge, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(Board::DASH_PIN), onDashEdge, CHANGE);
+
+    telemetry.recordWake(wakeMicros, byPaddle);
+    // A timed wake goes back to sleep after a short listen for the host
+    quietSinceMicros = byPaddle ? wakeMicros : wakeMicros - (IDLE_SLEEP_AFTER_MS - IDLE_LISTEN_MS) * 1000UL;
+  }
+
+  /**
+   * Pin-change interrupt handlers - timestamp the edge and queue it
+   */
+  static void KEYER_ISR_ATTR onDotEdge() {
+    KeyEdge edge = { Board::DOT_PIN, (uint8_t)digitalRead(Board::DOT_PIN), (uint32_t)Board::nowMicros() };
+    edges.push(edge);
+  }
+
+  static void KEYER_ISR_ATTR onDashEdge() {
+    KeyEdge edge = { Board::DASH_PIN, (uint8_t)digitalRead(Board::DASH_PIN), (uint32_t)Board::nowMicros() };
+    edges.push(edge);
+  }
+
+  /**
+   * Keyer tick interrupt - debounce the contacts and advance the keyer
+   */
+  static void KEYER_ISR_ATTR onTick() {
+    instance->tick();
+  }
+
+  void tick() {
+    bool dotPressed = debounce(dotContact, digitalRead(Board::DOT_PIN) == LOW, debounceTicks);
+    bool dashPressed = debounce(dashContact, digitalRead(Board::DASH_PIN) == LOW, debounceTicks);
+
+    uint8_t events = keyer.tick(dotPressed, dashPressed);
+    if (events & IambicKeyer::KEY_UP) {
+      Board::Sidetone::off();
+    }
+    if ((events & IambicKeyer::KEY_DOWN) && sidetoneEnabled) {
+      Board::Sidetone::on();
+    }
+    keyOutput.tick(keyer.isKeyDown());
+    if (events != 0) {
+      KeyerEvent event = { events, keyer.element(), keyer.elementTicks(), (uint32_t)Board::nowMicros() };
+      keyerEvents.push(event);
+    }
+  }
+
+  /**
+   * Integrator debounce: count up on each closed sample and down on each open
+   * one, saturating at 0 and limit. The output only changes when the count
+   * reaches an end, so a clean change takes limit ticks and bounce merely
+   * slows the count instead of restarting it. Each contact has its own
+   * integrator, so bounce on one paddle never holds off the other.
+   */
+  static bool debounce(ContactDebounce &contact, bool rawPressed, uint8_t limit) {
+    if (rawPressed) {
+      if (contact.integrator < limit) {
+        contact.integrator++;
+      }
+    } else if (contact.integrator > 0) {
+      contact.integrator--;
+    }
+
+    if (contact.integrator == 0) {
+      contact.pressed = false;
+    } else if (contact.integrator >= limit) {
+      contact.integrator = limit;
+      contact.pressed = true;
+    }
+    return contact.pressed;
+  }
+
+  /**
+   * Report the raw edges and feed key-down durations to the timing model
+   */
+  void drainEdges() {
+    KeyEdge edge;
+    while (edges.pop(edge)) {
+      if (edge.pin == Board::DOT_PIN) {
+        trackKeyDown(dotKeyState, dotDownMicros, edge);
+      } else {
+        trackKeyDown(dashKeyState, dashDownMicros, edge);
+      }
+      recorder.record(edge.pin != Board::DOT_PIN, edge.level == LOW, edge.micros);
+      sendKeyEdge(edge.pin == Board::DOT_PIN ? CONTACT_DOT : CONTACT_DASH, edge.level == LOW, edge.micros);
+      telemetry.recordLatency(Board::nowMicros() - edge.micros);
+    }
+
+    // If the queue overflowed, the last queued level may be stale - resync from the pins
+    uint16_t droppedEdges = edges.droppedCount();
+    if (droppedEdges != lastDroppedEdges) {
+      lastDroppedEdges = droppedEdges;
+      dotKeyState = digitalRead(Board::DOT_PIN);
+      dashKeyState = digitalRead(Board::DASH_PIN);
+    }
+  }
+
+  /**
+   * Report a paddle contact or the receiver tone changing, with when it happened
+   */
+  void sendKeyEdge(uint8_t contact, bool down, uint32_t micros) {
+    if (link.isBinary()) {
+      link.beginFrame(FRAME_KEY_EDGE);
+      link.put8(contact);
+      link.put8(down);
+      link.put32(micros);
+      link.endFrame();
+    } else if (debugMode) {
+      link.beginText();
+      link.text(contact == CONTACT_DOT ? F("DEBUG_MSG: EDGE DOT ")
+                                       : (contact == CONTACT_DASH ? F("DEBUG_MSG: EDGE DASH ") : F("DEBUG_MSG: EDGE TONE ")));
+      link.text(down ? F("DOWN ") : F("UP "));
+      link.text(micros);
+      link.endText();
+    }
+  }
+
+  /**
+   * Every-pass task while decoding tones: run the receiver audio sampled
+   * since the last pass through the detector and report its key changes.
+   * A pass takes a few batches at most, so a backlog is worked off over
+   * several passes instead of holding up the paddles.
+   */
+  void readTone() {
+    ToneEdge edge;
+    for (uint8_t batch = 0; batch < TONE_BATCHES_PER_PASS && tone.read(edge) > 0; batch++) {
+      if (edge.changed) {
+        sendKeyEdge(CONTACT_TONE, edge.down, edge.micros);
+      }
+    }
+  }
+
+  /**
+   * Every-pass task: report what the pin interrupts and keyer tick have queued
+   */
+  void serviceKeyer() {
+    drainEdges();
+    drainKeyerEvents();
+  }
+
+  /**
+   * Report the elements the keyer tick has produced and drive the LED with the key
+   */
+  void drainKeyerEvents() {
+    KeyerEvent event;
+    bool released = false;
+    while (keyerEvents.pop(event)) {
+      if (event.events & IambicKeyer::KEY_UP) {
+        setLed(false);
+        lastKeyUpMicros = event.micros;
+        wordGapPending = true;
+        released = true;
+      }
+      if (event.events & IambicKeyer::KEY_DOWN) {
+        setLed(true);
+        telemetry.recordKeyDown(event.micros);
+        wordGapPending = false;
+        scheduler.cancel(TASK_CHARACTER_GAP);
+        scheduler.cancel(TASK_WORD_GAP);
+      }
+      if (event.events & IambicKeyer::ELEMENT) {
+        reportElement(event);
+      }
+    }
+
+    // Time the gaps once the element is reported, as a hand-keyed one may change the speed
+    if (released && wordGapPending) {
+      scheduler.at(TASK_CHARACTER_GAP, lastKeyUpMicros + timing.characterGapMs() * 1000UL);
+      scheduler.at(TASK_WORD_GAP, lastKeyUpMicros + timing.wordGapMs() * 1000UL);
+    }
+  }
+
+  /**
+   * One-shot task: the key has been up for a character gap, so the character is complete
+   */
+  void characterGapEnded() {
+    if (decoder.pending()) {
+      sendCharacter();
+    }
+  }
+
+  /**
+   * One-shot task: the key has been up for a word gap
+   */
+  void wordGapEnded() {
+    if (link.isBinary()) {
+      link.beginFrame(FRAME_GAP);
+      link.put8(GAP_WORD);
+      link.put32(Board::nowMicros());
+      link.endFrame();
+    } else {
+      link.rawText(" ");  // Add space between words
+    }
+    wordGapPending = false;
+  }
+
+  /**
+   * Send one element. A hand-keyed element arrives at key-up and is
+   * stamped with the key-down that started it.
+   */
+  void reportElement(const KeyerEvent &event) {
+    bool manual = (event.events & IambicKeyer::KEY_DOWN) == 0;
+    uint32_t startMicros = manual ? event.micros - event.durationMs * 1000UL : event.micros;
+
+    if (decoding) {
+      decoder.addElement(event.element);
+    }
+    if (link.isBinary()) {
+      link.beginFrame(FRAME_ELEMENT);
+      link.put8(event.element);
+      link.put32(startMicros);
+      link.put16(event.durationMs);
+      link.endFrame();
+    } else {
+      char element[2] = { event.element, '\0' };
+      link.rawText(element);
+    }
+    telemetry.recordLatency(Board::nowMicros() - event.micros);
+
+    if (manual && keyer.keyMode() == STRAIGHT_KEY) {
+      followClassifier();
+    }
+  }
+
+  /**
+   * Take the straight-key speed from the dit/dah classifier. The operator's
+   * fist sets the gaps even when the host has fixed a speed, which then
+   * only seeds the classifier.
+   */
+  void followClassifier() {
+    Board::lockTick();
+    uint16_t unitTicks = keyer.ditDahClassifier().unitTicks();
+    Board::unlockTick();
+    if (timing.followDit(unitTicks * (1000000UL / KEYER_TICK_HZ))) {
+      applyTiming();
+      reportTiming();
+    }
+  }
+
+  /**
+   * Report the character keyed since the last one
+   */
+  void sendCharacter() {
+    char text[MORSE_TEXT_SIZE];
+    uint8_t pattern = decoder.finish(text);
+
+    link.beginFrame(FRAME_CHARACTER);
+    link.put8(pattern);
+    link.put32(lastKeyUpMicros);
+    link.text(text);
+    link.endFrame();
+  }
+
+  /**
+   * Update one contact from an edge and feed completed key-downs to the timing model
+   */
+  void trackKeyDown(uint8_t &keyState, uint32_t &downMicros, const KeyEdge &edge) {
+    if (edge.level == LOW && keyState != LOW) {
+      downMicros = edge.micros;
+    } else if (edge.level != LOW && keyState == LOW) {
+      calibrateTiming(edge.micros - downMicros);
+    }
+    keyState = edge.level;
+  }
+
+  /**
+   * Adapt the timing model to the operator and tell the host when the speed
+   * changes. Hand-keyed modes have their own estimate: the classifier for a
+   * straight key, the host's setting for a bug's automatic dits.
+   */
+  void calibrateTiming(uint32_t keyDownMicros) {
+    if (keyer.isManual()) {
+      return;
+    }
+    if (timing.calibrateTiming(keyDownMicros)) {
+      applyTiming();
+      reportTiming();
+    }
+  }
+
+  /**
+   * Hand the current dit length, and the PTT hold that depends on it, to the keyer tick
+   */
+  void applyTiming() {
+    uint16_t ditTicks = timing.ditMs() * KEYER_TICK_HZ / 1000;
+    Board::lockTick();
+    keyer.setDitTicks(ditTicks);
+    keyOutput.setReleaseTicks(pttTailMs * KEYER_TICK_HZ / 1000 + pttHangDits * ditTicks);
+    Board::unlockTick();
+  }
+
+  /**
+   * Report the current timing estimate to the host
+   */
+  void reportTiming() {
+    if (link.isBinary()) {
+      link.beginFrame(FRAME_TIMING);
+      link.put16(timing.ditMs());
+      link.put8(timing.wpm());
+      link.endFrame();
+    } else {
+      link.beginText();
+      link.text(F("TIMING:WPM="));
+      link.text(timing.wpm());
+      link.text(F(",DIT="));
+      link.text(timing.ditMs());
+      link.endText();
+    }
+    timing.markReported();
+  }
+
+  /**
+   * Periodic task: take the next step of an LED test. The test runs a step
+   * at a time rather than in delay(), so commands and reports carry on.
+   */
+  void runLedTest() {
+    if (ledTestSteps == 0) {
+      scheduler.cancel(TASK_LED_TEST);
+      return;
+    }
+    ledTestSteps--;
+    setLed(ledTestSteps % 2 == 1);
+    if (ledTestSteps == 0) {
+      scheduler.cancel(TASK_LED_TEST);
+      link.textLine(F("DEBUG_MSG: LED test complete"));
+    }
+  }
+
+  /**
+   * Drive the diagnostic LED, honouring the board's LED polarity
+   */
+  void setLed(bool on) {
+    digitalWrite(Board::LED_PIN, on ? Board::LED_ON : !Board::LED_ON);
+  }
+
+  /**
+   * Check for commands from the serial port
+   */
+  void checkSerialCommands() {
+    int cmd = link.readCommand();
+    if (cmd == 0) {
+      return;
+    }
+    if (cmd == HostLink::CMD_FRAME) {
+      handleCommandFrame(link.command(), link.commandSize());
+      return;
+    }
+
+    switch (cmd) {
+      case 'S': // For backward compatibility, map to Iambic mode A
+      case 'P': // For backward compatibility, map to Iambic mode A
+      case 'A': // Iambic paddle mode A (Curtis A)
+        setKeyMode(PADDLE_IAMBIC_A);
+        break;
+      case 'B': // Iambic paddle mode B
+        setKeyMode(PADDLE_IAMBIC_B);
+        break;
+      case 'K': // Straight key
+        setKeyMode(STRAIGHT_KEY);
+        break;
+      case 'G': // Bug (semi-automatic key)
+        setKeyMode(BUG);
+        break;
+      case 'D': // Debug toggle
+        debugMode = !debugMode;
+        link.textLine(debugMode ? F("DEBUG_MSG: Debug mode enabled") : F("DEBUG_MSG: Debug mode disabled"));
+        if (debugMode) {
+          printPinStates();
+          printRamUse();
+        }
+        break;
+      case 'T': // Test LED by blinking it
+        link.textLine(F("DEBUG_MSG: Testing LED..."));
+        ledTestSteps = 2 * LED_TEST_BLINKS;
+        runLedTest();
+        scheduler.start(TASK_LED_TEST, Board::nowMicros());
+        break;
+    }
+  }
+
+  /**
+   * Handle a binary command frame from the host
+   */
+  void handleCommandFrame(const uint8_t *frame, uint8_t length) {
+    switch (frame[0]) {
+      case CMD_HELLO:
+        // Capability handshake - answer, then talk binary from here on
+        if (length < 2) {
+          break;
+        }
+        link.enableBinary();
+        link.beginFrame(FRAME_HELLO);
+        link.put8(PROTOCOL_VERSION);
+        link.put16(CAP_KEY_EDGES | CAP_ELEMENTS | CAP_TIMING | CAP_TELEMETRY | CAP_CHARACTERS | CAP_SIDETONE |
+                   CAP_RECORDER | (Board::KEY_OUT_PIN != NO_PIN ? CAP_KEY_OUTPUT : 0) | CAP_SAVED_PARAMS |
+                   (Board::IdleSleep::CAN_SLEEP ? CAP_SLEEP : 0) | (Board::ToneInput::AVAILABLE ? CAP_TONE_DECODE : 0));
+        link.put8(keyer.keyMode());
+        link.endFrame();
+        reportTiming();
+        break;
+      case CMD_SET_PARAM:
+        if (length < 4) {
+          break;
+        }
+        setParam(frame[1], frame[2] | ((uint16_t)frame[3] << 8));
+        break;
+      case CMD_GET_PARAM: {
+        uint16_t value;
+        if (length >= 2 && paramValue(frame[1], value)) {
+          reportParam(frame[1], value);
+        }
+        break;
+      }
+      case CMD_TELEMETRY:
+        sendTelemetry();
+        break;
+      case CMD_RECORDING:
+        // Restarts a dump already under way
+        recorder.freeze(true);
+        nextRecord = 0;
+        scheduler.start(TASK_RECORDING, Board::nowMicros());
+        break;
+    }
+  }
+
+  /**
+   * Every-pass task while dumping: send the next records once the TX buffer
+   * has room for a whole frame, so a dump never crowds out key reports.
+   * Each frame is
+   *
+   *   first record index u16, record count u16, micros u32,
+   *   key mode u8, host WPM u8 (0 = adaptive), WPM in use u8, debounce ms u8,
+   *   up to RECORDS_PER_FRAME records u32 (see KeyingRecorder.h)
+   *
+   * An empty recording is one frame with no records.
+   */
+  void sendRecordingChunk() {
+    if (link.txBuffer().space() < MAX_ENCODED_FRAME) {
+      return;
+    }
+    uint16_t total = recorder.size();
+    uint16_t chunk = total - nextRecord;
+    if (chunk > RECORDS_PER_FRAME) {
+      chunk = RECORDS_PER_FRAME;
+    }
+
+    link.beginFrame(FRAME_RECORDING);
+    link.put16(nextRecord);
+    link.put16(total);
+    link.put32(Board::nowMicros());
+    link.put8(keyer.keyMode());
+    link.put8(timing.configuredWpm());
+    link.put8(timing.wpm());
+    link.put8(debounceTicks * 1000UL / KEYER_TICK_HZ);
+    for (uint16_t i = 0; i < chunk; i++) {
+      link.put32(recorder.at(nextRecord + i));
+    }
+    link.endFrame();
+
+    nextRecord += chunk;
+    if (nextRecord >= total) {
+      scheduler.cancel(TASK_RECORDING);
+      recorder.freeze(false);
+    }
+  }
+
+  /**
+   * Report loop and latency figures for the window since the last report:
+   *
+   *   loops/s u32, longest loop us u32,
+   *   latency p50/p90/p99/max us u32 x4,
+   *   TX high water u16, TX size u16, TX overflows u16,
+   *   dropped edges u16, dropped keyer events u16, bad host frames u16,
+   *   watchdog timeout ms u16, longest watchdog feed gap ms u16 (since boot),
+   *   scheduler deadline misses u16 (since boot), worst lateness us u32,
+   *   stack headroom bytes u16 (0xFFFF where it is not measured)
+   *
+   * followed, on a board that sleeps, by FRAME_SLEEP with figures since boot:
+   *
+   *   sleeps u16, paddle wakes u16,
+   *   last wake-to-key-down us u32, worst wake-to-key-down us u32
+   */
+  void sendTelemetry() {
+    uint32_t nowMicros = Board::nowMicros();
+    uint32_t feedGapMs = telemetry.worstFeedGapMicros() / 1000;
+
+    link.beginFrame(FRAME_TELEMETRY);
+    link.put32(telemetry.loopsPerSecond(nowMicros));
+    link.put32(telemetry.maxIterationMicros());
+    link.put32(telemetry.latencyPercentile(50));
+    link.put32(telemetry.latencyPercentile(90));
+    link.put32(telemetry.latencyPercentile(99));
+    link.put32(telemetry.maxLatencyMicros());
+    link.put16(link.txBuffer().highWater());
+    link.put16(TX_BUFFER_SIZE);
+    link.put16(link.txBuffer().overflowCount());
+    link.put16(edges.droppedCount());
+    link.put16(keyerEvents.droppedCount());
+    link.put16(link.badFrameCount());
+    link.put16(Board::WATCHDOG_TIMEOUT_MS);
+    link.put16(feedGapMs > 0xFFFF ? 0xFFFF : feedGapMs);
+    link.put16(scheduler.missCount());
+    link.put32(scheduler.worstLatenessMicros());
+    link.put16(StackPaint::headroom());
+    link.endFrame();
+
+    if (Board::IdleSleep::CAN_SLEEP) {
+      link.beginFrame(FRAME_SLEEP);
+      link.put16(telemetry.sleepCount());
+      link.put16(telemetry.paddleWakeCount());
+      link.put32(telemetry.lastWakeLatencyMicros());
+      link.put32(telemetry.worstWakeLatencyMicros());
+      link.endFrame();
+    }
+
+    telemetry.resetWindow(nowMicros);
+    scheduler.resetWindow();
+  }
+
+  /**
+   * Apply a host setting, confirm the value now in force and keep it for
+   * the next boot
+   */
+  void setParam(uint8_t param, uint16_t value) {
+    uint16_t applied;
+    if (!applyParam(param, value, applied)) {
+      return;
+    }
+    reportParam(param, applied);
+    if (param == PARAM_WPM) {
+      reportTiming();
+    }
+    if (param == PARAM_KEY_MODE) {
+      reportKeyMode(keyer.keyMode());
+    }
+    // A change to a setting that is not kept leaves the block as it is, so saving it writes nothing
+    scheduler.at(TASK_SAVE_PARAMS, Board::nowMicros() + PARAM_SAVE_DELAY_MICROS);
+  }
+
+  void reportParam(uint8_t param, uint16_t value) {
+    link.beginFrame(FRAME_PARAM);
+    link.put8(param);
+    link.put16(value);
+    link.endFrame();
+  }
+
+  /**
+   * Put a setting into force without telling the host
+   * @return false for a parameter this keyer does not have
+   */
+  bool applyParam(uint8_t param, uint16_t value, uint16_t &applied) {
+    switch (param) {
+      case PARAM_WPM:
+        applied = timing.setWpm(value > 255 ? 255 : value);
+        applyTiming();
+        Board::lockTick();
+        keyer.resetClassifier();
+        Board::unlockTick();
+        break;
+      case PARAM_DEBOUNCE:
+        applied = value < 1 ? 1 : (value > MAX_DEBOUNCE_DELAY ? MAX_DEBOUNCE_DELAY : value);
+        Board::lockTick();
+        debounceTicks = applied * KEYER_TICK_HZ / 1000;
+        Board::unlockTick();
+        break;
+      case PARAM_DECODE:
+        // Characters are frames, so decoding needs the binary protocol
+        decoding = value != 0 && link.isBinary();
+        decoder.reset();
+        applied = decoding;
+        break;
+      case PARAM_DECODE_REGION:
+        applied = decoder.setRegion(value > 255 ? 255 : value);
+        break;
+      case PARAM_SIDETONE:
+        // A tone already sounding stops; the next key-down starts it
+        Board::lockTick();
+        sidetoneEnabled = value != 0;
+        Board::Sidetone::off();
+        Board::unlockTick();
+        applied = sidetoneEnabled;
+        break;
+      case PARAM_SIDETONE_HZ:
+        applied = sidetoneHz = value < SIDETONE_MIN_HZ ? SIDETONE_MIN_HZ : (value > SIDETONE_MAX_HZ ? SIDETONE_MAX_HZ : value);
+        Board::lockTick();
+        Board::Sidetone::setPitch(applied);
+        Board::unlockTick();
+        break;
+      case PARAM_KEY_OUTPUT:
+        Board::lockTick();
+        keyOutput.setEnabled(value != 0 && Board::KEY_OUT_PIN != NO_PIN);
+        Board::unlockTick();
+        applied = keyOutput.isEnabled();
+        break;
+      case PARAM_PTT_LEAD:
+        applied = pttLeadMs = value > PTT_MAX_LEAD_MS ? PTT_MAX_LEAD_MS : value;
+        Board::lockTick();
+        keyOutput.setLeadTicks(applied * KEYER_TICK_HZ / 1000);
+        Board::unlockTick();
+        break;
+      case PARAM_PTT_TAIL:
+        applied = pttTailMs = value > PTT_MAX_TAIL_MS ? PTT_MAX_TAIL_MS : value;
+        applyTiming();
+        break;
+      case PARAM_PTT_HANG:
+        applied = pttHangDits = value > PTT_MAX_HANG_DITS ? PTT_MAX_HANG_DITS : value;
+        applyTiming();
+        break;
+      case PARAM_WEIGHTING:
+        Board::lockTick();
+        keyer.setShape(value > 255 ? 255 : value, keyer.dahRatioTenths());
+        Board::unlockTick();
+        applied = keyer.weightingPercent();
+        break;
+      case PARAM_DAH_RATIO:
+        Board::lockTick();
+        keyer.setShape(keyer.weightingPercent(), value > 255 ? 255 : value);
+        Board::unlockTick();
+        applied = keyer.dahRatioTenths();
+        break;
+      case PARAM_KEY_MODE:
+        if (value <= BUG) {
+          applyKeyMode((KeyMode)value);
+        }
+        applied = keyer.keyMode();
+        break;
+      case PARAM_TONE_DECODE:
+        if (!Board::ToneInput::AVAILABLE) {
+          return false;
+        }
+        applied = tone.setEnabled(value != 0);
+        if (applied) {
+          scheduler.start(TASK_TONE, Board::nowMicros());
+        } else {
+          scheduler.cancel(TASK_TONE);
+        }
+        break;
+      case PARAM_TONE_HZ:
+        if (!Board::ToneInput::AVAILABLE) {
+          return false;
+        }
+        applied = tone.setPitch(value);
+        break;
+      default:
+        return false;
+    }
+    return true;
+  }
+
+  /**
+   * The value in force for a setting, as CMD_SET_PARAM sets it
+   * @return false for a parameter this keyer does not have
+   */
+  bool paramValue(uint8_t param, uint16_t &value) {
+    switch (param) {
+      case PARAM_WPM: value = timing.configuredWpm(); break;
+      case PARAM_DEBOUNCE: value = debounceTicks * 1000UL / KEYER_TICK_HZ; break;
+      case PARAM_DECODE: value = decoding; break;
+      case PARAM_DECODE_REGION: value = decoder.regionInUse(); break;
+      case PARAM_SIDETONE: value = sidetoneEnabled; break;
+      case PARAM_SIDETONE_HZ: value = sidetoneHz; break;
+      case PARAM_KEY_OUTPUT: value = keyOutput.isEnabled(); break;
+      case PARAM_PTT_LEAD: value = pttLeadMs; break;
+      case PARAM_PTT_TAIL: value = pttTailMs; break;
+      case PARAM_PTT_HANG: value = pttHangDits; break;
+      case PARAM_WEIGHTING: value = keyer.weightingPercent(); break;
+      case PARAM_DAH_RATIO: value = keyer.dahRatioTenths(); break;
+      case PARAM_KEY_MODE: value = keyer.keyMode(); break;
+      case PARAM_TONE_DECODE: value = tone.isEnabled(); return Board::ToneInput::AVAILABLE;
+      case PARAM_TONE_HZ: value = tone.pitchHz(); return Board::ToneInput::AVAILABLE;
+      default: return false;
+    }
+    return true;
+  }
+
+  /**
+   * Apply the settings kept by an earlier session. A block that fails its
+   * check (a new board, or another layout version) leaves the defaults.
+   */
+  void loadParams() {
+    ParamBlock block;
+    Board::ParamStore::read(block);
+    uint16_t crc = block.bytes[SAVED_PARAMS_LENGTH] | ((uint16_t)block.bytes[SAVED_PARAMS_LENGTH + 1] << 8);
+    if (block.bytes[0] != SAVED_PARAMS_VERSION || crc != crc16(block.bytes, SAVED_PARAMS_LENGTH)) {
+      return;
+    }
+    for (uint8_t i = 0; i < sizeof(SAVED_PARAMS); i++) {
+      uint16_t applied;
+      applyParam(pgm_read_byte(&SAVED_PARAMS[i]), block.bytes[1 + 2 * i] | ((uint16_t)block.bytes[2 + 2 * i] << 8), applied);
+    }
+  }
+
+  /**
+   * One-shot task: keep the settings in force for the next boot. The store
+   * is written only when they differ from what it holds, to spare its wear,
+   * and only while the key is idle, as a flash write can stall the CPU.
+   */
+  void saveParams() {
+    if (keyer.isKeyDown() || wordGapPending) {
+      scheduler.at(TASK_SAVE_PARAMS, Board::nowMicros() + PARAM_SAVE_DELAY_MICROS);
+      return;
+    }
+
+    ParamBlock block;
+    memset(block.bytes, 0xFF, sizeof(block.bytes));
+    block.bytes[0] = SAVED_PARAMS_VERSION;
+    for (uint8_t i = 0; i < sizeof(SAVED_PARAMS); i++) {
+      uint16_t value = 0;
+      paramValue(pgm_read_byte(&SAVED_PARAMS[i]), value);
+      block.bytes[1 + 2 * i] = value & 0xFF;
+      block.bytes[2 + 2 * i] = value >> 8;
+    }
+    uint16_t crc = crc16(block.bytes, SAVED_PARAMS_LENGTH);
+    block.bytes[SAVED_PARAMS_LENGTH] = crc & 0xFF;
+    block.bytes[SAVED_PARAMS_LENGTH + 1] = crc >> 8;
+
+    ParamBlock stored;
+    Board::ParamStore::read(stored);
+    if (memcmp(stored.bytes, block.bytes, sizeof(block.bytes)) != 0) {
+      Board::ParamStore::write(block);
+    }
+  }
+
+  /**
+   * Name of a key mode as reported in text mode
+   */
+  static const __FlashStringHelper *keyModeName(KeyMode mode) {
+    switch (mode) {
+      case PADDLE_IAMBIC_B: return F("PADDLE_IAMBIC_B");
+      case STRAIGHT_KEY: return F("STRAIGHT_KEY");
+      case BUG: return F("BUG");
+      default: return F("PADDLE_IAMBIC_A");
+    }
+  }
+
+  /**
+   * Switch key mode on a single-character command, confirm it to the host
+   * and keep it for the next boot
+   */
+  void setKeyMode(KeyMode mode) {
+    applyKeyMode(mode);
+    reportKeyMode(mode);
+    scheduler.at(TASK_SAVE_PARAMS, Board::nowMicros() + PARAM_SAVE_DELAY_MICROS);
+  }
+
+  void applyKeyMode(KeyMode mode) {
+    // Leaving the straight key, go back to the host's speed if it set one
+    if (keyer.keyMode() == STRAIGHT_KEY && timing.configuredWpm() != 0) {
+      timing.setWpm(timing.configuredWpm());
+      applyTiming();
+    }
+
+    Board::lockTick();
+    keyer.setMode(mode);
+    Board::unlockTick();
+  }
+
+  void reportKeyMode(KeyMode mode) {
+    if (link.isBinary()) {
+      link.beginFrame(FRAME_MODE);
+      link.put8(mode);
+      link.endFrame();
+    } else {
+      link.beginText();
+      link.text(F("MODE:"));
+      link.text(keyModeName(mode));
+      link.endText();
+    }
+    if (debugMode) {
+      link.beginText();
+      link.text(F("DEBUG_MSG: "));
+      link.text(keyModeName(mode));
+      link.text(F(" activated"));
+      link.endText();
+    }
+  }
+
+  /**
+   * Report the keyer's static RAM and, on AVR, the stack headroom left
+   */
+  void printRamUse() {
+    link.beginText();
+    link.text(F("DEBUG_MSG: RAM keyer "));
+    link.text(staticRamBytes());
+    link.text(F(" of "));
+    link.text(Board::KEYER_RAM_BUDGET);
+    link.text(F(" bytes"));
+    uint16_t headroom = StackPaint::headroom();
+    if (headroom != STACK_HEADROOM_UNKNOWN) {
+      link.text(F(", stack headroom "));
+      link.text(headroom);
+      link.text(F(" bytes"));
+    }
+    link.endText();
+  }
+
+  /**
+   * Report the raw state of both paddle contacts
+   */
+  void printPinStates() {
+    link.beginText();
+    link.text(F("DEBUG_MSG: DOT PIN (GPIO "));
+    link.text(Board::DOT_PIN);
+    link.text(digitalRead(Board::DOT_PIN) == LOW ? F(") = PRESSED (LOW)") : F(") = RELEASED (HIGH)"));
+    link.endText();
+    link.beginText();
+    link.text(F("DEBUG_MSG: DASH PIN (GPIO "));
+    link.text(Board::DASH_PIN);
+    link.text(digitalRead(Board::DASH_PIN) == LOW ? F(") = PRESSED (LOW)") : F(") = RELEASED (HIGH)"));
+    link.endText();
+  }
+};
+
+template <class Board>
+IsrQueue<KeyEdge, EDGE_QUEUE_SIZE> MorseKeyer<Board>::edges;
+
+template <class Board>
+IsrQueue<KeyerEvent, KEYER_EVENT_QUEUE_SIZE> MorseKeyer<Board>::keyerEvents;
+
+template <class Board>
+MorseKeyer<Board> *MorseKeyer<Board>::instance = 0;
+
+template <class Board>
+const ScheduledTask<MorseKeyer<Board> > MorseKeyer<Board>::TASKS[TASK_COUNT] = {
+  { &MorseKeyer<Board>::serviceKeyer, 0, EVENT_SLACK_MICROS },
+  { &MorseKeyer<Board>::characterGapEnded, 0, GAP_SLACK_MICROS },
+  { &MorseKeyer<Board>::wordGapEnded, 0, GAP_SLACK_MICROS },
+  { &MorseKeyer<Board>::checkSerialCommands, 0, COMMAND_SLACK_MICROS },
+  { &MorseKeyer<Board>::readTone, 0, TONE_SLACK_MICROS },
+  { &MorseKeyer<Board>::sendRecordingChunk, 0, RECORDING_SLACK_MICROS },
+  { &MorseKeyer<Board>::runLedTest, LED_TEST_STEP_MS * 1000UL, LED_TEST_SLACK_MICROS },
+  { &MorseKeyer<Board>::saveParams, 0, PARAM_SAVE_SLACK_MICROS },
+};
+
+#endif // MORSE_KEYER_H
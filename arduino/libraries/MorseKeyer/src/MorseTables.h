@@ -0,0 +1,391 @@
+/**
+ * MorseTables.h
+ * Morse code tables for on-device decoding, kept in flash
+ *
+ * The international characters are folded at compile time into a binary
+ * tree in heap order: the root (no elements yet) is node 1, a dit moves from
+ * node n to 2n and a dah to 2n + 1. A pattern of up to 7 elements therefore
+ * maps to a single byte, and decoding a character is one table read. The
+ * tree is generated from the readable pattern list below by constexpr
+ * functions, so adding a character means adding one line.
+ *
+ * Prosigns and the regional characters are short lists of (node, UTF-8 text)
+ * pairs that are checked before the tree, so a region can claim a pattern
+ * that is punctuation in the international table. Each regional list holds
+ * the characters of that country in alphabets.js, leaving out the Latin
+ * letters that share a pattern with an international letter (Sámi Š is S
+ * on the air). Russian and Wabun replace the Latin alphabet, so they keep
+ * every pattern. Keep the tables in step with alphabets.js.
+ */
+
+#ifndef MORSE_KEYER_MORSE_TABLES_H
+#define MORSE_KEYER_MORSE_TABLES_H
+
+#include <Arduino.h>
+
+// Longest pattern the tree holds, and the number of nodes that needs
+const uint8_t MAX_MORSE_ELEMENTS = 7;
+const uint16_t MORSE_TREE_SIZE = 1 << (MAX_MORSE_ELEMENTS + 1);
+
+// Longest decoded text in UTF-8 bytes (the Övdalian Ę́ is two code points), plus the terminator
+const uint8_t MORSE_TEXT_SIZE = 5;
+
+/**
+ * Tree node reached by a pattern of '.' and '-'
+ */
+constexpr uint8_t morseNode(const char *pattern, uint8_t node = 1) {
+  return *pattern == '\0' ? node : morseNode(pattern + 1, (uint8_t)(2 * node + (*pattern == '-')));
+}
+
+constexpr uint8_t morseLength(const char *pattern) {
+  return *pattern == '\0' ? 0 : 1 + morseLength(pattern + 1);
+}
+
+/**
+ * A character of the international table, only used at compile time
+ */
+struct MorseCode {
+  const char *pattern;
+  char symbol;
+};
+
+constexpr MorseCode INTERNATIONAL_CODES[] = {
+  { ".-", 'A' }, { "-...", 'B' }, { "-.-.", 'C' }, { "-..", 'D' }, { ".", 'E' },
+  { "..-.", 'F' }, { "--.", 'G' }, { "....", 'H' }, { "..", 'I' }, { ".---", 'J' },
+  { "-.-", 'K' }, { ".-..", 'L' }, { "--", 'M' }, { "-.", 'N' }, { "---", 'O' },
+  { ".--.", 'P' }, { "--.-", 'Q' }, { ".-.", 'R' }, { "...", 'S' }, { "-", 'T' },
+  { "..-", 'U' }, { "...-", 'V' }, { ".--", 'W' }, { "-..-", 'X' }, { "-.--", 'Y' },
+  { "--..", 'Z' },
+  { "-----", '0' }, { ".----", '1' }, { "..---", '2' }, { "...--", '3' }, { "....-", '4' },
+  { ".....", '5' }, { "-....", '6' }, { "--...", '7' }, { "---..", '8' }, { "----.", '9' },
+  { ".-.-.-", '.' }, { "--..--", ',' }, { "..--..", '?' }, { "-.-.--", '!' }, { "-..-.", '/' },
+  { "-.--.", '(' }, { "-.--.-", ')' }, { ".-...", '&' }, { "---...", ':' }, { "-.-.-.", ';' },
+  { "-...-", '=' }, { ".-.-.", '+' }, { "-....-", '-' }, { "..--.-", '_' }, { ".-..-.", '"' },
+  { "...-..-", '$' }, { ".--.-.", '@' }, { ".----.", '\'' }
+};
+
+const uint8_t INTERNATIONAL_CODE_COUNT = sizeof(INTERNATIONAL_CODES) / sizeof(INTERNATIONAL_CODES[0]);
+
+/**
+ * Character at a tree node, or 0 for a node no character ends on
+ */
+constexpr char internationalSymbol(uint16_t node, uint8_t i = 0) {
+  return i == INTERNATIONAL_CODE_COUNT ? '\0'
+       : morseNode(INTERNATIONAL_CODES[i].pattern) == node ? INTERNATIONAL_CODES[i].symbol
+       : internationalSymbol(node, i + 1);
+}
+
+/**
+ * Compile-time checks on the table: every pattern fits the tree and no two
+ * characters share a pattern
+ */
+constexpr bool internationalCodesFit(uint8_t i = 0) {
+  return i == INTERNATIONAL_CODE_COUNT
+      || (morseLength(INTERNATIONAL_CODES[i].pattern) <= MAX_MORSE_ELEMENTS && internationalCodesFit(i + 1));
+}
+
+constexpr bool internationalCodeUnique(uint8_t i, uint8_t j) {
+  return j == INTERNATIONAL_CODE_COUNT
+      || (morseNode(INTERNATIONAL_CODES[i].pattern) != morseNode(INTERNATIONAL_CODES[j].pattern)
+          && internationalCodeUnique(i, j + 1));
+}
+
+constexpr bool internationalCodesUnique(uint8_t i = 0) {
+  return i == INTERNATIONAL_CODE_COUNT
+      || (internationalCodeUnique(i, i + 1) && internationalCodesUnique(i + 1));
+}
+
+static_assert(internationalCodesFit(), "Morse pattern longer than the tree");
+static_assert(internationalCodesUnique(), "Two characters share a Morse pattern");
+
+/**
+ * The tree itself: MorseTree::type::nodes[node] is the character at node.
+ * MakeMorseTree counts the node numbers out into a parameter pack (C++11
+ * has no std::index_sequence) and MorseTreeNodes expands them into the
+ * initializer, so the whole table is computed by the compiler.
+ */
+template <uint16_t... Nodes>
+struct MorseTreeNodes {
+  static const char nodes[sizeof...(Nodes)];
+};
+
+template <uint16_t... Nodes>
+const char MorseTreeNodes<Nodes...>::nodes[sizeof...(Nodes)] PROGMEM = { internationalSymbol(Nodes)... };
+
+template <uint16_t Count, uint16_t... Nodes>
+struct MakeMorseTree : MakeMorseTree<Count - 1, Count - 1, Nodes...> {};
+
+template <uint16_t... Nodes>
+struct MakeMorseTree<0, Nodes...> {
+  typedef MorseTreeNodes<Nodes...> type;
+};
+
+typedef MakeMorseTree<MORSE_TREE_SIZE>::type MorseTree;
+
+/**
+ * A prosign or regional character
+ */
+struct MorseSymbol {
+  uint8_t node;
+  char text[MORSE_TEXT_SIZE];
+};
+
+// Prosigns win over the punctuation that shares their pattern (AR is +, BT is =, KN is ()
+const MorseSymbol MORSE_PROSIGNS[] PROGMEM = {
+  { morseNode(".-.-."), "AR" },
+  { morseNode("...-.-"), "SK" },
+  { morseNode("-...-"), "BT" },
+  { morseNode("-.--."), "KN" }
+};
+
+// Regional characters, one table per country in alphabets.js
+
+const MorseSymbol MORSE_NORWAY[] PROGMEM = {
+  { morseNode(".-.-"), "Æ" },
+  { morseNode("---."), "Ø" },
+  { morseNode(".--.-"), "Å" }
+};
+
+const MorseSymbol MORSE_SWEDEN[] PROGMEM = {
+  { morseNode(".--.-"), "Å" },
+  { morseNode(".-.-"), "Ä" },
+  { morseNode("---."), "Ö" }
+};
+
+const MorseSymbol MORSE_SAMI_NORTHERN[] PROGMEM = {
+  { morseNode(".-.-"), "Á" }
+};
+
+const MorseSymbol MORSE_SAMI_SOUTHERN[] PROGMEM = {
+  { morseNode(".-.-"), "Ä" },
+  { morseNode(".--.-"), "Å" },
+  { morseNode("---."), "Ö" }
+};
+
+const MorseSymbol MORSE_OVDALIAN[] PROGMEM = {
+  { morseNode(".-.-"), "Ä" },
+  { morseNode(".--.-"), "Å" },
+  { morseNode("..-.."), "Ę" },
+  { morseNode("---."), "Ø" },
+  { morseNode("..-..."), "Ę́" }
+};
+
+const MorseSymbol MORSE_GERMANY[] PROGMEM = {
+  { morseNode(".-.-"), "Ä" },
+  { morseNode("---."), "Ö" },
+  { morseNode("..--"), "Ü" },
+  { morseNode("...--.."), "ß" }
+};
+
+const MorseSymbol MORSE_FRANCE[] PROGMEM = {
+  { morseNode("..-.."), "É" },
+  { morseNode(".-..-"), "È" },
+  { morseNode("-.-.."), "Ç" },
+  { morseNode(".--.-"), "À" },
+  { morseNode("..--"), "Ù" }
+};
+
+const MorseSymbol MORSE_SPAIN[] PROGMEM = {
+  { morseNode("--.--"), "Ñ" },
+  { morseNode(".--.-"), "Á" },
+  { morseNode("..-.."), "É" },
+  { morseNode("..--"), "Ú" }
+};
+
+const MorseSymbol MORSE_DENMARK[] PROGMEM = {
+  { morseNode(".-.-"), "Æ" },
+  { morseNode("---."), "Ø" },
+  { morseNode(".--.-"), "Å" }
+};
+
+const MorseSymbol MORSE_FINLAND[] PROGMEM = {
+  { morseNode(".--.-"), "Å" },
+  { morseNode(".-.-"), "Ä" },
+  { morseNode("---."), "Ö" }
+};
+
+const MorseSymbol MORSE_ICELAND[] PROGMEM = {
+  { morseNode(".-.-"), "Æ" },
+  { morseNode(".--.-"), "Á" },
+  { morseNode("..-.."), "É" },
+  { morseNode("..--"), "Ú" },
+  { morseNode("---."), "Ö" }
+};
+
+const MorseSymbol MORSE_FAROE[] PROGMEM = {
+  { morseNode(".-.-"), "Æ" },
+  { morseNode("---."), "Ø" },
+  { morseNode(".--.-"), "Á" },
+  { morseNode("..--"), "Ú" }
+};
+
+const MorseSymbol MORSE_ITALY[] PROGMEM = {
+  { morseNode(".-..-"), "È" },
+  { morseNode("..-.."), "É" },
+  { morseNode("---."), "Ò" },
+  { morseNode("-.-..."), "Ç" }
+};
+
+const MorseSymbol MORSE_POLAND[] PROGMEM = {
+  { morseNode(".-.-"), "Ą" },
+  { morseNode("-.-.."), "Ć" },
+  { morseNode("..-.."), "Ę" },
+  { morseNode(".-..-"), "Ł" },
+  { morseNode("--.--"), "Ń" },
+  { morseNode("---."), "Ó" },
+  { morseNode("...-..."), "Ś" },
+  { morseNode("--..-."), "Ź" },
+  { morseNode("--..-"), "Ż" }
+};
+
+const MorseSymbol MORSE_CZECH[] PROGMEM = {
+  { morseNode(".--.-"), "Á" },
+  { morseNode("-.-.."), "Č" },
+  { morseNode("..-.."), "Ď" },
+  { morseNode("--.--"), "Ň" },
+  { morseNode("...-..."), "Š" },
+  { morseNode("..--"), "Ú" }
+};
+
+const MorseSymbol MORSE_RUSSIAN[] PROGMEM = {
+  { morseNode(".-"), "А" },
+  { morseNode("-..."), "Б" },
+  { morseNode(".--"), "В" },
+  { morseNode("--."), "Г" },
+  { morseNode("-.."), "Д" },
+  { morseNode("."), "Е" },
+  { morseNode("...-"), "Ж" },
+  { morseNode("--.."), "З" },
+  { morseNode(".."), "И" },
+  { morseNode(".---"), "Й" },
+  { morseNode("-.-"), "К" },
+  { morseNode(".-.."), "Л" },
+  { morseNode("--"), "М" },
+  { morseNode("-."), "Н" },
+  { morseNode("---"), "О" },
+  { morseNode(".--."), "П" },
+  { morseNode(".-."), "Р" },
+  { morseNode("..."), "С" },
+  { morseNode("-"), "Т" },
+  { morseNode("..-"), "У" },
+  { morseNode("..-."), "Ф" },
+  { morseNode("...."), "Х" },
+  { morseNode("-.-."), "Ц" },
+  { morseNode("---."), "Ч" },
+  { morseNode("----"), "Ш" },
+  { morseNode("--.-"), "Щ" },
+  { morseNode("-..-"), "Ъ" },
+  { morseNode("-.--"), "Ы" },
+  { morseNode("..-.."), "Э" },
+  { morseNode("..--"), "Ю" },
+  { morseNode(".-.-"), "Я" }
+};
+
+const MorseSymbol MORSE_WABUN[] PROGMEM = {
+  { morseNode("--.--"), "ア" },
+  { morseNode(".-"), "イ" },
+  { morseNode("..-"), "ウ" },
+  { morseNode("-.---"), "エ" },
+  { morseNode(".-..."), "オ" },
+  { morseNode(".-."), "カ" },
+  { morseNode("-.-.."), "キ" },
+  { morseNode("...-"), "ク" },
+  { morseNode("-.--"), "ケ" },
+  { morseNode("----"), "コ" },
+  { morseNode("-.-.-"), "サ" },
+  { morseNode("--.-."), "シ" },
+  { morseNode("---.-"), "ス" },
+  { morseNode(".---."), "セ" },
+  { morseNode("---."), "ソ" },
+  { morseNode("-."), "タ" },
+  { morseNode("..-."), "チ" },
+  { morseNode(".--."), "ツ" },
+  { morseNode(".-.--"), "テ" },
+  { morseNode("..-.."), "ト" },
+  { morseNode("-.-."), "ニ" },
+  { morseNode("...."), "ヌ" },
+  { morseNode("--.-"), "ネ" },
+  { morseNode("..--"), "ノ" },
+  { morseNode("-..."), "ハ" },
+  { morseNode("--..-"), "ヒ" },
+  { morseNode("-..-"), "フ" },
+  { morseNode("."), "ヘ" },
+  { morseNode("-.."), "ホ" },
+  { morseNode("-..-."), "マ" },
+  { morseNode("..-.-"), "ミ" },
+  { morseNode("-"), "ム" },
+  { morseNode("-..--"), "メ" },
+  { morseNode(".--"), "ヤ" },
+  { morseNode("--"), "ヨ" },
+  { morseNode("..."), "ラ" },
+  { morseNode("-.-"), "リ" },
+  { morseNode("-.--."), "ル" },
+  { morseNode("---"), "レ" },
+  { morseNode(".-.-"), "ロ" },
+  { morseNode(".---"), "ヲ" },
+  { morseNode(".-.."), "ン" },
+  { morseNode(".."), "゛" },
+  { morseNode("..--."), "゜" }
+};
+
+/**
+ * Regional tables selectable with PARAM_DECODE_REGION. The order is the
+ * protocol's region numbering and matches DECODE_REGIONS in key-protocol.js.
+ */
+enum MorseRegion {
+  REGION_INTERNATIONAL = 0,
+  REGION_NORWAY,
+  REGION_SWEDEN,
+  REGION_SAMI_NORTHERN,
+  REGION_SAMI_SOUTHERN,
+  REGION_OVDALIAN,
+  REGION_GERMANY,
+  REGION_FRANCE,
+  REGION_SPAIN,
+  REGION_DENMARK,
+  REGION_FINLAND,
+  REGION_ICELAND,
+  REGION_FAROE,
+  REGION_ITALY,
+  REGION_POLAND,
+  REGION_CZECH,
+  REGION_RUSSIAN,
+  REGION_WABUN,
+  MORSE_REGION_COUNT
+};
+
+template <uint8_t N>
+inline const MorseSymbol *morseTable(const MorseSymbol (&table)[N], uint8_t &count) {
+  count = N;
+  return table;
+}
+
+/**
+ * Symbols of a regional table, with their count (none for international)
+ */
+inline const MorseSymbol *regionSymbols(uint8_t region, uint8_t &count) {
+  switch (region) {
+    case REGION_NORWAY: return morseTable(MORSE_NORWAY, count);
+    case REGION_SWEDEN: return morseTable(MORSE_SWEDEN, count);
+    case REGION_SAMI_NORTHERN: return morseTable(MORSE_SAMI_NORTHERN, count);
+    case REGION_SAMI_SOUTHERN: return morseTable(MORSE_SAMI_SOUTHERN, count);
+    case REGION_OVDALIAN: return morseTable(MORSE_OVDALIAN, count);
+    case REGION_GERMANY: return morseTable(MORSE_GERMANY, count);
+    case REGION_FRANCE: return morseTable(MORSE_FRANCE, count);
+    case REGION_SPAIN: return morseTable(MORSE_SPAIN, count);
+    case REGION_DENMARK: return morseTable(MORSE_DENMARK, count);
+    case REGION_FINLAND: return morseTable(MORSE_FINLAND, count);
+    case REGION_ICELAND: return morseTable(MORSE_ICELAND, count);
+    case REGION_FAROE: return morseTable(MORSE_FAROE, count);
+    case REGION_ITALY: return morseTable(MORSE_ITALY, count);
+    case REGION_POLAND: return morseTable(MORSE_POLAND, count);
+    case REGION_CZECH: return morseTable(MORSE_CZECH, count);
+    case REGION_RUSSIAN: return morseTable(MORSE_RUSSIAN, count);
+    case REGION_WABUN: return morseTable(MORSE_WABUN, count);
+    default:
+      count = 0;
+      return 0;
+  }
+}
+
+#endif // MORSE_KEYER_MORSE_TABLES_H
@@ -0,0 +1,284 @@
+/**
+ * ToneDetector.h
+ * Fixed-point Goertzel tone detector for receiving CW from audio
+ *
+ * Audio samples, as an ADC reads them, are split into blocks of
+ * 1/TONE_BLOCK_HZ seconds. A Goertzel filter measures each block's
+ * amplitude at the tone pitch, so the detector listens to a band about
+ * TONE_BLOCK_HZ wide around it and ignores other signals and hum.
+ *
+ * An envelope follower keeps two levels from the block amplitudes: the
+ * noise floor, tracked while the key is up, and the signal peak, which
+ * attacks at once and decays slowly. The key goes down when a block
+ * crosses half way between them and up when one falls below a quarter of
+ * the way, so fading signals are followed and noise does not chatter the
+ * key. A change must hold for CONFIRM_BLOCKS blocks before it is reported,
+ * which rejects clicks. The first SETTLE_BLOCKS after begin() only measure
+ * the noise, so the receiver's hiss does not key the key when decoding
+ * starts.
+ *
+ * A block only says whether the tone was there, not when in the block it
+ * started. The amplitude does, though: a block the tone filled a third of
+ * reads about a third of the full level. So when the key changes, the
+ * blocks around the edge are measured against the full level to place it,
+ * and lagSamples() says how far back it was. Element lengths come through
+ * to well under a block rather than in 5ms steps.
+ *
+ * Integer arithmetic only, apart from setting the pitch, and no Arduino
+ * calls, so the host build runs it against recorded audio.
+ */
+
+#ifndef MORSE_KEYER_TONE_DETECTOR_H
+#define MORSE_KEYER_TONE_DETECTOR_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+const uint16_t TONE_BLOCK_HZ = 200;        // Blocks per second: 5ms steps, a 200Hz wide filter
+const uint16_t TONE_MIN_HZ = 300;
+const uint16_t TONE_MAX_HZ = 1200;
+const uint16_t TONE_DEFAULT_HZ = 700;
+
+class ToneDetector {
+public:
+  // Blocks a change must hold before the key follows it
+  static const uint8_t CONFIRM_BLOCKS = 2;
+  // Smallest block amplitude, in ADC counts, that can key down
+  static const uint16_t MIN_LEVEL = 8;
+  // Blocks spent measuring the noise before the key can go down
+  static const uint8_t SETTLE_BLOCKS = 8;
+
+  ToneDetector() {
+    begin(8000, TONE_DEFAULT_HZ);
+  }
+
+  /**
+   * Start listening for a pitch, forgetting the levels seen so far
+   * @return the pitch in force, clamped to TONE_MIN_HZ..TONE_MAX_HZ
+   */
+  uint16_t begin(uint32_t sampleHz, uint16_t toneHz) {
+    rate = sampleHz;
+    blockSamples = sampleHz / TONE_BLOCK_HZ;
+    uint16_t pitch = setPitch(toneHz);
+    dc = 0;
+    primed = false;
+    s1 = 0;
+    s2 = 0;
+    count = 0;
+    memset(recent, 0, sizeof(recent));
+    lag = 0;
+    lastAmplitude = 0;
+    noise = 0;
+    peak = 0;
+    settling = SETTLE_BLOCKS;
+    pending = 0;
+    keyDown = false;
+    return pitch;
+  }
+
+  /**
+   * Retune without forgetting the levels
+   * @return the pitch in force, clamped to TONE_MIN_HZ..TONE_MAX_HZ
+   */
+  uint16_t setPitch(uint16_t toneHz) {
+    toneHz = toneHz < TONE_MIN_HZ ? TONE_MIN_HZ : (toneHz > TONE_MAX_HZ ? TONE_MAX_HZ : toneHz);
+    coeff = (int32_t)lround(2.0 * cos(2.0 * M_PI * toneHz / rate) * (1L << COEFF_FRACTION_BITS));
+    pitch = toneHz;
+    return toneHz;
+  }
+
+  uint16_t pitchHz() const {
+    return pitch;
+  }
+
+  /**
+   * Feed one sample
+   * @return true when the key changed at the end of this sample's block
+   */
+  bool addSample(int16_t sample) {
+    // Follow the ADC's bias point so the filter sees only the audio
+    if (!primed) {
+      dc = (int32_t)sample << DC_FRACTION_BITS;
+      primed = true;
+    }
+    dc += (((int32_t)sample << DC_FRACTION_BITS) - dc) >> DC_SHIFT;
+    int32_t x = sample - (dc >> DC_FRACTION_BITS);
+
+    int32_t s0 = x + (int32_t)(((int64_t)coeff * s1) >> COEFF_FRACTION_BITS) - s2;
+    s2 = s1;
+    s1 = s0;
+    if (++count < blockSamples) {
+      return false;
+    }
+    return endBlock();
+  }
+
+  bool isKeyDown() const {
+    return keyDown;
+  }
+
+  /**
+   * Samples between the last change in the audio and the addSample() that reported it
+   */
+  uint16_t lagSamples() const {
+    return lag;
+  }
+
+  uint16_t samplesPerBlock() const {
+    return blockSamples;
+  }
+
+  /**
+   * Amplitude at the pitch over the last block, noise floor and peak, in ADC counts
+   */
+  uint16_t level() const {
+    return lastAmplitude;
+  }
+
+  uint16_t noiseLevel() const {
+    return noise >> LEVEL_FRACTION_BITS;
+  }
+
+  uint16_t peakLevel() const {
+    return peak >> LEVEL_FRACTION_BITS;
+  }
+
+private:
+  static const uint8_t COEFF_FRACTION_BITS = 14;
+  static const uint8_t DC_FRACTION_BITS = 8;
+  static const uint8_t DC_SHIFT = 7;           // Bias tracking time constant, in samples (1 << shift)
+  static const uint8_t LEVEL_FRACTION_BITS = 4;
+  static const uint8_t PEAK_DECAY_SHIFT = 8;   // Key-up blocks for the peak to fall by 1/e
+  static const uint8_t PEAK_FOLLOW_SHIFT = 3;  // Key-down blocks for the peak to follow a fade
+  static const uint8_t NOISE_SHIFT = 3;        // Key-up blocks for the floor to follow the noise
+
+  uint32_t rate;
+  uint16_t blockSamples;
+  uint16_t pitch;
+  int32_t coeff;          // 2cos(2 pi pitch / rate), COEFF_FRACTION_BITS of fraction
+  int32_t dc;             // ADC bias, DC_FRACTION_BITS of fraction
+  bool primed;            // dc has been seeded from the first sample
+  int32_t s1;             // Goertzel state for the block so far
+  int32_t s2;
+  uint16_t count;         // Samples in the block so far
+  uint16_t recent[CONFIRM_BLOCKS + 2];  // Last block amplitudes, newest last
+  uint16_t lag;           // Samples from the last change to its report
+  uint16_t lastAmplitude;
+  uint32_t noise;         // Average key-up amplitude, LEVEL_FRACTION_BITS of fraction
+  uint32_t peak;          // Signal amplitude, LEVEL_FRACTION_BITS of fraction
+  uint8_t settling;       // Blocks still to measure before keying
+  uint8_t pending;        // Blocks in a row that disagree with keyDown
+  bool keyDown;
+
+  /**
+   * Measure the block, update the levels and decide the key
+   */
+  bool endBlock() {
+    int64_t power = (int64_t)s1 * s1 + (int64_t)s2 * s2 -
+                    (((int64_t)coeff * s1) >> COEFF_FRACTION_BITS) * s2;
+    uint32_t amplitude = 2 * squareRoot(power < 0 ? 0 : (uint64_t)power) / blockSamples;
+    lastAmplitude = amplitude > 0xFFFF ? 0xFFFF : amplitude;
+    s1 = 0;
+    s2 = 0;
+    count = 0;
+    memmove(recent, recent + 1, sizeof(recent) - sizeof(recent[0]));
+    recent[CONFIRM_BLOCKS + 1] = lastAmplitude;
+
+    uint32_t level = (uint32_t)lastAmplitude << LEVEL_FRACTION_BITS;
+    if (settling > 0) {
+      noise = settling == SETTLE_BLOCKS ? level : noise + ((int32_t)(level - noise) >> 2);
+      settling--;
+      return false;
+    }
+    uint32_t span = peak > noise ? peak - noise : 0;
+    bool toneOn;
+    if (keyDown) {
+      uint32_t offLevel = noise + span / 4;
+      toneOn = level >= offLevel && lastAmplitude >= MIN_LEVEL;
+    } else {
+      uint32_t onLevel = noise + span / 2;
+      uint32_t clearLevel = 3 * noise + ((uint32_t)MIN_LEVEL << LEVEL_FRACTION_BITS);
+      toneOn = level >= onLevel && level >= clearLevel;
+    }
+
+    if (level > peak) {
+      peak = level;
+    } else if (keyDown) {
+      peak -= (peak - level) >> PEAK_FOLLOW_SHIFT;
+    } else {
+      peak -= peak >> PEAK_DECAY_SHIFT;
+    }
+    if (!keyDown && !toneOn) {
+      noise = noise + ((int32_t)(level - noise) >> NOISE_SHIFT);
+    }
+
+    if (toneOn == keyDown) {
+      pending = 0;
+      return false;
+    }
+    if (++pending < CONFIRM_BLOCKS) {
+      return false;
+    }
+    pending = 0;
+    keyDown = toneOn;
+    placeEdge();
+    return true;
+  }
+
+  /**
+   * Find how far back the key changed from the tone's share of the blocks
+   * around the edge: the confirming blocks and the one before them.
+   */
+  void placeEdge() {
+    const uint8_t span = CONFIRM_BLOCKS + 1;
+    const uint16_t *around = recent + 1;
+    uint16_t full;
+    if (keyDown) {
+      full = around[span - 1] > around[span - 2] ? around[span - 1] : around[span - 2];
+    } else {
+      full = recent[0] > recent[1] ? recent[0] : recent[1];  // Before the tone faded
+    }
+
+    uint32_t toneSamples = 0;
+    for (uint8_t i = 0; i < span; i++) {
+      toneSamples += shareOf(around[i], full);
+    }
+    // A key-down runs from the edge to now; a key-up from the first block to the edge
+    lag = keyDown ? toneSamples : span * blockSamples - toneSamples;
+  }
+
+  /**
+   * Samples of a block the tone filled, from its amplitude against a full block's
+   */
+  uint16_t shareOf(uint16_t amplitude, uint16_t full) const {
+    uint16_t floor = noise >> LEVEL_FRACTION_BITS;
+    if (amplitude <= floor || full <= floor) {
+      return 0;
+    }
+    if (amplitude >= full) {
+      return blockSamples;
+    }
+    return (uint32_t)(amplitude - floor) * blockSamples / (full - floor);
+  }
+
+  static uint32_t squareRoot(uint64_t value) {
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > value) {
+      bit >>= 2;
+    }
+    while (bit != 0) {
+      if (value >= root + bit) {
+        value -= root + bit;
+        root = (root >> 1) + bit;
+      } else {
+        root >>= 1;
+      }
+      bit >>= 2;
+    }
+    return (uint32_t)root;
+  }
+};
+
+#endif // MORSE_KEYER_TONE_DETECTOR_H
@@ -0,0 +1,103 @@
+/**
+ * TxBuffer.h
+ * Fixed-size transmit ring between the keyer and Serial
+ *
+ * Everything the keyer sends goes into this ring and poll() drains it with
+ * only as many bytes as Serial.availableForWrite() says will go without
+ * blocking. When the host stops reading, writes that do not fit are dropped
+ * whole and counted instead of stalling loop().
+ *
+ * Used from loop() only, so no interrupt safety is needed.
+ */
+
+#ifndef MORSE_KEYER_TX_BUFFER_H
+#define MORSE_KEYER_TX_BUFFER_H
+
+#include <Arduino.h>
+
+// Bytes of output held while the host is slow to read (power of two)
+#if defined(__AVR__)
+const uint16_t TX_BUFFER_SIZE = 128;
+#else
+const uint16_t TX_BUFFER_SIZE = 512;
+#endif
+
+class TxBuffer {
+public:
+  static_assert((TX_BUFFER_SIZE & (TX_BUFFER_SIZE - 1)) == 0, "TX_BUFFER_SIZE must be a power of two");
+
+  TxBuffer() : head(0), tail(0), peak(0), overflows(0) {}
+
+  uint16_t used() const {
+    return (head - tail) & (TX_BUFFER_SIZE - 1);
+  }
+
+  uint16_t space() const {
+    return TX_BUFFER_SIZE - 1 - used();
+  }
+
+  /**
+   * Reserve room for a write of length bytes. If it does not fit, the write
+   * is counted as dropped and the caller must not put() any of it, so the
+   * host never sees half a frame or half a line.
+   */
+  bool reserve(uint16_t length) {
+    if (length <= space()) {
+      return true;
+    }
+    overflows++;
+    return false;
+  }
+
+  /**
+   * Append one byte to a reserved write
+   */
+  void put(uint8_t byte) {
+    buffer[head] = byte;
+    head = (head + 1) & (TX_BUFFER_SIZE - 1);
+    uint16_t level = used();
+    if (level > peak) {
+      peak = level;
+    }
+  }
+
+  /**
+   * Hand Serial as much as it can take without blocking
+   */
+  void drain() {
+    int room = Serial.availableForWrite();
+    while (room > 0 && tail != head) {
+      // Contiguous run up to the write index or the end of the buffer
+      uint16_t run = head > tail ? head - tail : TX_BUFFER_SIZE - tail;
+      if (run > room) {
+        run = room;
+      }
+      Serial.write(buffer + tail, run);
+      tail = (tail + run) & (TX_BUFFER_SIZE - 1);
+      room -= run;
+    }
+  }
+
+  /**
+   * Most bytes ever waiting at once
+   */
+  uint16_t highWater() const {
+    return peak;
+  }
+
+  /**
+   * Writes dropped because the buffer was full
+   */
+  uint16_t overflowCount() const {
+    return overflows;
+  }
+
+private:
+  uint8_t buffer[TX_BUFFER_SIZE];
+  uint16_t head;
+  uint16_t tail;
+  uint16_t peak;
+  uint16_t overflows;
+};
+
+#endif // MORSE_KEYER_TX_BUFFER_H
@@ -3,9 +3,9 @@
  * Electron main process entry point
  */
 
-const { app, BrowserWindow, ipcMain, dialog } = require('electron');
+const { app, BrowserWindow, ipcMain, dialog, MessageChannelMain } = require('electron');
 const path = require('path');
-const { SerialPort } = require('serialport');
+const { Worker } = require('worker_threads');
 const Store = require('electron-store');
 const fs = require('fs');
 const mumble = require('node-mumble');
@@ -92,7 +92,16 @@ try {
 
 // Keep a global reference of the window object to prevent garbage collection
 let mainWindow;
-let serialConnection = null;
+
+// Serial I/O runs on workers/serial-port-worker.js. Requests carry an id
+// the worker echoes in its reply; data and status go to the renderer over
+// a MessagePort instead of an IPC message per chunk.
+const DEFAULT_BAUD_RATE = 9600;
+let serialWorker = null;
+const serialRequests = new Map();
+let nextSerialRequestId = 1;
+let serialPortPath = null;
+let serialRendererPort = null;
 
 // Create certificates directory and files if they don't exist with improved error handling
 let CERT_DIR;
@@ -155,6 +164,7 @@ const DEFAULT_SETTINGS = {
   morseSpeed: 13, // Default WPM
   toneFrequency: 600, // Default Hz
   arduinoPort: '', // Will be populated when detected
+  arduinoBaudRate: DEFAULT_BAUD_RATE,
   theme: 'light',
   maidenheadLocator: ''
 };
@@ -174,6 +184,9 @@ function createWindow() {
     }
   });
 
+  // Give each page load a fresh port for serial data and status
+  mainWindow.webContents.on('did-finish-load', openSerialRendererPort);
+
   // Load the index.html file
   mainWindow.loadFile(path.join(__dirname, 'src/renderer/index.html'));
 
@@ -185,8 +198,10 @@ function createWindow() {
   // Set up close event
   mainWindow.on('closed', () => {
     // Close serial connection if open
-    if (serialConnection && serialConnection.isOpen) {
-      serialConnection.close();
+    disconnectSerialPort();
+    if (serialRendererPort) {
+      serialRendererPort.close();
+      serialRendererPort = null;
     }
     mainWindow = null;
   });
@@ -209,6 +224,7 @@ app.whenReady().then(() => {
   });
 
   // Initialize serial port connection
+  startSerialWorker();
   initializeSerialPort();
 });
 
@@ -219,16 +235,121 @@ app.on('window-all-closed', () => {
   if (process.platform !== 'darwin') app.quit();
 });
 
+/**
+ * Start the serial port worker thread
+ */
+function startSerialWorker() {
+  serialWorker = new Worker(path.join(__dirname, 'workers/serial-port-worker.js'));
+  serialWorker.on('message', handleSerialWorkerMessage);
+  serialWorker.on('error', (error) => {
+    console.error('Serial port worker error:', error);
+  });
+  serialWorker.on('exit', (code) => {
+    console.log(`Serial port worker exited with code ${code}`);
+    serialWorker = null;
+    serialPortPath = null;
+    for (const { reject } of serialRequests.values()) {
+      reject(new Error('Serial port worker stopped'));
+    }
+    serialRequests.clear();
+    sendSerialEvent({ type: 'status', status: { connected: false } });
+  });
+}
+
+/**
+ * Ask the serial port worker to do something
+ * @param {string} type - Worker operation, e.g. 'connect' or 'write'
+ * @param {Object} data - Operation arguments
+ * @returns {Promise<Object>} - The worker's result
+ */
+function serialRequest(type, data = {}) {
+  if (!serialWorker) {
+    return Promise.reject(new Error('Serial port worker is not running'));
+  }
+  const id = nextSerialRequestId++;
+  return new Promise((resolve, reject) => {
+    serialRequests.set(id, { resolve, reject });
+    serialWorker.postMessage({ type, data, id });
+  });
+}
+
+/**
+ * Handle a reply or an event from the serial port worker
+ * @param {Object} message - Worker message
+ */
+function handleSerialWorkerMessage(message) {
+  const request = serialRequests.get(message.id);
+  if (request) {
+    serialRequests.delete(message.id);
+    if (message.success) {
+      request.resolve(message.data);
+    } else {
+      request.reject(new Error(message.error));
+    }
+    return;
+  }
+  
+  // Events from ports other than the current one are stale
+  if (message.port !== serialPortPath) return;
+  
+  switch (message.type) {
+    case 'data_received':
+      // A batch of raw bytes - the firmware switches to binary frames after
+      // the handshake. Electron ports only transfer other ports, so this hop
+      // copies the two arrays once per batch.
+      sendSerialEvent({ type: 'data', data: message.data, chunks: message.chunks });
+      break;
+      
+    case 'port_opened':
+    case 'reconnected':
+      console.log(`Connected to ${message.port}`);
+      sendSerialEvent({ type: 'status', status: { connected: true, port: message.port } });
+      break;
+      
+    case 'port_error':
+    case 'reconnect_failed':
+      console.error('Serial port error:', message.error);
+      sendSerialEvent({ type: 'status', status: { connected: false, error: message.error } });
+      break;
+      
+    case 'port_closed':
+      console.log('Serial port closed');
+      sendSerialEvent({ type: 'status', status: { connected: false } });
+      break;
+  }
+}
+
+/**
+ * Hand the renderer a new MessagePort for serial data and status
+ */
+function openSerialRendererPort() {
+  if (serialRendererPort) {
+    serialRendererPort.close();
+  }
+  const { port1, port2 } = new MessageChannelMain();
+  serialRendererPort = port1;
+  mainWindow.webContents.postMessage('serial-port', null, [port2]);
+}
+
+/**
+ * Pass a serial event to the renderer
+ * @param {Object} event - { type: 'data', data, chunks } or { type: 'status', status }
+ */
+function sendSerialEvent(event) {
+  if (serialRendererPort) {
+    serialRendererPort.postMessage(event);
+  }
+}
+
 /**
  * Initialize serial port for Arduino communication with enhanced error handling
  */
 async function initializeSerialPort() {
   try {
-    // Wrap the SerialPort functionality in try-catch to prevent crashes
     // List available ports
     let ports = [];
     try {
-      ports = await SerialPort.list();
+      ports = (await serialRequest('list_ports')).ports;
       
       // Log available ports
       console.log('Available serial ports:');
@@ -251,7 +372,7 @@ async function initializeSerialPort() {
     try {
       const savedPort = store.get('settings.arduinoPort');
       if (savedPort) {
-        connectToSerialPort(savedPort);
+        await connectToSerialPort(savedPort, store.get('settings.arduinoBaudRate'));
       }
     } catch (connectError) {
       console.error('Error auto-connecting to saved port:', connectError);
@@ -264,60 +385,56 @@ async function initializeSerialPort() {
 /**
  * Connect to a specific serial port
  * @param {string} portPath - The path to the serial port
+ * @param {number} baudRate - Line speed; the keyer sketch's BAUD_RATE
+ * @returns {Promise<boolean>} - True once the port is open
  */
-function connectToSerialPort(portPath) {
-  // Close existing connection if open
-  if (serialConnection && serialConnection.isOpen) {
-    serialConnection.close();
+async function connectToSerialPort(portPath, baudRate = DEFAULT_BAUD_RATE) {
+  // Close existing connection if it is another port
+  if (serialPortPath && serialPortPath !== portPath) {
+    await disconnectSerialPort();
   }
   
-  // Create new connection
-  serialConnection = new SerialPort({
-    path: portPath,
-    baudRate: 9600
-  });
-  
-  // Set up event handlers
-  serialConnection.on('open', () => {
-    console.log(`Connected to ${portPath}`);
-    if (mainWindow) {
-      mainWindow.webContents.send('serial-status', { connected: true, port: portPath });
-    }
-    store.set('settings.arduinoPort', portPath);
-  });
-  
-  serialConnection.on('data', (data) => {
-    if (mainWindow) {
-      mainWindow.webContents.send('serial-data', data.toString());
-    }
-  });
-  
-  serialConnection.on('error', (error) => {
-    console.error('Serial port error:', error);
-    if (mainWindow) {
-      mainWindow.webContents.send('serial-status', { connected: false, error: error.message });
-    }
-  });
-  
-  serialConnection.on('close', () => {
-    console.log('Serial port closed');
-    if (mainWindow) {
-      mainWindow.webContents.send('serial-status', { connected: false });
+  serialPortPath = portPath;
+  try {
+    await serialRequest('connect', { port: portPath, options: { baudRate: baudRate || DEFAULT_BAUD_RATE } });
+  } catch (error) {
+    serialPortPath = null;
+    throw error;
+  }
+  store.set('settings.arduinoPort', portPath);
+  return true;
+}
+
+/**
+ * Close the current serial port, if any
+ * @returns {Promise} - Resolves once the worker has closed it
+ */
+async function disconnectSerialPort() {
+  const portPath = serialPortPath;
+  serialPortPath = null;
+  if (portPath) {
+    try {
+      await serialRequest('disconnect', { port: portPath });
+    } catch (error) {
+      console.error('Error closing serial port:', error);
     }
-  });
+  }
 }
 
 /**
  * Send data to the serial port
- * @param {string} data - The data to send
+ * @param {string|Uint8Array} data - Command text or an encoded binary frame
+ * @returns {Promise<boolean>} - True if the worker wrote it
  */
-function sendToSerialPort(data) {
-  if (serialConnection && serialConnection.isOpen) {
-    serialConnection.write(data, (err) => {
-      if (err) {
-        console.error('Error writing to serial port:', err);
-      }
-    });
+async function sendToSerialPort(data) {
+  if (!serialPortPath) return false;
+  
+  try {
+    await serialRequest('write', { port: serialPortPath, data });
+    return true;
+  } catch (error) {
+    console.error('Error writing to serial port:', error);
+    return false;
   }
 }
 
@@ -333,7 +450,7 @@ ipcMain.handle('save-settings', (event, settings) => {
 
 ipcMain.handle('get-serial-ports', async () => {
   try {
-    const ports = await SerialPort.list();
+    const { ports } = await serialRequest('list_ports');
     return ports;
   } catch (error) {
     console.error('Error listing serial ports:', error);
@@ -341,26 +458,75 @@ ipcMain.handle('get-serial-ports', async () => {
   }
 });
 
-ipcMain.handle('connect-serial', (event, port) => {
+ipcMain.handle('connect-serial', async (event, port, baudRate) => {
   try {
-    connectToSerialPort(port);
-    return true;
+    return await connectToSerialPort(port, baudRate);
   } catch (error) {
     console.error('Error connecting to serial port:', error);
     return false;
   }
 });
 
-ipcMain.handle('send-serial', (event, data) => {
+ipcMain.handle('send-serial', async (event, data) => {
   try {
-    sendToSerialPort(data);
-    return true;
+    return await sendToSerialPort(data);
   } catch (error) {
     console.error('Error sending data to serial port:', error);
     return false;
   }
 });
 
+ipcMain.handle('save-keying-recording', async (event, trace) => {
+  try {
+    const stamp = new Date().toISOString().replace(/[:.]/g, '-');
+    const result = await dialog.showSaveDialog(mainWindow, {
+      title: 'Save Keying Recording',
+      defaultPath: `keying-${stamp}.trace`,
+      filters: [{ name: 'Keyer traces', extensions: ['trace'] }]
+    });
+    if (result.canceled || !result.filePath) {
+      return null;
+    }
+    await fs.promises.writeFile(result.filePath, trace, 'utf8');
+    return result.filePath;
+  } catch (error) {
+    console.error('Error saving keying recording:', error);
+    throw error;
+  }
+});
+
+// Serial session capture: the worker appends every chunk it reads to the
+// file (format in src/renderer/js/serial-capture.js)
+ipcMain.handle('start-serial-capture', async () => {
+  const stamp = new Date().toISOString().replace(/[:.]/g, '-');
+  const result = await dialog.showSaveDialog(mainWindow, {
+    title: 'Capture Serial Session',
+    defaultPath: `serial-${stamp}.smcap`,
+    filters: [{ name: 'Serial captures', extensions: ['smcap'] }]
+  });
+  if (result.canceled || !result.filePath) {
+    return null;
+  }
+  await serialRequest('start_capture', { path: result.filePath });
+  return result.filePath;
+});
+
+ipcMain.handle('stop-serial-capture', async () => {
+  return serialRequest('stop_capture');
+});
+
+ipcMain.handle('open-serial-capture', async () => {
+  const result = await dialog.showOpenDialog(mainWindow, {
+    title: 'Replay Serial Capture',
+    filters: [{ name: 'Serial captures', extensions: ['smcap'] }],
+    properties: ['openFile']
+  });
+  if (result.canceled || result.filePaths.length === 0) {
+    return null;
+  }
+  return new Uint8Array(await fs.promises.readFile(result.filePaths[0]));
+});
+
 // User management IPC handlers
 ipcMain.handle('register-user', async (event, userData) => {
   try {
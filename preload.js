@@ -6,6 +6,59 @@
 
 const { contextBridge, ipcRenderer } = require('electron');
 
+// Serial data and status arrive on a MessagePort from the main process,
+// which hands over a new one each time the page loads
+const serialListeners = {
+  data: new Set(),
+  status: new Set()
+};
+
+// Received data comes in batches from the serial worker (see
+// workers/serial-port-worker.js). Counted until the next getSerialStats():
+// batch sizes, and the delay from a batch's first chunk being read to the
+// batch reaching this page.
+let serialStats = newSerialStats();
+
+function newSerialStats() {
+  return { batches: 0, chunks: 0, bytes: 0, largestBatch: 0, totalDelayMs: 0, maxDelayMs: 0 };
+}
+
+function countSerialBatch(data, chunks) {
+  const delayMs = performance.timeOrigin + performance.now() - chunks[1];
+  serialStats.batches++;
+  serialStats.chunks += chunks.length / 2;
+  serialStats.bytes += data.length;
+  serialStats.largestBatch = Math.max(serialStats.largestBatch, chunks.length / 2);
+  serialStats.totalDelayMs += delayMs;
+  serialStats.maxDelayMs = Math.max(serialStats.maxDelayMs, delayMs);
+}
+
+ipcRenderer.on('serial-port', (event) => {
+  const [port] = event.ports;
+  port.onmessage = (message) => {
+    const { type } = message.data;
+    if (type === 'data') {
+      // The whole batch crosses into the page in one call
+      const { data, chunks } = message.data;
+      countSerialBatch(data, chunks);
+      serialListeners.data.forEach(callback => callback(data, chunks));
+    } else if (type === 'status') {
+      serialListeners.status.forEach(callback => callback(message.data.status));
+    }
+  };
+});
+
+/**
+ * Add a serial listener
+ * @returns {Function} - Removes it again
+ */
+function addSerialListener(type, callback) {
+  serialListeners[type].add(callback);
+  return () => {
+    serialListeners[type].delete(callback);
+  };
+}
+
 // Expose API to renderer process
 contextBridge.exposeInMainWorld('electronAPI', {
   // Settings management
@@ -14,26 +67,27 @@ contextBridge.exposeInMainWorld('electronAPI', {
   
   // Serial port communication
   getSerialPorts: () => ipcRenderer.invoke('get-serial-ports'),
-  connectSerial: (port) => ipcRenderer.invoke('connect-serial', port),
+  connectSerial: (port, baudRate) => ipcRenderer.invoke('connect-serial', port, baudRate),
   sendSerial: (data) => ipcRenderer.invoke('send-serial', data),
+  saveKeyingRecording: (trace) => ipcRenderer.invoke('save-keying-recording', trace),
+  startSerialCapture: () => ipcRenderer.invoke('start-serial-capture'),
+  stopSerialCapture: () => ipcRenderer.invoke('stop-serial-capture'),
+  openSerialCapture: () => ipcRenderer.invoke('open-serial-capture'),
   
-  // Serial port events
-  onSerialData: (callback) => {
-    const subscription = (event, data) => callback(data);
-    ipcRenderer.on('serial-data', subscription);
-    return () => {
-      ipcRenderer.removeListener('serial-data', subscription);
-    };
-  },
+  // Serial port events. Data listeners get a batch: the bytes, and a
+  // Float64Array of [end offset, receive time] pairs, one per chunk.
+  onSerialData: (callback) => addSerialListener('data', callback),
   
-  onSerialStatus: (callback) => {
-    const subscription = (event, status) => callback(status);
-    ipcRenderer.on('serial-status', subscription);
-    return () => {
-      ipcRenderer.removeListener('serial-status', subscription);
-    };
+  // Batch counters since the last call, then starts counting afresh
+  getSerialStats: () => {
+    const stats = serialStats;
+    serialStats = newSerialStats();
+    const { totalDelayMs, ...counts } = stats;
+    return { ...counts, meanDelayMs: stats.batches ? totalDelayMs / stats.batches : 0 };
   },
   
+  onSerialStatus: (callback) => addSerialListener('status', callback),
+  
   // User management
   registerUser: (userData) => ipcRenderer.invoke('register-user', userData),
   loginUser: (credentials) => ipcRenderer.invoke('login-user', credentials),
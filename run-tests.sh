@@ -33,12 +33,24 @@ run_test() {
     fi
 }
 
+# Function to build and run the keyer firmware host tests
+run_keyer_tests() {
+    echo -e "${YELLOW}Running Keyer Host Tests...${NC}"
+    make -s -C "$PROJECT_ROOT/arduino/host" test
+    if [ $? -eq 0 ]; then
+        echo -e "${GREEN}✓ Keyer Host Tests completed successfully${NC}\n"
+    else
+        echo -e "${RED}✗ Keyer Host Tests failed${NC}\n"
+    fi
+}
+
 # Display menu
 echo -e "Available tests:\n"
 echo -e "1. ${YELLOW}Simple User Creation Test${NC} - Direct standalone test of user creation"
 echo -e "2. ${YELLOW}Verify User Creation${NC} - Full verification of user creation functionality"
 echo -e "3. ${YELLOW}End-to-End Registration Test${NC} - Complete test of registration form"
-echo -e "4. ${YELLOW}Run All Tests${NC}"
+echo -e "4. ${YELLOW}Keyer Host Tests${NC} - Keyer firmware built for the host and run against a mock Arduino"
+echo -e "5. ${YELLOW}Run All Tests${NC}"
 echo -e "q. ${YELLOW}Quit${NC}"
 
 echo -e "\nEnter your choice:"
@@ -55,10 +67,14 @@ case "$choice" in
         run_test "$PROJECT_ROOT/tests/end-to-end-registration-test.js" "End-to-End Registration Test"
         ;;
     4)
+        run_keyer_tests
+        ;;
+    5)
         echo -e "${BLUE}Running all tests...${NC}\n"
         run_test "$PROJECT_ROOT/tests/test-create-user.js" "Simple User Creation Test"
         run_test "$PROJECT_ROOT/tests/verify-user-creation.js" "User Creation Verification"
         run_test "$PROJECT_ROOT/tests/end-to-end-registration-test.js" "End-to-End Registration Test"
+        run_keyer_tests
         ;;
     q|Q)
         echo -e "${BLUE}Exiting test runner.${NC}"
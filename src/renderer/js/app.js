@@ -7,6 +7,8 @@
 import { AuthManager } from './auth.js';
 import { MorseTrainer } from './training.js';
 import { ArduinoInterface } from './arduino.js';
+import { KeyerTelemetryView } from './keyer-telemetry.js';
+import { SerialReplay, parseSerialCapture } from './serial-capture.js';
 import { SettingsManager } from './settings.js';
 import { MorseAudio } from './morse-audio.js';
 import { MurmurInterface } from './murmur.js';
@@ -366,11 +368,25 @@ class SuperMorseApp {
             const morseSpeed = parseInt(document.getElementById('settingsMorseSpeed').value);
             const volumePercent = parseInt(document.getElementById('settingsVolume').value);
             const arduinoPort = document.getElementById('arduinoPortSelect').value;
+            const arduinoBaudRate = parseInt(document.getElementById('arduinoBaudRate').value);
             const keyMode = document.getElementById('keyModeSelect').value;
             const theme = document.getElementById('themeSelect').value;
             const maidenheadLocator = document.getElementById('maidenheadLocator').value;
             const preferredBand = document.getElementById('preferredBand').value;
             const pauseThreshold = parseInt(document.getElementById('pauseThresholdSlider').value);
+            const keyerDecoding = document.getElementById('keyerDecodingEnabled').checked;
+            const keyerDecodeRegion = document.getElementById('keyerDecodeRegion').value;
+            const keyerSidetone = document.getElementById('keyerSidetoneEnabled').checked;
+            const keyerWpm = parseInt(document.getElementById('keyerWpm').value);
+            const keyerDebounceMs = parseInt(document.getElementById('keyerDebounceMs').value);
+            const keyerWeighting = parseInt(document.getElementById('keyerWeighting').value);
+            const keyerDahRatio = parseFloat(document.getElementById('keyerDahRatio').value);
+            const keyerKeyOutput = document.getElementById('keyerKeyOutputEnabled').checked;
+            const keyerPttLeadMs = parseInt(document.getElementById('keyerPttLeadMs').value);
+            const keyerPttTailMs = parseInt(document.getElementById('keyerPttTailMs').value);
+            const keyerPttHangDits = parseInt(document.getElementById('keyerPttHangDits').value);
+            const keyerToneDecode = document.getElementById('keyerToneDecodeEnabled').checked;
+            const keyerTonePitch = parseInt(document.getElementById('keyerTonePitch').value);
             
             // Get Farnsworth timing settings
             const farnsworthEnabled = document.getElementById('farnsworthEnabled').checked;
@@ -384,13 +400,27 @@ class SuperMorseApp {
                 morseSpeed,
                 volume,
                 arduinoPort,
+                arduinoBaudRate,
                 keyMode,
                 theme,
                 maidenheadLocator,
                 preferredBand,
                 farnsworthEnabled,
                 farnsworthRatio,
-                pauseThreshold
+                pauseThreshold,
+                keyerDecoding,
+                keyerDecodeRegion,
+                keyerSidetone,
+                keyerWpm,
+                keyerDebounceMs,
+                keyerWeighting,
+                keyerDahRatio,
+                keyerKeyOutput,
+                keyerPttLeadMs,
+                keyerPttTailMs,
+                keyerPttHangDits,
+                keyerToneDecode,
+                keyerTonePitch
             });
             
             this.showModal('Settings Saved', 'Your settings have been saved successfully.');
@@ -415,6 +445,87 @@ class SuperMorseApp {
             }
         });
         
+        // Keyer telemetry toggle
+        document.getElementById('keyerTelemetryEnabled').addEventListener('change', (e) => {
+            if (!this.arduino) return;
+            
+            if (!this.arduino.telemetryView) {
+                this.arduino.telemetryView = new KeyerTelemetryView(
+                    document.getElementById('keyerTelemetryChart'),
+                    document.getElementById('keyerTelemetrySummary')
+                );
+            }
+            
+            if (e.target.checked) {
+                if (!this.arduino.startTelemetry()) {
+                    e.target.checked = false;
+                    this.showModal('Keyer Telemetry', 'Connect a keyer running firmware with telemetry support first.');
+                }
+            } else {
+                this.arduino.stopTelemetry();
+                this.arduino.telemetryView.clear();
+            }
+        });
+        
+        // Keying recording export
+        document.getElementById('saveKeyingRecording').addEventListener('click', async () => {
+            if (!this.arduino) return;
+            
+            try {
+                const recording = await this.arduino.requestKeyingRecording();
+                const trace = recording.toTrace(`Recorded ${new Date().toISOString()} on ${this.arduino.currentPort || 'the keyer'}`);
+                const savedPath = await window.electronAPI.saveKeyingRecording(trace);
+                if (savedPath) {
+                    this.showModal('Keying Recording', `Saved ${recording.edges.length} paddle edges to ${savedPath}.`);
+                }
+            } catch (error) {
+                console.error('Error saving keying recording:', error);
+                this.showModal('Keying Recording', error.message);
+            }
+        });
+        
+        // Serial session capture and replay
+        let capturePath = null;
+        document.getElementById('serialCaptureToggle').addEventListener('click', async (e) => {
+            try {
+                if (capturePath) {
+                    const result = await window.electronAPI.stopSerialCapture();
+                    capturePath = null;
+                    e.target.textContent = 'Start Capture';
+                    this.showModal('Serial Capture', `Captured ${result.chunks} chunks, ${result.bytes} bytes, to ${result.path}.`);
+                } else {
+                    capturePath = await window.electronAPI.startSerialCapture();
+                    if (capturePath) {
+                        e.target.textContent = 'Stop Capture';
+                    }
+                }
+            } catch (error) {
+                console.error('Error capturing serial session:', error);
+                this.showModal('Serial Capture', error.message);
+            }
+        });
+        
+        document.getElementById('serialCaptureReplay').addEventListener('click', async () => {
+            if (!this.arduino) return;
+            if (this.arduino.isConnected) {
+                this.showModal('Serial Capture', 'Disconnect the keyer before replaying a capture.');
+                return;
+            }
+            
+            try {
+                const bytes = await window.electronAPI.openSerialCapture();
+                if (!bytes) return;
+                const speed = Number(document.getElementById('serialCaptureSpeed').value);
+                const replay = new SerialReplay(this.arduino, parseSerialCapture(bytes));
+                const result = await replay.play(speed);
+                this.arduino.resetProtocol();
+                this.showModal('Serial Capture', `Replayed ${result.chunks} chunks, ${result.bytes} bytes, in ${(result.elapsedMs / 1000).toFixed(1)} s.`);
+            } catch (error) {
+                console.error('Error replaying serial capture:', error);
+                this.showModal('Serial Capture', error.message);
+            }
+        });
+        
         // Farnsworth toggle
         document.getElementById('farnsworthEnabled').addEventListener('change', (e) => {
             const farnsworthRatioGroup = document.getElementById('farnsworthRatioGroup');
@@ -3,6 +3,24 @@
  * Handles communication with the Arduino Morse decoder
  */
 
+import { FrameDecoder, KEY_MODES, helloFrame, setParamFrame, telemetryRequestFrame, recordingRequestFrame, CAP_KEY_EDGES, CAP_ELEMENTS, CAP_TIMING, CAP_TELEMETRY, CAP_CHARACTERS, CAP_SIDETONE, CAP_RECORDER, CAP_KEY_OUTPUT, CAP_SAVED_PARAMS, CAP_SLEEP, CAP_TONE_DECODE, PARAM_WPM, PARAM_DEBOUNCE, PARAM_DECODE, PARAM_DECODE_REGION, PARAM_SIDETONE, PARAM_SIDETONE_HZ, PARAM_KEY_OUTPUT, PARAM_PTT_LEAD, PARAM_PTT_TAIL, PARAM_PTT_HANG, PARAM_WEIGHTING, PARAM_DAH_RATIO, PARAM_TONE_DECODE, PARAM_TONE_HZ, DECODE_REGIONS } from './key-protocol.js';
+import { KeyingRecording } from './keying-recording.js';
+import { SerialLexer, TOKEN_ELEMENT, TOKEN_GAP, TOKEN_TIMING, TOKEN_MODE, TOKEN_PADDLE, TOKEN_READY, TOKEN_TEXT, TOKEN_BINARY } from './serial-lexer.js';
+
+// Handshake retries while the board boots (the Nano resets when the port opens)
+const HANDSHAKE_INTERVAL = 1000;
+const HANDSHAKE_ATTEMPTS = 5;
+
+// Longest a keying recording may take to arrive
+const RECORDING_TIMEOUT = 5000;
+
+// Key-up time that ends a character, in dits: half way between the 1-dit
+// gap inside a character and the 3-dit gap after it
+const CHARACTER_GAP_DITS = 2;
+
+// Local time in milliseconds, on the same clock as the serial worker's stamps
+const localNow = () => performance.timeOrigin + performance.now();
+
 export class ArduinoInterface {
     /**
      * Initialize Arduino interface
@@ -12,7 +30,6 @@ export class ArduinoInterface {
         this.app = app;
         this.isConnected = false;
         this.currentPort = null;
-        this.buffer = '';
         
         // Morse code processing
         this.morseBuffer = '';
@@ -20,6 +37,50 @@ export class ArduinoInterface {
         this.pauseThreshold = 1000; // Default pause threshold in ms (1 second)
         this.decodeTimer = null; // Timer for auto-decoding after pause
         
+        // Character boundaries come from the gaps between elements, measured
+        // on the clock that timed them: the device's for binary frames, the
+        // serial worker's for text. When the last element ended on that
+        // clock, and the device clock unwrapped to milliseconds together
+        // with how far behind it the local clock sees its frames arrive.
+        this.lastElementEnd = null;
+        this.deviceClock = null;
+        this.deviceOffset = null;
+        this.receivedAt = 0;
+        
+        // Binary key-event protocol (see key-protocol.js)
+        this.binaryProtocol = false;
+        this.deviceCapabilities = 0;
+        this.frameDecoder = new FrameDecoder((event) => this.handleKeyEvent(event));
+        
+        // Text mode, before the handshake (see serial-lexer.js)
+        this.serialLexer = new SerialLexer((type, value, extra) => this.handleSerialToken(type, value, extra));
+        this.textEncoder = new TextEncoder();
+        this.handshakeTimer = null;
+        
+        // Timing model reported by the firmware (null until it reports one)
+        this.deviceTiming = null;
+        
+        // True while the firmware decodes characters itself
+        this.deviceDecoding = false;
+        
+        // Key mode reported by the firmware, e.g. 'STRAIGHT_KEY'
+        this.deviceKeyMode = null;
+        
+        // True while the keyer sounds its own sidetone, so the app stays quiet
+        this.deviceSidetone = false;
+        
+        // Firmware telemetry polling (see keyer-telemetry.js)
+        this.telemetryTimer = null;
+        this.telemetryView = null;
+        
+        // Keying recording being received: { recording, resolve, reject, timer }
+        this.pendingRecording = null;
+        
+        // CW decoded from receiver audio on the keyer: the running dit
+        // estimate and when the current tone started, in device ms
+        this.toneDitMs = null;
+        this.toneDownMs = null;
+        
         // Set up event listeners
         this.setupEventListeners();
     }
@@ -29,8 +90,8 @@ export class ArduinoInterface {
      */
     setupEventListeners() {
         // Set up listeners for serial data and status
-        const serialDataUnsubscribe = window.electronAPI.onSerialData((data) => {
-            this.handleSerialData(data);
+        const serialDataUnsubscribe = window.electronAPI.onSerialData((data, chunks) => {
+            this.handleSerialBatch(data, chunks);
         });
         
         const serialStatusUnsubscribe = window.electronAPI.onSerialStatus((status) => {
@@ -51,7 +112,8 @@ export class ArduinoInterface {
      */
     async connect(port) {
         try {
-            const success = await window.electronAPI.connectSerial(port);
+            const baudRate = this.app.settings ? this.app.settings.getSetting('arduinoBaudRate') : undefined;
+            const success = await window.electronAPI.connectSerial(port, baudRate);
             
             if (success) {
                 this.currentPort = port;
@@ -60,6 +122,9 @@ export class ArduinoInterface {
                 // Update UI
                 this.updateConnectionUI(true);
                 
+                // Ask the firmware to switch to binary key events
+                this.startHandshake();
+                
                 // Configure the Arduino based on current settings
                 await this.configureArduino();
                 
@@ -84,6 +149,7 @@ export class ArduinoInterface {
             // Here we just update our state
             this.isConnected = false;
             this.currentPort = null;
+            this.resetProtocol();
             
             // Update UI
             this.updateConnectionUI(false);
@@ -96,288 +162,499 @@ export class ArduinoInterface {
     }
     
     /**
-     * Handle serial data from the Arduino
-     * @param {string} data - The data received
+     * Start the capability handshake, retrying until the firmware answers
      */
-    handleSerialData(data) {
-        // Add to buffer
-        this.buffer += data;
-        
-        // Process complete lines
-        const lines = this.buffer.split('\n');
+    startHandshake() {
+        this.stopHandshake();
+        let attempts = 0;
         
-        // Keep the last incomplete line in the buffer
-        this.buffer = lines.pop() || '';
+        const sendHello = () => {
+            if (this.binaryProtocol || !this.isConnected || attempts >= HANDSHAKE_ATTEMPTS) {
+                this.stopHandshake();
+                return;
+            }
+            attempts++;
+            window.electronAPI.sendSerial(helloFrame());
+        };
         
-        // Process each complete line
-        lines.forEach(line => {
-            this.processSerialLine(line.trim());
-        });
+        sendHello();
+        this.handshakeTimer = setInterval(sendHello, HANDSHAKE_INTERVAL);
     }
     
     /**
-     * Process a complete line from the Arduino
-     * @param {string} line - The line to process
+     * Stop retrying the capability handshake
      */
-    processSerialLine(line) {
-        // Ignore empty lines
-        if (!line) return;
-        
-        // Log Arduino data as an expandable object with details
-        console.log('Arduino:', {
-            data: line,
-            timestamp: new Date().toISOString(),
-            type: this.determineDataType(line),
-            description: this.getDescriptionForData(line)
-        });
-        
-        // Handle paddle press/release events for sidetone generation
-        if (line === 'left_paddle_pressed' || line === 'right_paddle_pressed') {
-            // Generate sidetone when paddle is pressed
-            if (this.app.morseAudio) {
-                this.app.morseAudio.generateSidetone(true);
-            }
-            return;
+    stopHandshake() {
+        if (this.handshakeTimer) {
+            clearInterval(this.handshakeTimer);
+            this.handshakeTimer = null;
         }
-        
-        if (line === 'left_paddle_released' || line === 'right_paddle_released') {
-            // Stop sidetone when paddle is released
-            if (this.app.morseAudio) {
-                this.app.morseAudio.generateSidetone(false);
-            }
-            return;
+    }
+    
+    /**
+     * Forget the negotiated protocol, e.g. after a disconnect
+     */
+    resetProtocol() {
+        this.stopHandshake();
+        this.stopTelemetry();
+        this.finishRecording(new Error('The keyer disconnected'));
+        this.binaryProtocol = false;
+        this.deviceCapabilities = 0;
+        this.deviceTiming = null;
+        this.deviceDecoding = false;
+        this.deviceKeyMode = null;
+        this.deviceSidetone = false;
+        this.serialLexer.reset();
+        this.resetElementClock();
+    }
+    
+    /**
+     * Handle a batch of serial data from the serial worker, chunk by chunk
+     * so each keeps the time it was read
+     * @param {Uint8Array} data - The chunks back to back
+     * @param {Float64Array} chunks - [end offset, receive time] for each chunk
+     */
+    handleSerialBatch(data, chunks) {
+        let start = 0;
+        for (let i = 0; i < chunks.length; i += 2) {
+            const end = chunks[i];
+            this.handleSerialData(data.subarray(start, end), chunks[i + 1]);
+            start = end;
+        }
+    }
+    
+    /**
+     * Handle serial data from the Arduino
+     * @param {Uint8Array|string} data - The data received
+     * @param {number} receivedAt - When the serial worker read it, in local ms
+     */
+    handleSerialData(data, receivedAt = localNow()) {
+        this.receivedAt = receivedAt;
+        if (typeof data === 'string') {
+            data = this.textEncoder.encode(data);
         }
         
-        // Handle mode response
-        if (line.startsWith('MODE:')) {
-            const mode = line.substring(5);
-            // Use object logging for mode as well
-            console.log('Arduino mode:', {
-                mode: mode,
-                timestamp: new Date().toISOString()
-            });
+        if (this.binaryProtocol) {
+            this.frameDecoder.push(data);
             return;
         }
         
-    // Handle incoming Morse elements (dots and dashes)
-    if (line === '.' || line === '-' || line.includes('.') || line.includes('-')) {
-        // Only process if this appears to be Morse code (only dots, dashes, and spaces)
-        if (/^[.\- ]+$/.test(line)) {
-            // For single dots or dashes, add to buffer without immediate decoding
-            if (line === '.' || line === '-') {
-                this.morseBuffer += line;
-                console.log(`Added ${line} to Morse buffer: ${this.morseBuffer}`);
+        // The lexer stops after the 0x00 that switches to binary frames
+        const consumed = this.serialLexer.push(data);
+        if (consumed < data.length) {
+            this.frameDecoder.push(data.subarray(consumed));
+        }
+    }
+    
+    /**
+     * Handle a token from the text-mode lexer
+     * @param {number} type - One of the TOKEN_ constants in serial-lexer.js
+     * @param {number|string} value - The token's value
+     * @param {number} extra - Second value, for TOKEN_TIMING the dit in ms
+     */
+    handleSerialToken(type, value, extra) {
+        switch (type) {
+            case TOKEN_ELEMENT:
+                this.handleTextElement(String.fromCharCode(value));
+                break;
                 
-                // Reset last signal time to now to start the pause detection
-                this.lastSignalTime = Date.now();
+            case TOKEN_GAP:
+                if (this.morseBuffer) {
+                    this.flushMorseBuffer();
+                }
+                break;
                 
-                // Set up a timer to decode the buffer after a pause threshold
-                this.startDecodeTimer();
-            } else {
-                // For longer sequences, use enhanced pause detection
-                this.processMorseWithPauseDetection(line);
-            }
+            case TOKEN_TIMING:
+                this.handleDeviceTiming(value, extra);
+                break;
+                
+            case TOKEN_MODE:
+                this.deviceKeyMode = KEY_MODES[value];
+                console.log('Arduino mode:', {
+                    mode: this.deviceKeyMode,
+                    timestamp: new Date().toISOString()
+                });
+                break;
+                
+            case TOKEN_PADDLE:
+                // Older firmware reports paddle presses for the sidetone
+                if (this.app.morseAudio) {
+                    this.app.morseAudio.generateSidetone(value === 1);
+                }
+                break;
+                
+            case TOKEN_READY:
+                console.log('Arduino is ready');
+                
+                // The board has just (re)booted in text mode, negotiate again
+                if (this.isConnected && !this.binaryProtocol) {
+                    this.startHandshake();
+                }
+                break;
+                
+            case TOKEN_TEXT:
+                this.processSerialLine(value);
+                break;
+                
+            case TOKEN_BINARY:
+                // Elements are timed on the device's clock from here on
+                this.binaryProtocol = true;
+                this.resetElementClock();
+                break;
         }
-        return;
     }
+    
+    /**
+     * Handle a decoded event from the binary protocol
+     * @param {Object} event - Event from FrameDecoder
+     */
+    handleKeyEvent(event) {
+        switch (event.type) {
+            case 'hello':
+                this.stopHandshake();
+                this.deviceCapabilities = event.capabilities;
+                console.log('Arduino handshake:', {
+                    protocolVersion: event.version,
+                    keyEdges: (event.capabilities & CAP_KEY_EDGES) !== 0,
+                    elements: (event.capabilities & CAP_ELEMENTS) !== 0,
+                    timing: (event.capabilities & CAP_TIMING) !== 0,
+                    telemetry: (event.capabilities & CAP_TELEMETRY) !== 0,
+                    characters: (event.capabilities & CAP_CHARACTERS) !== 0,
+                    sidetone: (event.capabilities & CAP_SIDETONE) !== 0,
+                    recorder: (event.capabilities & CAP_RECORDER) !== 0,
+                    keyOutput: (event.capabilities & CAP_KEY_OUTPUT) !== 0,
+                    savedParams: (event.capabilities & CAP_SAVED_PARAMS) !== 0,
+                    sleep: (event.capabilities & CAP_SLEEP) !== 0,
+                    toneDecode: (event.capabilities & CAP_TONE_DECODE) !== 0,
+                    mode: event.mode
+                });
+                this.deviceKeyMode = event.mode;
+                if (this.app.settings) {
+                    this.setKeyerSpeed(this.app.settings.getSetting('keyerWpm'));
+                    this.setKeyerDebounce(this.app.settings.getSetting('keyerDebounceMs'));
+                    this.setKeyerShape(
+                        this.app.settings.getSetting('keyerWeighting'),
+                        this.app.settings.getSetting('keyerDahRatio')
+                    );
+                    this.setKeyerDecoding(
+                        this.app.settings.getSetting('keyerDecoding'),
+                        this.app.settings.getSetting('keyerDecodeRegion')
+                    );
+                    this.setKeyerSidetone(
+                        this.app.settings.getSetting('keyerSidetone'),
+                        this.app.settings.getSetting('toneFrequency')
+                    );
+                    this.setKeyerOutput(
+                        this.app.settings.getSetting('keyerKeyOutput'),
+                        this.app.settings.getSetting('keyerPttLeadMs'),
+                        this.app.settings.getSetting('keyerPttTailMs'),
+                        this.app.settings.getSetting('keyerPttHangDits')
+                    );
+                    this.setKeyerToneDecoding(
+                        this.app.settings.getSetting('keyerToneDecode'),
+                        this.app.settings.getSetting('keyerTonePitch')
+                    );
+                }
+                break;
+                
+            case 'text':
+                this.processSerialLine(event.text.trim());
+                break;
+                
+            case 'mode':
+                this.deviceKeyMode = event.mode;
+                console.log('Arduino mode:', {
+                    mode: event.mode,
+                    timestamp: new Date().toISOString()
+                });
+                break;
+                
+            case 'edge':
+                if (event.contact === 'tone') {
+                    this.handleToneEdge(event);
+                    break;
+                }
+                // A hand-keyed element's length is only known when it ends,
+                // so the sidetone follows the contact instead
+                if (!this.isHandKeyed(event.contact === 'dash')) break;
+                if (this.app.morseAudio && !this.deviceSidetone) {
+                    this.app.morseAudio.generateSidetone(event.down);
+                }
+                // The element is reported at key-up; until then the
+                // character is still going
+                if (event.down) {
+                    this.stopDecodeTimer();
+                }
+                break;
+                
+            case 'element':
+                this.handleElement(event);
+                break;
+                
+            case 'timing':
+                this.handleDeviceTiming(event.wpm, event.ditMs);
+                break;
+                
+            case 'telemetry':
+                if (this.telemetryView) {
+                    this.telemetryView.update(event, window.electronAPI.getSerialStats());
+                }
+                break;
+                
+            case 'sleep':
+                if (this.telemetryView) {
+                    this.telemetryView.updateSleep(event);
+                }
+                break;
+                
+            case 'character':
+                this.handleDeviceCharacter(event);
+                break;
+                
+            case 'recording':
+                if (this.pendingRecording && this.pendingRecording.recording.add(event)) {
+                    this.finishRecording(null);
+                }
+                break;
+                
+            case 'param':
+                if (event.param === PARAM_DECODE) {
+                    this.deviceDecoding = event.value === 1;
+                } else if (event.param === PARAM_SIDETONE) {
+                    this.deviceSidetone = event.value === 1;
+                }
+                console.log('Arduino parameter:', {
+                    param: event.param,
+                    value: event.value
+                });
+                break;
+                
+            case 'gap':
+                // A word gap ends the current character
+                if (this.morseBuffer) {
+                    this.flushMorseBuffer();
+                }
+                break;
+        }
+    }
+    
+    /**
+     * Handle a keyed element reported by the firmware
+     * @param {Object} event - Element event with element, micros and duration
+     */
+    handleElement(event) {
+        // Sound the sidetone for exactly the keyed duration, unless the
+        // keyer sounds its own or the contact edges already sounded it
+        if (this.app.morseAudio && !this.deviceSidetone && !this.isHandKeyed(event.element === '-')) {
+            this.app.morseAudio.generateSidetone(true);
+            setTimeout(() => this.app.morseAudio.generateSidetone(false), event.duration);
+        }
         
-        // Handle other messages
-        if (line === 'Morse Decoder Ready') {
-            console.log('Arduino is ready');
+        // The firmware reports the character itself when it ends
+        if (this.deviceDecoding) {
+            this.morseBuffer += event.element;
+            this.lastSignalTime = Date.now();
             return;
         }
+        
+        // Automatic elements are sent as they start, hand-keyed ones at key-up
+        const handKeyed = this.isHandKeyed(event.element === '-');
+        const startMs = this.deviceMs(event.micros);
+        const endMs = startMs + event.duration;
+        this.trackDeviceOffset(handKeyed ? endMs : startMs);
+        
+        // Without key edges nothing says a hand-keyed element has started,
+        // so allow for a dah in progress
+        const ditMs = this.keyedDitMs();
+        const holdMs = handKeyed && (this.deviceCapabilities & CAP_KEY_EDGES) === 0 ? 3 * ditMs : 0;
+        this.addTimedElement(event.element, startMs, endMs, endMs + this.deviceOffset, ditMs, holdMs);
     }
     
     /**
-     * Determine the type of data received from Arduino
-     * @param {string} data - The data to analyze
-     * @returns {string} - The type of data
+     * Handle an element the firmware sent as text. It carries no time, so
+     * it is placed by when the serial worker read it and the current speed.
+     * @param {string} element - '.' or '-'
      */
-    determineDataType(data) {
-        if (data === 'left_paddle_pressed' || data === 'right_paddle_pressed' ||
-            data === 'left_paddle_released' || data === 'right_paddle_released') {
-            return 'paddle_event';
-        } else if (data.startsWith('MODE:')) {
-            return 'mode_setting';
-        } else if (data === 'Morse Decoder Ready') {
-            return 'status_message';
-        } else if (data.length === 1) {
-            return 'decoded_character';
-        } else if (/^[.\- ]+$/.test(data)) {
-            return 'morse_code';
+    handleTextElement(element) {
+        const ditMs = this.keyedDitMs();
+        const lengthMs = (element === '-' ? 3 : 1) * ditMs;
+        if (this.isHandKeyed(element === '-')) {
+            // Sent at key-up, and nothing says when the next one starts
+            this.addTimedElement(element, this.receivedAt - lengthMs, this.receivedAt, this.receivedAt, ditMs, 3 * ditMs);
         } else {
-            return 'other';
-        }
-    }
-    
-    /**
-     * Get a human-readable description for Arduino data
-     * @param {string} data - The data to describe
-     * @returns {string} - Description of the data
-     */
-    getDescriptionForData(data) {
-        if (data === 'left_paddle_pressed') {
-            return 'Left paddle has been pressed';
-        } else if (data === 'right_paddle_pressed') {
-            return 'Right paddle has been pressed';
-        } else if (data === 'left_paddle_released') {
-            return 'Left paddle has been released';
-        } else if (data === 'right_paddle_released') {
-            return 'Right paddle has been released';
-        } else if (data.startsWith('MODE:')) {
-            return `Arduino mode set to ${data.substring(5)}`;
-        } else if (data === 'Morse Decoder Ready') {
-            return 'Arduino device is ready for operation';
-        } else if (data.length === 1) {
-            return `Decoded Morse character: ${data}`;
-        } else if (/^[.\- ]+$/.test(data)) {
-            return `Morse code pattern: ${data}`;
-        } else {
-            return 'Other Arduino data';
+            const endMs = this.receivedAt + lengthMs;
+            this.addTimedElement(element, this.receivedAt, endMs, endMs, ditMs);
         }
     }
     
     /**
-     * Process Morse code with pause detection
-     * @param {string} line - The line containing Morse code (dots, dashes, spaces)
+     * Add an element to the Morse buffer, first ending the character before
+     * it if the key was up for a character gap. The gap is measured on the
+     * clock that timed the elements, so USB and renderer delays do not move
+     * it. After the last element of a character there is no next one, so a
+     * timer decodes it once the gap has passed.
+     * @param {string} element - '.' or '-'
+     * @param {number} startMs - When the key went down
+     * @param {number} endMs - When it came up, on the same clock
+     * @param {number} localEndMs - endMs on the local clock
+     * @param {number} ditMs - Dit length the gap is measured in
+     * @param {number} holdMs - Extra wait before the timer decodes
      */
-    processMorseWithPauseDetection(line) {
-        const currentTime = Date.now();
-        const timeElapsed = currentTime - this.lastSignalTime;
-        
-        // Check if enhanced pattern recognition is enabled
-        const usePatternRecognition = this.isPatternRecognitionEnabled();
-        
-        // If significant time has passed since last signal, clear the buffer
-        if (this.lastSignalTime > 0 && timeElapsed > 2 * this.pauseThreshold) {
-            // Process any remaining code in the buffer before clearing
-            if (this.morseBuffer.trim()) {
-                if (usePatternRecognition) {
-                    // Use enhanced decoding with pattern recognition
-                    const knownCharacters = this.getCurrentKnownCharacters();
-                    this.validateAndDecodeCharacter(this.morseBuffer.trim(), knownCharacters);
-                } else {
-                    // Use standard decoding
-                    this.decodeMorseCharacter(this.morseBuffer.trim());
-                }
-            }
-            this.morseBuffer = '';
+    addTimedElement(element, startMs, endMs, localEndMs, ditMs, holdMs = 0) {
+        if (this.morseBuffer && this.lastElementEnd !== null &&
+            startMs - this.lastElementEnd >= CHARACTER_GAP_DITS * ditMs) {
+            this.flushMorseBuffer();
         }
+        this.morseBuffer += element;
+        this.lastElementEnd = endMs;
+        this.lastSignalTime = Date.now();
         
-        // Update last signal time
-        this.lastSignalTime = currentTime;
-        
-        // Process each character in the input line
-        for (let i = 0; i < line.length; i++) {
-            const char = line[i];
-            
-            if (char === '.' || char === '-') {
-                // Add dot or dash to buffer
-                this.morseBuffer += char;
-            } else if (char === ' ') {
-                // Space could be intra-character or inter-character
-                // Count consecutive spaces to determine type
-                let spaceCount = 1;
-                while (i + 1 < line.length && line[i + 1] === ' ') {
-                    spaceCount++;
-                    i++;
-                }
-                
-                if (usePatternRecognition) {
-                    // Use enhanced decision logic for ambiguous pauses
-                    this.processSpacesWithPatternRecognition(spaceCount);
-                } else {
-                    // Use the original simple space-counting approach
-                    this.processSpacesWithSimpleThreshold(spaceCount);
-                }
-            }
+        const dueMs = localEndMs + CHARACTER_GAP_DITS * ditMs + holdMs;
+        this.startDecodeTimer(Math.max(0, dueMs - localNow()));
+    }
+    
+    /**
+     * Dit length for segmenting keyed elements: the keyer's own, or one that
+     * makes the pause threshold the character gap until it reports one
+     * @returns {number} - Dit length in milliseconds
+     */
+    keyedDitMs() {
+        return this.deviceTiming ? this.deviceTiming.ditMs : this.pauseThreshold / CHARACTER_GAP_DITS;
+    }
+    
+    /**
+     * Convert a device timestamp to milliseconds on a clock that does not wrap
+     * @param {number} micros - Device micros from a frame
+     * @returns {number} - Milliseconds since the first timestamp seen
+     */
+    deviceMs(micros) {
+        if (this.deviceClock === null) {
+            this.deviceClock = { micros, ms: 0 };
+        } else {
+            // Signed, so a stamp from before the last one steps back
+            this.deviceClock.ms += ((micros - this.deviceClock.micros) | 0) / 1000;
+            this.deviceClock.micros = micros;
         }
-        
-        // If the line ends without spaces, we may need to process the buffer
-        // But we'll wait for more input or a pause to confirm
+        return this.deviceClock.ms;
     }
     
     /**
-     * Process spaces using the original simple threshold approach
-     * @param {number} spaceCount - Number of consecutive spaces
+     * Learn the local time of device times from a frame sent at sentMs and
+     * read at this.receivedAt. The least delayed frames give the offset;
+     * later ones raise it only slowly, so one delayed chunk does not hold
+     * decoding back.
+     * @param {number} sentMs - Device time, from deviceMs(), the frame was sent
      */
-    processSpacesWithSimpleThreshold(spaceCount) {
-        // Traditional approach: if 3+ spaces, treat as character boundary
-        if (spaceCount >= 3) {
-            // This is likely an inter-character space
-            if (this.morseBuffer.trim()) {
-                this.decodeMorseCharacter(this.morseBuffer.trim());
-            }
-            this.morseBuffer = '';
+    trackDeviceOffset(sentMs) {
+        const offset = this.receivedAt - sentMs;
+        if (this.deviceOffset === null || offset < this.deviceOffset) {
+            this.deviceOffset = offset;
+        } else {
+            this.deviceOffset += (offset - this.deviceOffset) / 16;
         }
-        // Otherwise keep accumulating in the same buffer (intra-character space)
     }
     
     /**
-     * Process spaces using pattern recognition for enhanced boundary detection
-     * @param {number} spaceCount - Number of consecutive spaces
+     * Forget element timing, e.g. when the clock the elements are timed on changes
      */
-    processSpacesWithPatternRecognition(spaceCount) {
-        // Get current known character set
-        const knownCharacters = this.getCurrentKnownCharacters();
-        
-        // Define clear thresholds and ambiguous range
-        const CLEAR_INTRA_CHAR_THRESHOLD = 2;  // Clearly within a character if space count <= 2
-        const CLEAR_INTER_CHAR_THRESHOLD = 4;  // Clearly between characters if space count >= 4
-        
-        // If clearly within a character
-        if (spaceCount <= CLEAR_INTRA_CHAR_THRESHOLD) {
-            // This is likely an intra-character space (element separation)
-            // Keep accumulating in the same buffer
+    resetElementClock() {
+        this.lastElementEnd = null;
+        this.deviceClock = null;
+        this.deviceOffset = null;
+        this.toneDownMs = null;
+    }
+    
+    /**
+     * Handle a key edge the keyer decoded from receiver audio. Received
+     * elements are classified from the device's timestamps against a
+     * running dit estimate, so USB delays do not stretch them, and they
+     * make no sidetone: the receiver is already sounding them.
+     * @param {Object} event - Edge event with contact 'tone', down and micros
+     */
+    handleToneEdge(event) {
+        const atMs = this.deviceMs(event.micros);
+        this.trackDeviceOffset(atMs);
+        if (event.down) {
+            // The character goes on until this tone ends
+            this.toneDownMs = atMs;
+            this.stopDecodeTimer();
             return;
         }
+        if (this.toneDownMs === null) return;
         
-        // If clearly between characters
-        if (spaceCount >= CLEAR_INTER_CHAR_THRESHOLD) {
-            // This is likely an inter-character space
-            // Process the current character and reset buffer
-            if (this.morseBuffer.trim()) {
-                this.validateAndDecodeCharacter(this.morseBuffer.trim(), knownCharacters);
-            }
-            this.morseBuffer = '';
-            return;
+        const durationMs = atMs - this.toneDownMs;
+        const startMs = this.toneDownMs;
+        this.toneDownMs = null;
+        if (this.toneDitMs === null) {
+            this.toneDitMs = this.deviceTiming ? this.deviceTiming.ditMs : 60;
         }
         
-        // AMBIGUOUS CASE (spaceCount = 3)
-        // Use pattern recognition to decide
+        // A key-down under two dits is a dot; each element nudges the
+        // estimate towards the speed being received
+        const element = durationMs < 2 * this.toneDitMs ? '.' : '-';
+        const ditMs = element === '.' ? durationMs : durationMs / 3;
+        this.toneDitMs += (ditMs - this.toneDitMs) / 4;
         
-        // Current buffer - might be a complete character
-        const currentPattern = this.morseBuffer.trim();
+        this.addTimedElement(element, startMs, atMs, atMs + this.deviceOffset, this.toneDitMs);
+    }
+    
+    /**
+     * Whether the current key mode leaves an element's timing to the operator
+     * @param {boolean} dash - True for the dash contact or a dah element
+     * @returns {boolean} - True for a straight key, or a bug's dahs
+     */
+    isHandKeyed(dash) {
+        return this.deviceKeyMode === 'STRAIGHT_KEY' || (this.deviceKeyMode === 'BUG' && dash);
+    }
+    
+    /**
+     * Handle a character decoded by the firmware. It arrives one character
+     * gap after the last element, so no pause timer is needed.
+     * @param {Object} event - Character event with pattern, micros and text
+     */
+    handleDeviceCharacter(event) {
+        this.stopDecodeTimer();
+        this.morseBuffer = '';
         
-        // No pattern to evaluate
-        if (!currentPattern) {
+        if (!event.text) {
+            console.log(`Could not decode Morse pattern: "${event.pattern}"`);
             return;
         }
         
-        // Check if current buffer forms a valid character
-        const currentCharacter = this.isValidMorsePattern(currentPattern, knownCharacters);
-        
-        if (currentCharacter) {
-            // Current buffer forms a valid character, decode it
-            console.log(`Pattern recognition validated: "${currentPattern}" as "${currentCharacter}"`);
-            this.decodeMorseCharacter(currentPattern);
-            this.morseBuffer = '';
+        if (this.isPatternRecognitionEnabled() &&
+            !this.isValidMorsePattern(event.pattern, this.getCurrentKnownCharacters())) {
+            console.log(`Unrecognized Morse pattern: "${event.pattern}"`);
             return;
         }
         
-        // Current pattern doesn't form a valid character
-        // Let's check if it could be the start of a valid character
-        const possibleCompletions = this.getPossibleCompletions(currentPattern, knownCharacters);
+        this.decodeMorseCharacter(event.pattern, event.text);
+    }
+    
+    /**
+     * Adopt the timing model the firmware is keying with
+     * @param {number} wpm - Estimated speed in words per minute
+     * @param {number} ditMs - Estimated dit length in milliseconds
+     */
+    handleDeviceTiming(wpm, ditMs) {
+        this.deviceTiming = { wpm, ditMs };
+        console.log('Arduino timing:', {
+            wpm,
+            ditMs,
+            timestamp: new Date().toISOString()
+        });
+    }
+    
+    /**
+     * Log a line from the Arduino that is not an event of its own
+     * @param {string} line - The line, trimmed
+     */
+    processSerialLine(line) {
+        if (!line) return;
         
-        if (possibleCompletions.length === 0) {
-            // Not the start of any valid character, treat as character boundary
-            console.log(`Pattern "${currentPattern}" is not a valid start to any known character, treating as boundary`);
-            this.morseBuffer = '';
-        } else {
-            // It could be the start of a valid character, keep accumulating
-            console.log(`Pattern "${currentPattern}" could be the start of: ${possibleCompletions.join(', ')}`);
-            // (do nothing, continue with current buffer)
-        }
+        console.log('Arduino:', {
+            data: line,
+            timestamp: new Date().toISOString()
+        });
     }
     
     /**
@@ -408,31 +685,6 @@ export class ArduinoInterface {
         return isAdvancedUser ? char : null;
     }
     
-    /**
-     * Get possible completions for a partial Morse pattern
-     * @param {string} partialPattern - The partial Morse pattern
-     * @param {Array} knownCharacters - Array of characters known to the user
-     * @returns {Array} - Array of possible character completions
-     */
-    getPossibleCompletions(partialPattern, knownCharacters) {
-        if (!partialPattern) return [];
-        
-        const completions = [];
-        const morseAlphabet = window.ALPHABETS.getCompleteMorseAlphabet();
-        
-        // Check each known character
-        for (const char of knownCharacters) {
-            const morsePattern = morseAlphabet[char];
-            
-            // If this character's pattern starts with our partial pattern
-            if (morsePattern && morsePattern.startsWith(partialPattern)) {
-                completions.push(char);
-            }
-        }
-        
-        return completions;
-    }
-    
     /**
      * Validate and decode a Morse character
      * @param {string} morse - The Morse pattern to decode
@@ -496,43 +748,57 @@ export class ArduinoInterface {
     
     /**
      * Start a timer to automatically decode the Morse buffer after a pause
+     * @param {number} delay - Pause in milliseconds (defaults to the pause threshold)
      */
-    startDecodeTimer() {
-        // Clear any existing timer
-        if (this.decodeTimer) {
-            clearTimeout(this.decodeTimer);
-            this.decodeTimer = null;
-        }
+    startDecodeTimer(delay = this.pauseThreshold) {
+        this.stopDecodeTimer();
         
         // Set a timer based on the pause threshold
         this.decodeTimer = setTimeout(() => {
             // Only proceed if we have content in the buffer
             if (this.morseBuffer && this.morseBuffer.trim()) {
                 console.log(`Decode timer fired with buffer: ${this.morseBuffer}`);
-                
-                // Check if we should use pattern recognition
-                if (this.isPatternRecognitionEnabled()) {
-                    // Get known characters for validation
-                    const knownCharacters = this.getCurrentKnownCharacters();
-                    this.validateAndDecodeCharacter(this.morseBuffer, knownCharacters);
-                } else {
-                    // Use standard decoding
-                    this.decodeMorseCharacter(this.morseBuffer);
-                }
-                
-                // Clear the buffer after processing
-                this.morseBuffer = '';
+                this.flushMorseBuffer();
             }
-        }, this.pauseThreshold);
+        }, delay);
+    }
+    
+    /**
+     * Cancel the pending decode, e.g. while an element is still being keyed
+     */
+    stopDecodeTimer() {
+        if (this.decodeTimer) {
+            clearTimeout(this.decodeTimer);
+            this.decodeTimer = null;
+        }
+    }
+    
+    /**
+     * Decode whatever is in the Morse buffer now and clear it
+     */
+    flushMorseBuffer() {
+        this.stopDecodeTimer();
+        
+        // Check if we should use pattern recognition
+        if (this.isPatternRecognitionEnabled()) {
+            // Get known characters for validation
+            const knownCharacters = this.getCurrentKnownCharacters();
+            this.validateAndDecodeCharacter(this.morseBuffer, knownCharacters);
+        } else {
+            // Use standard decoding
+            this.decodeMorseCharacter(this.morseBuffer);
+        }
+        
+        // Clear the buffer after processing
+        this.morseBuffer = '';
     }
     
     /**
      * Decode a Morse code character and handle it
      * @param {string} morse - The Morse code to decode
+     * @param {string} char - The character, when the firmware has already decoded it
      */
-    decodeMorseCharacter(morse) {
-        // Try to decode the Morse code to a character
-        const char = window.ALPHABETS.morseToChar(morse);
+    decodeMorseCharacter(morse, char = window.ALPHABETS.morseToChar(morse)) {
         
         if (char) {
             console.log(`Decoded Morse "${morse}" to character "${char}"`);
@@ -562,6 +828,10 @@ export class ArduinoInterface {
     handleStatusChange(status) {
         this.isConnected = status.connected;
         
+        if (!status.connected) {
+            this.resetProtocol();
+        }
+        
         // Update UI
         this.updateConnectionUI(status.connected);
         
@@ -599,6 +869,12 @@ export class ArduinoInterface {
                 connectButton.textContent = 'Connect';
             }
         }
+        
+        // Telemetry polling stops with the connection
+        const telemetryToggle = document.getElementById('keyerTelemetryEnabled');
+        if (telemetryToggle && !connected) {
+            telemetryToggle.checked = false;
+        }
     }
     
     /**
@@ -637,7 +913,7 @@ export class ArduinoInterface {
     
     /**
      * Set the key mode on the Arduino
-     * @param {string} mode - The key mode to set (S, P, A, B)
+     * @param {string} mode - The key mode to set: A or B (iambic), K (straight key) or G (bug)
      * @returns {Promise} - Resolves when the mode is set
      */
     async setKeyMode(mode) {
@@ -653,6 +929,181 @@ export class ArduinoInterface {
         }
     }
     
+    /**
+     * Set the paddle keyer speed on the Arduino
+     * @param {number} wpm - Speed in WPM (5-60), or 0 to follow the operator
+     * @returns {boolean} - True if the command was sent
+     */
+    setKeyerSpeed(wpm) {
+        return this.setKeyerParam(PARAM_WPM, wpm);
+    }
+    
+    /**
+     * Set how long a paddle contact must settle before the Arduino accepts it
+     * @param {number} ms - Debounce time in milliseconds (1-50)
+     * @returns {boolean} - True if the command was sent
+     */
+    setKeyerDebounce(ms) {
+        return this.setKeyerParam(PARAM_DEBOUNCE, ms);
+    }
+    
+    /**
+     * Set the shape of the elements the Arduino keyer sends
+     * @param {number} weighting - Percent of a dit and its space spent key-down (25-75, 50 is standard)
+     * @param {number} dahRatio - Dah length in dits (2.0-4.5, 3 is standard)
+     * @returns {boolean} - True if the commands were sent
+     */
+    setKeyerShape(weighting, dahRatio) {
+        return this.setKeyerParam(PARAM_WEIGHTING, weighting) &&
+            this.setKeyerParam(PARAM_DAH_RATIO, Math.round(dahRatio * 10));
+    }
+    
+    /**
+     * Have the Arduino decode characters itself
+     * @param {boolean} enabled - True to decode on the device
+     * @param {string} region - alphabets.js country code of the regional table
+     * @returns {boolean} - True if the commands were sent
+     */
+    setKeyerDecoding(enabled, region = 'international') {
+        if (!(this.deviceCapabilities & CAP_CHARACTERS)) return false;
+        
+        const regionIndex = Math.max(0, DECODE_REGIONS.indexOf(region));
+        return this.setKeyerParam(PARAM_DECODE_REGION, regionIndex) &&
+            this.setKeyerParam(PARAM_DECODE, enabled ? 1 : 0);
+    }
+    
+    /**
+     * Have the Arduino sound the sidetone itself, in step with the key
+     * @param {boolean} enabled - True to use the keyer's sidetone instead of the app's
+     * @param {number} frequency - Pitch in Hz
+     * @returns {boolean} - True if the commands were sent
+     */
+    setKeyerSidetone(enabled, frequency) {
+        if (!(this.deviceCapabilities & CAP_SIDETONE)) return false;
+        
+        return this.setKeyerParam(PARAM_SIDETONE_HZ, frequency) &&
+            this.setKeyerParam(PARAM_SIDETONE, enabled ? 1 : 0);
+    }
+    
+    /**
+     * Have the Arduino key a transmitter from its keying output, switching
+     * PTT over before the first element and back after the last
+     * @param {boolean} enabled - True to key the transmitter line and PTT
+     * @param {number} leadMs - PTT lead before the key line closes (0-50)
+     * @param {number} tailMs - PTT hold after the key line opens (0-1000)
+     * @param {number} hangDits - Further PTT hold in dits at the current speed (0-21)
+     * @returns {boolean} - True if the commands were sent
+     */
+    setKeyerOutput(enabled, leadMs, tailMs, hangDits) {
+        if (!(this.deviceCapabilities & CAP_KEY_OUTPUT)) return false;
+        
+        return this.setKeyerParam(PARAM_PTT_LEAD, leadMs) &&
+            this.setKeyerParam(PARAM_PTT_TAIL, tailMs) &&
+            this.setKeyerParam(PARAM_PTT_HANG, hangDits) &&
+            this.setKeyerParam(PARAM_KEY_OUTPUT, enabled ? 1 : 0);
+    }
+    
+    /**
+     * Have the Arduino decode CW from receiver audio on its ADC input and
+     * report it as key edges
+     * @param {boolean} enabled - True to listen to the receiver
+     * @param {number} pitch - Tone pitch to listen for in Hz (300-1200)
+     * @returns {boolean} - True if the commands were sent
+     */
+    setKeyerToneDecoding(enabled, pitch) {
+        if (!(this.deviceCapabilities & CAP_TONE_DECODE)) return false;
+        
+        this.toneDitMs = null;
+        this.toneDownMs = null;
+        return this.setKeyerParam(PARAM_TONE_HZ, pitch) &&
+            this.setKeyerParam(PARAM_TONE_DECODE, enabled ? 1 : 0);
+    }
+    
+    /**
+     * Send one keyer parameter to the Arduino. The firmware answers
+     * with the value it actually applied.
+     * @param {number} param - PARAM_* identifier
+     * @param {number} value - New value
+     * @returns {boolean} - True if the command was sent
+     */
+    setKeyerParam(param, value) {
+        if (!this.isConnected || !this.binaryProtocol || value === undefined) return false;
+        
+        window.electronAPI.sendSerial(setParamFrame(param, value));
+        return true;
+    }
+    
+    /**
+     * Ask the firmware for loop and latency figures at a fixed interval.
+     * Each reply covers the time since the previous request.
+     * @param {number} intervalMs - Time between requests
+     * @returns {boolean} - True if the firmware supports telemetry
+     */
+    startTelemetry(intervalMs = 1000) {
+        this.stopTelemetry();
+        if (!this.isConnected || !this.binaryProtocol || !(this.deviceCapabilities & CAP_TELEMETRY)) {
+            return false;
+        }
+        
+        // The first reply starts a fresh window
+        window.electronAPI.sendSerial(telemetryRequestFrame());
+        this.telemetryTimer = setInterval(() => {
+            window.electronAPI.sendSerial(telemetryRequestFrame());
+        }, intervalMs);
+        return true;
+    }
+    
+    /**
+     * Stop polling for telemetry
+     */
+    stopTelemetry() {
+        if (this.telemetryTimer) {
+            clearInterval(this.telemetryTimer);
+            this.telemetryTimer = null;
+        }
+    }
+    
+    /**
+     * Ask the firmware for the paddle edges it has recorded, e.g. after the
+     * operator reports a dropped element
+     * @returns {Promise<KeyingRecording>} - Resolves once every record has arrived
+     */
+    requestKeyingRecording() {
+        if (!this.isConnected || !this.binaryProtocol || !(this.deviceCapabilities & CAP_RECORDER)) {
+            return Promise.reject(new Error('Connect a keyer running firmware with a keying recorder first.'));
+        }
+        
+        this.finishRecording(new Error('Recording request replaced'));
+        return new Promise((resolve, reject) => {
+            this.pendingRecording = {
+                recording: new KeyingRecording(),
+                resolve,
+                reject,
+                timer: setTimeout(() => {
+                    this.finishRecording(new Error('The keyer did not send its recording in time.'));
+                }, RECORDING_TIMEOUT)
+            };
+            window.electronAPI.sendSerial(recordingRequestFrame());
+        });
+    }
+    
+    /**
+     * Settle the recording request in progress, if any
+     * @param {Error|null} error - Why it failed, or null if it is complete
+     */
+    finishRecording(error) {
+        const pending = this.pendingRecording;
+        if (!pending) return;
+        
+        this.pendingRecording = null;
+        clearTimeout(pending.timer);
+        if (error) {
+            pending.reject(error);
+        } else {
+            pending.resolve(pending.recording);
+        }
+    }
+    
     /**
      * Set the pause threshold for Morse code character detection
      * @param {number} threshold - Pause threshold in milliseconds
@@ -691,6 +1142,9 @@ export class ArduinoInterface {
      * Clean up event listeners
      */
     cleanup() {
+        this.stopHandshake();
+        this.stopTelemetry();
+        
         // Call all unsubscribe functions
         if (this.unsubscribeFunctions) {
             this.unsubscribeFunctions.forEach(unsubscribe => {
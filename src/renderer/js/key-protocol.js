@@ -0,0 +1,406 @@
+/**
+ * key-protocol.js
+ * Binary key-event protocol spoken by the MorseKeyer firmware
+ *
+ * Frames are: type (u8) | body | CRC-16/CCITT-FALSE (u16 LE), COBS-encoded
+ * and terminated by 0x00. Keep the constants in sync with
+ * arduino/libraries/MorseKeyer/src/KeyProtocol.h.
+ */
+
+export const PROTOCOL_VERSION = 1;
+
+// Device -> host frame types
+export const FRAME_HELLO = 0x01;
+export const FRAME_TEXT = 0x02;
+export const FRAME_KEY_EDGE = 0x10;
+export const FRAME_ELEMENT = 0x11;
+export const FRAME_GAP = 0x12;
+export const FRAME_MODE = 0x13;
+export const FRAME_TIMING = 0x14;
+export const FRAME_PARAM = 0x15;
+export const FRAME_TELEMETRY = 0x16;
+export const FRAME_CHARACTER = 0x17;
+export const FRAME_RECORDING = 0x18;
+export const FRAME_SLEEP = 0x19;
+
+// Host -> device command types
+export const CMD_HELLO = 0x01;
+export const CMD_SET_PARAM = 0x02;
+export const CMD_TELEMETRY = 0x03;
+export const CMD_RECORDING = 0x04;
+export const CMD_GET_PARAM = 0x05;
+
+// Parameters for CMD_SET_PARAM, CMD_GET_PARAM and FRAME_PARAM
+export const PARAM_WPM = 0x01;
+export const PARAM_DEBOUNCE = 0x02;
+export const PARAM_DECODE = 0x03;
+export const PARAM_DECODE_REGION = 0x04;
+export const PARAM_SIDETONE = 0x05;
+export const PARAM_SIDETONE_HZ = 0x06;
+export const PARAM_KEY_OUTPUT = 0x07;
+export const PARAM_PTT_LEAD = 0x08;
+export const PARAM_PTT_TAIL = 0x09;
+export const PARAM_PTT_HANG = 0x0A;
+export const PARAM_WEIGHTING = 0x0B;
+export const PARAM_DAH_RATIO = 0x0C;
+export const PARAM_KEY_MODE = 0x0D;
+export const PARAM_TONE_DECODE = 0x0E;
+export const PARAM_TONE_HZ = 0x0F;
+
+// Regional tables for PARAM_DECODE_REGION, by alphabets.js country code.
+// The index is the region number in MorseTables.h.
+export const DECODE_REGIONS = [
+    'international', 'norway', 'sweden', 'sami-northern', 'sami-southern',
+    'ovdalian', 'germany', 'france', 'spain', 'denmark', 'finland', 'iceland',
+    'faroe', 'italy', 'poland', 'czech', 'russian', 'japanese-wabun'
+];
+
+// Gap kinds
+export const GAP_WORD = 2;
+
+// Capability bits
+export const CAP_KEY_EDGES = 0x0001;
+export const CAP_ELEMENTS = 0x0002;
+export const CAP_TIMING = 0x0004;
+export const CAP_TELEMETRY = 0x0008;
+export const CAP_CHARACTERS = 0x0010;
+export const CAP_SIDETONE = 0x0020;
+export const CAP_RECORDER = 0x0040;
+export const CAP_KEY_OUTPUT = 0x0080;
+export const CAP_SAVED_PARAMS = 0x0100;
+export const CAP_SLEEP = 0x0200;
+export const CAP_TONE_DECODE = 0x0400;
+
+// Stack headroom reported by boards that do not measure it
+export const STACK_HEADROOM_UNKNOWN = 0xFFFF;
+
+// Frames longer than this are line noise or text from a rebooted device
+const MAX_ENCODED_FRAME = 64;
+
+export const KEY_MODES = ['PADDLE_IAMBIC_A', 'PADDLE_IAMBIC_B', 'STRAIGHT_KEY', 'BUG'];
+
+// FRAME_KEY_EDGE contacts: the paddles, and tones decoded from receiver audio
+const CONTACTS = ['dot', 'dash', 'tone'];
+
+// Keying recorder records: contact, level and the low 30 bits of micros()
+const RECORD_DASH_BIT = 0x80000000;
+const RECORD_DOWN_BIT = 0x40000000;
+const RECORD_TIME_MASK = 0x3FFFFFFF;
+
+const utf8Decoder = new TextDecoder();
+
+/**
+ * CRC-16/CCITT-FALSE over part of a byte array
+ * @param {Uint8Array} bytes - Data to checksum
+ * @param {number} start - First byte
+ * @param {number} end - One past the last byte
+ * @returns {number} - The CRC
+ */
+export function crc16(bytes, start = 0, end = bytes.length) {
+    let crc = 0xFFFF;
+    for (let i = start; i < end; i++) {
+        crc ^= bytes[i] << 8;
+        for (let bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) & 0xFFFF : (crc << 1) & 0xFFFF;
+        }
+    }
+    return crc;
+}
+
+/**
+ * Build a complete frame ready to write to the device,
+ * including the leading and trailing delimiters
+ * @param {number} type - Command type
+ * @param {Array<number>} body - Body bytes
+ * @returns {Uint8Array} - Encoded frame
+ */
+export function encodeFrame(type, body = []) {
+    const raw = new Uint8Array(body.length + 3);
+    raw[0] = type;
+    raw.set(body, 1);
+    const crc = crc16(raw, 0, body.length + 1);
+    raw[body.length + 1] = crc & 0xFF;
+    raw[body.length + 2] = crc >> 8;
+
+    // COBS encode between two delimiters
+    const out = new Uint8Array(raw.length + Math.ceil(raw.length / 254) + 3);
+    let outIndex = 1;
+    let codeIndex = outIndex++;
+    let code = 1;
+    for (let i = 0; i < raw.length; i++) {
+        if (raw[i] === 0) {
+            out[codeIndex] = code;
+            codeIndex = outIndex++;
+            code = 1;
+        } else {
+            out[outIndex++] = raw[i];
+            code++;
+            if (code === 0xFF) {
+                out[codeIndex] = code;
+                codeIndex = outIndex++;
+                code = 1;
+            }
+        }
+    }
+    out[codeIndex] = code;
+    out[outIndex++] = 0;
+    return out.subarray(0, outIndex);
+}
+
+/**
+ * Build the capability handshake sent at connect
+ * @returns {Uint8Array} - Encoded CMD_HELLO frame
+ */
+export function helloFrame() {
+    return encodeFrame(CMD_HELLO, [PROTOCOL_VERSION]);
+}
+
+/**
+ * Build a command setting one keyer parameter
+ * @param {number} param - PARAM_* identifier
+ * @param {number} value - New value (u16)
+ * @returns {Uint8Array} - Encoded CMD_SET_PARAM frame
+ */
+export function setParamFrame(param, value) {
+    return encodeFrame(CMD_SET_PARAM, [param, value & 0xFF, (value >> 8) & 0xFF]);
+}
+
+/**
+ * Build a request for the keyer's loop and latency figures
+ * @returns {Uint8Array} - Encoded CMD_TELEMETRY frame
+ */
+export function telemetryRequestFrame() {
+    return encodeFrame(CMD_TELEMETRY);
+}
+
+/**
+ * Build a request for the keyer's recording of its last paddle edges
+ * @returns {Uint8Array} - Encoded CMD_RECORDING frame
+ */
+export function recordingRequestFrame() {
+    return encodeFrame(CMD_RECORDING);
+}
+
+/**
+ * Incremental decoder for the device byte stream
+ */
+export class FrameDecoder {
+    /**
+     * @param {Function} onEvent - Called with each decoded event object
+     */
+    constructor(onEvent) {
+        this.onEvent = onEvent;
+        this.encoded = new Uint8Array(MAX_ENCODED_FRAME);
+        this.decoded = new Uint8Array(MAX_ENCODED_FRAME);
+        this.length = 0;
+        this.overflow = false;
+        this.badFrames = 0;
+    }
+
+    /**
+     * Feed received bytes
+     * @param {Uint8Array} bytes - Bytes from the serial port
+     */
+    push(bytes) {
+        for (let i = 0; i < bytes.length; i++) {
+            const byte = bytes[i];
+            if (byte !== 0) {
+                if (this.length < MAX_ENCODED_FRAME) {
+                    this.encoded[this.length++] = byte;
+                } else {
+                    this.overflow = true;
+                }
+                continue;
+            }
+
+            if (this.length > 0) {
+                if (this.overflow || !this.decodeFrame()) {
+                    this.badFrames++;
+                }
+            }
+            this.length = 0;
+            this.overflow = false;
+        }
+    }
+
+    /**
+     * COBS-decode the collected bytes, verify the CRC and emit the event
+     * @returns {boolean} - True if the frame was valid
+     */
+    decodeFrame() {
+        const encoded = this.encoded;
+        const decoded = this.decoded;
+        let inIndex = 0;
+        let outIndex = 0;
+        while (inIndex < this.length) {
+            const code = encoded[inIndex++];
+            if (inIndex + code - 1 > this.length) return false;
+            for (let i = 1; i < code; i++) {
+                decoded[outIndex++] = encoded[inIndex++];
+            }
+            if (code < 0xFF && inIndex < this.length) {
+                decoded[outIndex++] = 0;
+            }
+        }
+        if (outIndex < 3) return false;
+
+        const expected = decoded[outIndex - 2] | (decoded[outIndex - 1] << 8);
+        if (crc16(decoded, 0, outIndex - 2) !== expected) return false;
+
+        const event = parseFrame(decoded, outIndex - 2);
+        if (event) {
+            this.onEvent(event);
+        }
+        return true;
+    }
+}
+
+/**
+ * Rebuild a pattern from its node in the firmware's Morse tree, where the
+ * root is 1, a dit moves from n to 2n and a dah to 2n + 1
+ * @param {number} node - Tree node, 0 for a pattern too long for the tree
+ * @returns {string} - The pattern of '.' and '-'
+ */
+function patternFromNode(node) {
+    let pattern = '';
+    for (; node > 1; node >>= 1) {
+        pattern = (node & 1 ? '-' : '.') + pattern;
+    }
+    return pattern;
+}
+
+/**
+ * Turn a verified frame into an event object
+ * @param {Uint8Array} frame - Decoded frame without CRC
+ * @param {number} length - Frame length
+ * @returns {Object|null} - The event, or null for unknown types
+ */
+function parseFrame(frame, length) {
+    const view = new DataView(frame.buffer, frame.byteOffset, length);
+    switch (frame[0]) {
+        case FRAME_HELLO:
+            return {
+                type: 'hello',
+                version: frame[1],
+                capabilities: view.getUint16(2, true),
+                mode: KEY_MODES[frame[4]] || null
+            };
+        case FRAME_TEXT:
+            return {
+                type: 'text',
+                text: String.fromCharCode.apply(null, frame.subarray(1, length))
+            };
+        case FRAME_KEY_EDGE:
+            return {
+                type: 'edge',
+                contact: CONTACTS[frame[1]] || 'dash',
+                down: frame[2] === 1,
+                micros: view.getUint32(3, true)
+            };
+        case FRAME_ELEMENT:
+            return {
+                type: 'element',
+                element: String.fromCharCode(frame[1]),
+                micros: view.getUint32(2, true),
+                duration: view.getUint16(6, true)
+            };
+        case FRAME_GAP:
+            return {
+                type: 'gap',
+                kind: frame[1] === GAP_WORD ? 'word' : 'character',
+                micros: view.getUint32(2, true)
+            };
+        case FRAME_MODE:
+            return {
+                type: 'mode',
+                mode: KEY_MODES[frame[1]] || null
+            };
+        case FRAME_TIMING:
+            return {
+                type: 'timing',
+                ditMs: view.getUint16(1, true),
+                wpm: frame[3]
+            };
+        case FRAME_TELEMETRY:
+            return {
+                type: 'telemetry',
+                loopsPerSecond: view.getUint32(1, true),
+                maxLoopMicros: view.getUint32(5, true),
+                latencyP50Micros: view.getUint32(9, true),
+                latencyP90Micros: view.getUint32(13, true),
+                latencyP99Micros: view.getUint32(17, true),
+                latencyMaxMicros: view.getUint32(21, true),
+                txHighWater: view.getUint16(25, true),
+                txSize: view.getUint16(27, true),
+                txOverflows: view.getUint16(29, true),
+                droppedEdges: view.getUint16(31, true),
+                droppedEvents: view.getUint16(33, true),
+                badFrames: view.getUint16(35, true),
+                watchdogTimeoutMs: view.getUint16(37, true),
+                watchdogWorstGapMs: view.getUint16(39, true),
+                // Older firmware has no scheduler figures
+                deadlineMisses: length >= 47 ? view.getUint16(41, true) : 0,
+                worstLatenessMicros: length >= 47 ? view.getUint32(43, true) : 0,
+                stackHeadroomBytes: length >= 49 ? view.getUint16(47, true) : STACK_HEADROOM_UNKNOWN
+            };
+        case FRAME_CHARACTER:
+            return {
+                type: 'character',
+                pattern: patternFromNode(frame[1]),
+                micros: view.getUint32(2, true),
+                text: utf8Decoder.decode(frame.subarray(6, length))
+            };
+        case FRAME_RECORDING:
+            return parseRecording(frame, view, length);
+        case FRAME_SLEEP:
+            return {
+                type: 'sleep',
+                sleeps: view.getUint16(1, true),
+                paddleWakes: view.getUint16(3, true),
+                lastWakeMicros: view.getUint32(5, true),
+                worstWakeMicros: view.getUint32(9, true)
+            };
+        case FRAME_PARAM:
+            return {
+                type: 'param',
+                param: frame[1],
+                value: view.getUint16(2, true)
+            };
+        default:
+            return null;
+    }
+}
+
+/**
+ * Turn one chunk of a keying recording into an event. Records carry only the
+ * low 30 bits of micros(), so full timestamps are rebuilt backwards from the
+ * micros() the chunk was sent at.
+ * @param {Uint8Array} frame - Decoded frame without CRC
+ * @param {DataView} view - View over the frame
+ * @param {number} length - Frame length
+ * @returns {Object} - The 'recording' event
+ */
+function parseRecording(frame, view, length) {
+    const sentMicros = view.getUint32(5, true);
+    const edges = [];
+    for (let offset = 13; offset + 4 <= length; offset += 4) {
+        const record = view.getUint32(offset, true);
+        const age = (sentMicros - record) & RECORD_TIME_MASK;
+        edges.push({
+            contact: (record & RECORD_DASH_BIT) !== 0 ? 'dash' : 'dot',
+            down: (record & RECORD_DOWN_BIT) !== 0,
+            micros: (sentMicros - age) >>> 0
+        });
+    }
+    return {
+        type: 'recording',
+        first: view.getUint16(1, true),
+        total: view.getUint16(3, true),
+        micros: sentMicros,
+        mode: KEY_MODES[frame[9]] || null,
+        configuredWpm: frame[10],
+        wpm: frame[11],
+        debounceMs: frame[12],
+        edges
+    };
+}
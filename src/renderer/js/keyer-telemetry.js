@@ -0,0 +1,136 @@
+/**
+ * keyer-telemetry.js
+ * Graphs the loop and latency figures reported by the keyer firmware
+ */
+
+import { STACK_HEADROOM_UNKNOWN } from './key-protocol.js';
+
+// Samples kept on the graph, one per telemetry request
+const HISTORY_LENGTH = 60;
+
+export class KeyerTelemetryView {
+    /**
+     * @param {HTMLCanvasElement} canvas - Graph of latency and loop time
+     * @param {HTMLElement} summary - Text summary of the latest sample
+     */
+    constructor(canvas, summary) {
+        this.canvas = canvas;
+        this.summary = summary;
+        this.history = [];
+        this.sleep = null;
+        this.serial = null;
+    }
+
+    /**
+     * Add a telemetry sample and redraw
+     * @param {Object} sample - 'telemetry' event from key-protocol.js
+     * @param {Object} serial - The app's serial batch counters over the same window
+     */
+    update(sample, serial = null) {
+        this.serial = serial;
+        this.history.push(sample);
+        if (this.history.length > HISTORY_LENGTH) {
+            this.history.shift();
+        }
+        this.draw();
+        this.describe(sample);
+    }
+
+    /**
+     * Add the sleep figures that follow a telemetry sample from a keyer
+     * that sleeps when idle
+     * @param {Object} sleep - 'sleep' event from key-protocol.js
+     */
+    updateSleep(sleep) {
+        this.sleep = sleep;
+        if (this.history.length > 0) {
+            this.describe(this.history[this.history.length - 1]);
+        }
+    }
+
+    /**
+     * Forget the history, e.g. when telemetry is switched off
+     */
+    clear() {
+        this.history = [];
+        this.sleep = null;
+        this.serial = null;
+        this.draw();
+        if (this.summary) {
+            this.summary.textContent = '';
+        }
+    }
+
+    /**
+     * Draw p99 edge-to-frame latency and the longest loop iteration,
+     * both in microseconds on a shared scale
+     */
+    draw() {
+        if (!this.canvas) return;
+
+        const ctx = this.canvas.getContext('2d');
+        const { width, height } = this.canvas;
+        ctx.clearRect(0, 0, width, height);
+        if (this.history.length === 0) return;
+
+        const peak = Math.max(1, ...this.history.map(s => Math.max(s.latencyP99Micros, s.maxLoopMicros)));
+        const step = width / (HISTORY_LENGTH - 1);
+        const style = getComputedStyle(this.canvas);
+
+        const plot = (key, color) => {
+            ctx.strokeStyle = color;
+            ctx.lineWidth = 2;
+            ctx.beginPath();
+            this.history.forEach((sample, i) => {
+                const x = i * step;
+                const y = height - (sample[key] / peak) * (height - 4) - 2;
+                if (i === 0) {
+                    ctx.moveTo(x, y);
+                } else {
+                    ctx.lineTo(x, y);
+                }
+            });
+            ctx.stroke();
+        };
+
+        plot('maxLoopMicros', style.getPropertyValue('--text-light').trim() || '#888');
+        plot('latencyP99Micros', style.getPropertyValue('--primary-color').trim() || '#36c');
+
+        ctx.fillStyle = style.getPropertyValue('--text-color').trim() || '#333';
+        ctx.font = '11px sans-serif';
+        ctx.fillText(`${peak} µs`, 4, 12);
+    }
+
+    /**
+     * Write the latest sample as text
+     * @param {Object} sample - 'telemetry' event
+     */
+    describe(sample) {
+        if (!this.summary) return;
+
+        const parts = [
+            `${sample.loopsPerSecond} loops/s`,
+            `max loop ${sample.maxLoopMicros} µs`,
+            `latency p50/p99 ${sample.latencyP50Micros}/${sample.latencyP99Micros} µs`,
+            `TX ${sample.txHighWater}/${sample.txSize} bytes`,
+            `drops ${sample.txOverflows + sample.droppedEdges + sample.droppedEvents}`
+        ];
+        if (sample.deadlineMisses > 0) {
+            parts.push(`deadline misses ${sample.deadlineMisses} (worst ${sample.worstLatenessMicros} µs late)`);
+        }
+        if (sample.stackHeadroomBytes !== STACK_HEADROOM_UNKNOWN) {
+            parts.push(`stack headroom ${sample.stackHeadroomBytes} bytes`);
+        }
+        if (sample.watchdogTimeoutMs > 0) {
+            parts.push(`watchdog margin ${sample.watchdogTimeoutMs - sample.watchdogWorstGapMs} ms`);
+        }
+        if (this.sleep && this.sleep.paddleWakes > 0) {
+            parts.push(`wake to key-down ${this.sleep.lastWakeMicros} µs (worst ${this.sleep.worstWakeMicros} µs, ${this.sleep.paddleWakes} wakes)`);
+        }
+        if (this.serial && this.serial.batches > 0) {
+            const { batches, chunks, largestBatch, meanDelayMs, maxDelayMs } = this.serial;
+            parts.push(`serial ${chunks} chunks in ${batches} batches (up to ${largestBatch}), queued ${meanDelayMs.toFixed(1)}/${maxDelayMs.toFixed(1)} ms mean/max`);
+        }
+        this.summary.textContent = parts.join(' · ');
+    }
+}
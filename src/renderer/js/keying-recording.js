@@ -0,0 +1,77 @@
+/**
+ * keying-recording.js
+ * Collects the keyer firmware's recording of its last paddle edges and
+ * writes it as a trace for arduino/host/keyer_replay
+ */
+
+// Mode letters used by keyer_replay traces, by key mode name
+const TRACE_MODES = {
+    PADDLE_IAMBIC_A: 'A',
+    PADDLE_IAMBIC_B: 'B',
+    STRAIGHT_KEY: 'K',
+    BUG: 'G'
+};
+
+// Time the replay keyer gets to start before the first edge
+const TRACE_LEAD_IN_MS = 100;
+
+export class KeyingRecording {
+    constructor() {
+        this.edges = [];
+        this.settings = null;
+        this.complete = false;
+    }
+
+    /**
+     * Add one chunk of the recording. Chunks arrive in order; one that does
+     * not follow on means the dump restarted.
+     * @param {Object} chunk - 'recording' event from key-protocol.js
+     * @returns {boolean} - True once every record has arrived
+     */
+    add(chunk) {
+        if (chunk.first !== this.edges.length) {
+            this.edges = [];
+            if (chunk.first !== 0) {
+                return false;
+            }
+        }
+        this.edges.push(...chunk.edges);
+        this.settings = chunk;
+        this.complete = this.edges.length >= chunk.total;
+        return this.complete;
+    }
+
+    /**
+     * The recording as a keyer_replay trace, timed from the first edge.
+     * Times are device micros(), so they do not depend on when the host
+     * read them.
+     * @param {string} description - Comment written at the top of the trace
+     * @returns {string} - Trace text
+     */
+    toTrace(description = '') {
+        const lines = [];
+        if (description) {
+            lines.push(`# ${description}`);
+        }
+        lines.push(`# ${this.edges.length} paddle edges recorded by the keyer firmware`);
+
+        const settings = this.settings;
+        if (settings) {
+            if (settings.configuredWpm === 0) {
+                lines.push(`# The keyer was following the operator, at ${settings.wpm} WPM when recorded`);
+            }
+            lines.push(`0       mode ${TRACE_MODES[settings.mode] || 'A'}`);
+            lines.push(`0       wpm ${settings.configuredWpm}`);
+            lines.push(`0       debounce ${settings.debounceMs}`);
+        }
+        lines.push('');
+
+        const start = this.edges.length > 0 ? this.edges[0].micros : 0;
+        for (const edge of this.edges) {
+            const ms = TRACE_LEAD_IN_MS + ((edge.micros - start) >>> 0) / 1000;
+            const time = Number.isInteger(ms) ? String(ms) : ms.toFixed(3);
+            lines.push(`${time.padEnd(8)}${edge.contact} ${edge.down ? 'down' : 'up'}`);
+        }
+        return lines.join('\n') + '\n';
+    }
+}
@@ -0,0 +1,151 @@
+/**
+ * serial-capture.js
+ * Reads serial session captures and replays them into ArduinoInterface
+ *
+ * The serial worker can write everything it reads from the keyer to a
+ * capture file, chunk by chunk as the port delivered it, with the time
+ * each was read. Replaying one feeds the same bytes through the same
+ * parsing and decoding as a live keyer, so a session from the field can
+ * be reproduced, and decoder throughput measured, without hardware.
+ *
+ * The format is little-endian and append-only:
+ *
+ *   header (20 bytes)
+ *     char[8]   'SMSERCAP'
+ *     uint32    version, 1
+ *     float64   when the capture started, in ms since the epoch
+ *   record, one per chunk (6 bytes + data)
+ *     uint32    microseconds since the previous record (or the start)
+ *     uint16    data length
+ *     uint8[]   the bytes read
+ *
+ * A capture cut short, e.g. by a crash, reads up to its last whole record.
+ */
+
+export const CAPTURE_MAGIC = 'SMSERCAP';
+export const CAPTURE_VERSION = 1;
+const HEADER_BYTES = 20;
+const RECORD_HEADER_BYTES = 6;
+
+// Longest a replay feeds chunks before letting the page run, at full speed
+const REPLAY_SLICE_MS = 50;
+
+// Local time in milliseconds, on the same clock as the serial worker's stamps
+const localNow = () => performance.timeOrigin + performance.now();
+
+/**
+ * Parse a capture file
+ * @param {Uint8Array} bytes - The file's contents
+ * @returns {Object} - { startedAt, chunks: [{ atMs, data }] }, times in ms
+ *     from the start of the capture and data as views into bytes
+ */
+export function parseSerialCapture(bytes) {
+    const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+    const magic = String.fromCharCode(...bytes.subarray(0, CAPTURE_MAGIC.length));
+    if (bytes.length < HEADER_BYTES || magic !== CAPTURE_MAGIC) {
+        throw new Error('Not a serial capture');
+    }
+    const version = view.getUint32(8, true);
+    if (version !== CAPTURE_VERSION) {
+        throw new Error(`Unsupported serial capture version ${version}`);
+    }
+
+    const startedAt = view.getFloat64(12, true);
+    const chunks = [];
+    let atMicros = 0;
+    let offset = HEADER_BYTES;
+    while (offset + RECORD_HEADER_BYTES <= bytes.length) {
+        const length = view.getUint16(offset + 4, true);
+        const start = offset + RECORD_HEADER_BYTES;
+        if (start + length > bytes.length) break;
+        atMicros += view.getUint32(offset, true);
+        chunks.push({ atMs: atMicros / 1000, data: bytes.subarray(start, start + length) });
+        offset = start + length;
+    }
+    return { startedAt, chunks };
+}
+
+export class SerialReplay {
+    /**
+     * @param {ArduinoInterface} arduino - Receives the chunks as if from the port
+     * @param {Object} capture - From parseSerialCapture()
+     */
+    constructor(arduino, capture) {
+        this.arduino = arduino;
+        this.capture = capture;
+        this.timer = null;
+        this.finish = null;
+        this.progress = null;
+    }
+
+    /**
+     * Feed the capture into the interface. Whatever the speed, each chunk
+     * is stamped as read at its captured time after the replay started, so
+     * elements are segmented exactly as in the session. The character left
+     * at the end is decoded when the replay finishes.
+     * @param {number} speed - 1 for the original pace, 2 for twice as fast,
+     *     Infinity for as fast as the decoder goes
+     * @returns {Promise<Object>} - Resolves when done or stopped with
+     *     { chunks, bytes, elapsedMs } fed
+     */
+    play(speed = 1) {
+        this.stop();
+        this.arduino.resetProtocol();
+
+        const { chunks } = this.capture;
+        const startMs = localNow();
+        const progress = { chunks: 0, bytes: 0, startMs };
+        this.progress = progress;
+
+        return new Promise((resolve) => {
+            this.finish = resolve;
+            const feed = () => {
+                this.timer = null;
+                const nowMs = localNow();
+                while (progress.chunks < chunks.length) {
+                    const { atMs, data } = chunks[progress.chunks];
+                    if (speed === Infinity) {
+                        // Yield now and then so the page keeps running
+                        if (localNow() - nowMs > REPLAY_SLICE_MS) {
+                            this.timer = setTimeout(feed, 0);
+                            return;
+                        }
+                    } else {
+                        const waitMs = startMs + atMs / speed - nowMs;
+                        if (waitMs > 0) {
+                            this.timer = setTimeout(feed, waitMs);
+                            return;
+                        }
+                    }
+                    this.arduino.handleSerialData(data, startMs + atMs);
+                    progress.chunks++;
+                    progress.bytes += data.length;
+                }
+                if (this.arduino.morseBuffer) {
+                    this.arduino.flushMorseBuffer();
+                }
+                this.done();
+            };
+            feed();
+        });
+    }
+
+    /**
+     * Stop a replay part way
+     */
+    stop() {
+        if (this.timer) {
+            clearTimeout(this.timer);
+            this.timer = null;
+        }
+        this.done();
+    }
+
+    done() {
+        if (!this.finish) return;
+        const finish = this.finish;
+        const { chunks, bytes, startMs } = this.progress;
+        this.finish = null;
+        finish({ chunks, bytes, elapsedMs: localNow() - startMs });
+    }
+}
@@ -0,0 +1,210 @@
+/**
+ * serial-lexer.js
+ * Streaming tokenizer for the MorseKeyer firmware's text mode
+ *
+ * Before the handshake the firmware talks plain text: status lines ending
+ * in CR LF, and elements and word spaces as single '.', '-' and ' ' bytes
+ * between them, with no line end. The lexer reads the bytes once as they
+ * arrive and calls back with a numeric token type and up to two numeric
+ * values, so elements, timing and mode changes cost no strings or objects.
+ * A line is kept in a fixed ring buffer until its end; only lines it does
+ * not recognise are decoded into a string.
+ *
+ * The 0x00 the firmware sends before switching to binary frames ends the
+ * text stream: push() stops right after it.
+ */
+
+import { KEY_MODES } from './key-protocol.js';
+
+// Token types passed to the callback, with their values
+export const TOKEN_ELEMENT = 1;  // char code of '.' or '-'
+export const TOKEN_GAP = 2;      // A word space
+export const TOKEN_TIMING = 3;   // wpm, dit in ms
+export const TOKEN_MODE = 4;     // KEY_MODES index
+export const TOKEN_PADDLE = 5;   // 1 pressed, 0 released (older firmware)
+export const TOKEN_READY = 6;    // The board has (re)booted
+export const TOKEN_TEXT = 7;     // Any other line, as a string
+export const TOKEN_BINARY = 8;   // Binary frames follow
+
+const DOT = 0x2E;
+const DASH = 0x2D;
+const SPACE = 0x20;
+const CR = 0x0D;
+const LF = 0x0A;
+const DIGIT_0 = 0x30;
+const DIGIT_9 = 0x39;
+
+// Longest line kept; longer ones are cut (firmware lines are under 64)
+const LINE_CAPACITY = 256;
+
+const ascii = (text) => Uint8Array.from(text, (c) => c.charCodeAt(0));
+const READY_LINE = ascii('Morse Decoder Ready');
+const TIMING_PREFIX = ascii('TIMING:WPM=');
+const DIT_PREFIX = ascii(',DIT=');
+const MODE_PREFIX = ascii('MODE:');
+const MODE_NAMES = KEY_MODES.map(ascii);
+const PADDLE_LINES = [
+    [ascii('left_paddle_pressed'), 1],
+    [ascii('right_paddle_pressed'), 1],
+    [ascii('left_paddle_released'), 0],
+    [ascii('right_paddle_released'), 0]
+];
+
+export class SerialLexer {
+    /**
+     * @param {Function} onToken - Called with (type, value, extra) for each token
+     */
+    constructor(onToken) {
+        this.onToken = onToken;
+        this.ring = new Uint8Array(LINE_CAPACITY);
+        this.scratch = new Uint8Array(LINE_CAPACITY);
+        this.textDecoder = new TextDecoder();
+        this.reset();
+    }
+
+    /**
+     * Forget any partial line, e.g. after a disconnect
+     */
+    reset() {
+        this.lineStart = 0;
+        this.lineLength = 0;
+        this.inLine = false;
+    }
+
+    /**
+     * Feed received bytes
+     * @param {Uint8Array} bytes - Bytes from the serial port
+     * @returns {number} - Bytes consumed: all of them, or up to and
+     *     including the 0x00 that switches to binary frames
+     */
+    push(bytes) {
+        for (let i = 0; i < bytes.length; i++) {
+            const byte = bytes[i];
+            if (byte === 0) {
+                if (this.inLine) this.endLine();
+                this.onToken(TOKEN_BINARY, 0, 0);
+                return i + 1;
+            }
+
+            if (this.inLine) {
+                if (byte === LF) {
+                    this.endLine();
+                } else if (byte !== CR) {
+                    this.store(byte);
+                }
+                continue;
+            }
+
+            // Between lines: elements and word spaces, or the start of a line
+            if (byte === DOT || byte === DASH) {
+                this.onToken(TOKEN_ELEMENT, byte, 0);
+            } else if (byte === SPACE) {
+                this.onToken(TOKEN_GAP, 0, 0);
+            } else if (byte !== CR && byte !== LF) {
+                this.inLine = true;
+                this.store(byte);
+            }
+        }
+        return bytes.length;
+    }
+
+    /**
+     * Append a byte to the current line, dropping what does not fit
+     */
+    store(byte) {
+        if (this.lineLength < LINE_CAPACITY) {
+            this.ring[(this.lineStart + this.lineLength) % LINE_CAPACITY] = byte;
+            this.lineLength++;
+        }
+    }
+
+    /**
+     * Classify the completed line and start the next after it
+     */
+    endLine() {
+        this.classifyLine();
+        this.lineStart = (this.lineStart + this.lineLength) % LINE_CAPACITY;
+        this.lineLength = 0;
+        this.inLine = false;
+    }
+
+    classifyLine() {
+        if (this.isLine(READY_LINE)) {
+            this.onToken(TOKEN_READY, 0, 0);
+            return;
+        }
+
+        if (this.startsWith(TIMING_PREFIX, 0)) {
+            let at = TIMING_PREFIX.length;
+            const wpm = this.numberAt(at);
+            at = this.skipDigits(at);
+            if (at > TIMING_PREFIX.length && this.startsWith(DIT_PREFIX, at)) {
+                const ditStart = at + DIT_PREFIX.length;
+                if (this.skipDigits(ditStart) === this.lineLength && ditStart < this.lineLength) {
+                    this.onToken(TOKEN_TIMING, wpm, this.numberAt(ditStart));
+                    return;
+                }
+            }
+        }
+
+        if (this.startsWith(MODE_PREFIX, 0)) {
+            for (let mode = 0; mode < MODE_NAMES.length; mode++) {
+                if (this.isLine(MODE_NAMES[mode], MODE_PREFIX.length)) {
+                    this.onToken(TOKEN_MODE, mode, 0);
+                    return;
+                }
+            }
+        }
+
+        for (const [line, pressed] of PADDLE_LINES) {
+            if (this.isLine(line)) {
+                this.onToken(TOKEN_PADDLE, pressed, 0);
+                return;
+            }
+        }
+
+        this.onToken(TOKEN_TEXT, this.lineText(), 0);
+    }
+
+    byteAt(index) {
+        return this.ring[(this.lineStart + index) % LINE_CAPACITY];
+    }
+
+    startsWith(pattern, offset) {
+        if (offset + pattern.length > this.lineLength) return false;
+        for (let i = 0; i < pattern.length; i++) {
+            if (this.byteAt(offset + i) !== pattern[i]) return false;
+        }
+        return true;
+    }
+
+    /**
+     * True if the line from offset on is exactly the pattern
+     */
+    isLine(pattern, offset = 0) {
+        return offset + pattern.length === this.lineLength && this.startsWith(pattern, offset);
+    }
+
+    skipDigits(at) {
+        while (at < this.lineLength && this.byteAt(at) >= DIGIT_0 && this.byteAt(at) <= DIGIT_9) at++;
+        return at;
+    }
+
+    numberAt(at) {
+        let value = 0;
+        for (const end = this.skipDigits(at); at < end; at++) {
+            value = value * 10 + (this.byteAt(at) - DIGIT_0);
+        }
+        return value;
+    }
+
+    /**
+     * The current line as a string, for lines that are not tokens of their own
+     */
+    lineText() {
+        for (let i = 0; i < this.lineLength; i++) {
+            this.scratch[i] = this.byteAt(i);
+        }
+        return this.textDecoder.decode(this.scratch.subarray(0, this.lineLength)).trim();
+    }
+}
@@ -15,7 +15,21 @@ export class SettingsManager {
             morseSpeed: 15,
             volume: -10, // Default volume in dB
             arduinoPort: '',
-            keyMode: 'A', // A = Iambic A, B = Iambic B
+            arduinoBaudRate: 9600, // Serial speed: the keyer sketch's BAUD_RATE (115200 on the Xiao ESP32-C6)
+            keyMode: 'A', // A = Iambic A, B = Iambic B, K = Straight key, G = Bug
+            keyerWpm: 0, // Paddle keyer speed on the Arduino (5-60), 0 = follow the operator
+            keyerDebounceMs: 5, // Paddle contact debounce on the Arduino in ms (1-50)
+            keyerWeighting: 50, // Percent of a dit and its space the Arduino keyer holds the key down (25-75)
+            keyerDahRatio: 3, // Dah length in dits on the Arduino keyer (2.0-4.5)
+            keyerDecoding: false, // Decode characters on the Arduino instead of after a pause
+            keyerDecodeRegion: 'international', // Regional table used by the Arduino decoder (alphabets.js country code)
+            keyerSidetone: false, // Sound the sidetone on the Arduino at toneFrequency instead of in the app
+            keyerKeyOutput: false, // Key a transmitter from the Arduino's keying output and PTT pins
+            keyerPttLeadMs: 10, // PTT lead before the first element in ms (0-50)
+            keyerPttTailMs: 100, // PTT hold after the last element in ms (0-1000)
+            keyerPttHangDits: 0, // Further PTT hold in dits at the keyer's speed (0-21)
+            keyerToneDecode: false, // Decode CW from receiver audio on the Arduino's ADC input
+            keyerTonePitch: 700, // Received tone pitch in Hz (300-1200)
             pauseThreshold: 1000, // Default pause threshold in ms (1 second)
             theme: 'light',
             maidenheadLocator: '',
@@ -142,6 +156,18 @@ export class SettingsManager {
         // Set Arduino settings if connected
         if (this.app.arduino && this.app.arduino.isConnected) {
             this.app.arduino.setKeyMode(this.settings.keyMode);
+            this.app.arduino.setKeyerSpeed(this.settings.keyerWpm);
+            this.app.arduino.setKeyerDebounce(this.settings.keyerDebounceMs);
+            this.app.arduino.setKeyerShape(this.settings.keyerWeighting, this.settings.keyerDahRatio);
+            this.app.arduino.setKeyerDecoding(this.settings.keyerDecoding, this.settings.keyerDecodeRegion);
+            this.app.arduino.setKeyerSidetone(this.settings.keyerSidetone, this.settings.toneFrequency);
+            this.app.arduino.setKeyerOutput(
+                this.settings.keyerKeyOutput,
+                this.settings.keyerPttLeadMs,
+                this.settings.keyerPttTailMs,
+                this.settings.keyerPttHangDits
+            );
+            this.app.arduino.setKeyerToneDecoding(this.settings.keyerToneDecode, this.settings.keyerTonePitch);
             
             // Apply pause threshold setting
             if (this.settings.pauseThreshold !== undefined) {
@@ -196,6 +222,57 @@ export class SettingsManager {
             patternRecognitionToggle.checked = this.settings.usePatternRecognition;
         }
         
+        // Set on-device decoding controls
+        const keyerDecodingToggle = document.getElementById('keyerDecodingEnabled');
+        const keyerDecodeRegionSelect = document.getElementById('keyerDecodeRegion');
+        if (keyerDecodingToggle) {
+            keyerDecodingToggle.checked = this.settings.keyerDecoding;
+        }
+        if (keyerDecodeRegionSelect) {
+            keyerDecodeRegionSelect.value = this.settings.keyerDecodeRegion;
+        }
+        
+        // Set on-device sidetone toggle
+        const keyerSidetoneToggle = document.getElementById('keyerSidetoneEnabled');
+        if (keyerSidetoneToggle) {
+            keyerSidetoneToggle.checked = this.settings.keyerSidetone;
+        }
+        
+        // Set keyer speed control
+        const keyerWpmInput = document.getElementById('keyerWpm');
+        if (keyerWpmInput) {
+            keyerWpmInput.value = this.settings.keyerWpm;
+        }
+        
+        // Set paddle debounce control
+        const keyerDebounceInput = document.getElementById('keyerDebounceMs');
+        if (keyerDebounceInput) {
+            keyerDebounceInput.value = this.settings.keyerDebounceMs;
+        }
+        
+        // Set keyer element shape controls
+        const keyerWeightingInput = document.getElementById('keyerWeighting');
+        if (keyerWeightingInput) {
+            keyerWeightingInput.value = this.settings.keyerWeighting;
+            document.getElementById('keyerDahRatio').value = this.settings.keyerDahRatio;
+        }
+        
+        // Set transmitter keying controls
+        const keyerKeyOutputToggle = document.getElementById('keyerKeyOutputEnabled');
+        if (keyerKeyOutputToggle) {
+            keyerKeyOutputToggle.checked = this.settings.keyerKeyOutput;
+            document.getElementById('keyerPttLeadMs').value = this.settings.keyerPttLeadMs;
+            document.getElementById('keyerPttTailMs').value = this.settings.keyerPttTailMs;
+            document.getElementById('keyerPttHangDits').value = this.settings.keyerPttHangDits;
+        }
+        
+        // Set receiver tone decoding controls
+        const keyerToneDecodeToggle = document.getElementById('keyerToneDecodeEnabled');
+        if (keyerToneDecodeToggle) {
+            keyerToneDecodeToggle.checked = this.settings.keyerToneDecode;
+            document.getElementById('keyerTonePitch').value = this.settings.keyerTonePitch;
+        }
+        
         // Set reduced group size toggle
         const reducedGroupSizeToggle = document.getElementById('useReducedGroupSize');
         if (reducedGroupSizeToggle) {
@@ -233,6 +310,12 @@ export class SettingsManager {
             serverAddressInput.value = this.settings.serverAddress || '';
         }
         
+        // Set serial speed
+        const baudRateSelect = document.getElementById('arduinoBaudRate');
+        if (baudRateSelect) {
+            baudRateSelect.value = String(this.settings.arduinoBaudRate);
+        }
+        
         // Populate Arduino port select
         this.populatePortSelect();
     }
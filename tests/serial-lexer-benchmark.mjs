@@ -0,0 +1,167 @@
+/**
+ * serial-lexer-benchmark.mjs
+ * Compare the text-mode serial path before and after the streaming lexer
+ *
+ * Usage: node --expose-gc tests/serial-lexer-benchmark.mjs
+ *
+ * The line path is the one arduino.js used before serial-lexer.js: decode
+ * each chunk to a string, append it to a buffer, split on newlines, then
+ * trim, classify and log every line. Both paths get the same bytes in two
+ * workloads:
+ *
+ *   sustained   60 WPM keying, one element per chunk as the port delivers
+ *               it, with a timing report every 50 elements
+ *   burst       a backlog of lines delivered in one large chunk
+ *
+ * For each it prints the time per chunk and the garbage collections the
+ * run needed, a measure of what it allocated. console.log is stubbed so
+ * only parsing counts.
+ */
+
+import { PerformanceObserver } from 'node:perf_hooks';
+import { SerialLexer, TOKEN_ELEMENT, TOKEN_GAP, TOKEN_TIMING, TOKEN_TEXT } from '../src/renderer/js/serial-lexer.js';
+
+const encoder = new TextEncoder();
+const log = console.log;
+const quiet = () => {};
+
+/**
+ * The line-splitting path, as arduino.js had it
+ */
+class LinePath {
+    constructor() {
+        this.buffer = '';
+        this.textDecoder = new TextDecoder();
+        this.morseBuffer = '';
+        this.timing = null;
+    }
+
+    push(data) {
+        this.buffer += this.textDecoder.decode(data, { stream: true });
+        const lines = this.buffer.split('\n');
+        this.buffer = lines.pop() || '';
+        lines.forEach(line => this.processLine(line.trim()));
+    }
+
+    processLine(line) {
+        if (!line) return;
+        console.log('Arduino:', {
+            data: line,
+            timestamp: new Date().toISOString(),
+            type: this.dataType(line),
+            description: this.description(line)
+        });
+        const timingMatch = /^TIMING:WPM=(\d+),DIT=(\d+)$/.exec(line);
+        if (timingMatch) {
+            this.timing = { wpm: Number(timingMatch[1]), ditMs: Number(timingMatch[2]) };
+            return;
+        }
+        if (line.startsWith('MODE:')) return;
+        if (/^[.\- ]+$/.test(line)) {
+            this.morseBuffer += line;
+            if (this.morseBuffer.length > 8) this.morseBuffer = '';
+        }
+    }
+
+    dataType(data) {
+        if (data.startsWith('MODE:')) return 'mode_setting';
+        if (data === 'Morse Decoder Ready') return 'status_message';
+        if (data.length === 1) return 'decoded_character';
+        if (/^[.\- ]+$/.test(data)) return 'morse_code';
+        return 'other';
+    }
+
+    description(data) {
+        if (data.startsWith('MODE:')) return `Arduino mode set to ${data.substring(5)}`;
+        if (data === 'Morse Decoder Ready') return 'Arduino device is ready for operation';
+        if (data.length === 1) return `Decoded Morse character: ${data}`;
+        if (/^[.\- ]+$/.test(data)) return `Morse code pattern: ${data}`;
+        return 'Other Arduino data';
+    }
+}
+
+/**
+ * The lexer path, doing the same work with the tokens
+ */
+class LexerPath {
+    constructor() {
+        this.morseBuffer = '';
+        this.timing = null;
+        this.lexer = new SerialLexer((type, value, extra) => {
+            if (type === TOKEN_ELEMENT) {
+                this.morseBuffer += String.fromCharCode(value);
+                if (this.morseBuffer.length > 8) this.morseBuffer = '';
+            } else if (type === TOKEN_GAP) {
+                this.morseBuffer = '';
+            } else if (type === TOKEN_TIMING) {
+                this.timing = { wpm: value, ditMs: extra };
+            } else if (type === TOKEN_TEXT) {
+                console.log('Arduino:', { data: value, timestamp: new Date().toISOString() });
+            }
+        });
+    }
+
+    push(data) {
+        this.lexer.push(data);
+    }
+}
+
+function sustainedChunks(count) {
+    const chunks = [];
+    for (let i = 0; i < count; i++) {
+        // An element every 20ms dit plus its gap at 60 WPM
+        chunks.push(encoder.encode(i % 3 === 0 ? '-\r\n' : '.\r\n'));
+        if (i % 50 === 49) chunks.push(encoder.encode('TIMING:WPM=60,DIT=20\r\n'));
+    }
+    return chunks;
+}
+
+function burstChunks(count) {
+    const lines = [];
+    for (let i = 0; i < 4096; i++) {
+        lines.push(i % 64 === 0 ? 'MODE:PADDLE_IAMBIC_B' : i % 16 === 0 ? 'TIMING:WPM=25,DIT=48' : i % 2 ? '-' : '.');
+    }
+    const burst = encoder.encode(lines.join('\r\n') + '\r\n');
+    return new Array(count).fill(burst);
+}
+
+function run(name, Path, chunks) {
+    const path = new Path();
+    console.log = quiet;
+    // Warm up, then measure
+    chunks.slice(0, 1000).forEach(chunk => path.push(chunk));
+
+    if (global.gc) global.gc();
+    let collections = 0;
+    const observer = new PerformanceObserver((list) => { collections += list.getEntries().length; });
+    observer.observe({ entryTypes: ['gc'] });
+
+    const start = process.hrtime.bigint();
+    for (const chunk of chunks) path.push(chunk);
+    const elapsed = Number(process.hrtime.bigint() - start);
+    console.log = log;
+
+    // GC entries arrive asynchronously
+    return new Promise(resolve => setTimeout(() => {
+        observer.disconnect();
+        log(`  ${name.padEnd(6)} ${(elapsed / chunks.length).toFixed(0).padStart(9)} ns/chunk  ${String(collections).padStart(5)} GCs`);
+        resolve();
+    }, 100));
+}
+
+async function main() {
+    if (!global.gc) {
+        log('(run with --expose-gc so each run starts with a clean heap)');
+    }
+    const sustained = sustainedChunks(200000);
+    log(`sustained 60 WPM, ${sustained.length} chunks`);
+    await run('lines', LinePath, sustained);
+    await run('lexer', LexerPath, sustained);
+
+    const burst = burstChunks(200);
+    log(`burst, ${burst.length} chunks of ${burst[0].length} bytes`);
+    await run('lines', LinePath, burst);
+    await run('lexer', LexerPath, burst);
+}
+
+main();
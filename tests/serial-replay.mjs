@@ -0,0 +1,67 @@
+/**
+ * serial-replay.mjs
+ * Replay a serial session capture through the app's decoder, without Electron
+ *
+ * Usage: node tests/serial-replay.mjs capture.smcap [speed]
+ *
+ * speed is 1 for the original pace (the default), a factor such as 4, or
+ * max to feed the capture as fast as the decoder takes it. Captures come
+ * from Serial Capture in the app's settings; the format is described in
+ * src/renderer/js/serial-capture.js.
+ *
+ * Prints the characters the decoder passed to the trainer, then how long
+ * the replay took and its throughput. The app's own logging is silenced.
+ */
+
+import { readFileSync } from 'node:fs';
+import { createRequire } from 'node:module';
+
+const [path, speedArgument = '1'] = process.argv.slice(2);
+if (!path) {
+    console.error('usage: node tests/serial-replay.mjs capture.smcap [speed|max]');
+    process.exit(2);
+}
+const speed = speedArgument === 'max' ? Infinity : Number(speedArgument);
+if (!(speed > 0)) {
+    console.error(`bad speed '${speedArgument}'`);
+    process.exit(2);
+}
+
+// Just enough of the page for ArduinoInterface: no port to write to, and
+// a trainer in a lesson that collects what is decoded
+let text = '';
+globalThis.window = {
+    electronAPI: {
+        onSerialData: () => () => {},
+        onSerialStatus: () => () => {},
+        sendSerial: async () => false,
+        getSerialStats: () => null
+    }
+};
+createRequire(import.meta.url)('../alphabets.js');
+const app = {
+    currentSection: 'training',
+    trainer: {
+        lessonActive: true,
+        handleUserInput: (char) => { text += char; }
+    }
+};
+
+const { ArduinoInterface } = await import('../src/renderer/js/arduino.js');
+const { SerialReplay, parseSerialCapture } = await import('../src/renderer/js/serial-capture.js');
+
+const capture = parseSerialCapture(new Uint8Array(readFileSync(path)));
+const arduino = new ArduinoInterface(app);
+
+const log = console.log;
+console.log = () => {};
+const result = await new SerialReplay(arduino, capture).play(speed);
+console.log = log;
+
+const sessionMs = capture.chunks.length ? capture.chunks[capture.chunks.length - 1].atMs : 0;
+console.log(path);
+console.log(`  captured ${new Date(capture.startedAt).toISOString()}, ${(sessionMs / 1000).toFixed(1)} s`);
+console.log(`  text: ${text}`);
+console.log(`  ${result.chunks} chunks, ${result.bytes} bytes in ${result.elapsedMs.toFixed(1)} ms` +
+    ` (${(result.chunks / result.elapsedMs * 1000).toFixed(0)} chunks/s, ${(result.bytes / result.elapsedMs / 1000).toFixed(2)} MB/s)`);
+process.exit(0);
@@ -2,11 +2,25 @@
  * serial-port-worker.js
  * Worker thread for Arduino serial port communication
  * Offloads device detection, reading and writing to a separate CPU core
+ *
+ * main.js runs all serial I/O through this worker. Received bytes are
+ * posted unparsed: the keyer mixes text lines with binary frames, so the
+ * renderer splits them. Chunks that arrive close together are sent as one
+ * batch, so a burst costs one message on each hop instead of one per chunk.
+ * A batch is one byte array holding the chunks back to back and a
+ * Float64Array of [end offset, receive time] pairs, one per chunk, both
+ * transferred to the main thread. A batch goes out BATCH_MAX_DELAY_MS
+ * after its first chunk at the latest, or as soon as it holds
+ * BATCH_MAX_BYTES.
  */
 
-const { parentPort, workerData } = require('worker_threads');
+const fs = require('fs');
+const { parentPort } = require('worker_threads');
 const { SerialPort } = require('serialport');
-const { ReadlineParser } = require('@serialport/parser-readline');
+
+// Latency bound on received data, and the batch size that sends at once
+const BATCH_MAX_DELAY_MS = 4;
+const BATCH_MAX_BYTES = 4096;
 
 // Track active connections
 const activeConnections = new Map();
@@ -20,6 +34,13 @@ let lastError = null;
 // Flag to control automatic reconnection attempts
 let autoReconnect = true;
 
+// Session capture in progress: { stream, path, lastAt, chunks, bytes }.
+// The file format is described in src/renderer/js/serial-capture.js.
+let capture = null;
+const CAPTURE_MAGIC = 'SMSERCAP';
+const CAPTURE_VERSION = 1;
+const CAPTURE_MAX_CHUNK = 0xFFFF;
+
 // Handle messages from the main thread
 parentPort.on('message', async (message) => {
   const { type, data, id } = message;
@@ -41,7 +62,7 @@ parentPort.on('message', async (message) => {
         break;
         
       case 'write':
-        result = writeToPort(data.port, data.data);
+        result = await writeToPort(data.port, data.data);
         break;
         
       case 'get_connection_status':
@@ -53,6 +74,14 @@ parentPort.on('message', async (message) => {
         result = { autoReconnect };
         break;
         
+      case 'start_capture':
+        result = startCapture(data.path);
+        break;
+        
+      case 'stop_capture':
+        result = await stopCapture();
+        break;
+        
       case 'get_error':
         result = { error: lastError };
         lastError = null; // Clear after reading
@@ -116,8 +145,15 @@ async function listPorts() {
  */
 async function connectToPort(portPath, options = {}) {
   try {
-    // Check if already connected
+    // Check if already connected, switching the baud rate if it changed
     if (activeConnections.has(portPath)) {
+      const connection = activeConnections.get(portPath);
+      if (options.baudRate && options.baudRate !== connection.options.baudRate) {
+        await new Promise((resolve, reject) => {
+          connection.port.update({ baudRate: options.baudRate }, err => err ? reject(err) : resolve());
+        });
+        connection.options.baudRate = options.baudRate;
+      }
       return { 
         success: true, 
         message: `Already connected to ${portPath}`,
@@ -146,18 +182,15 @@ async function connectToPort(portPath, options = {}) {
       autoOpen: false // We'll handle opening manually
     });
     
-    // Create line parser
-    const parser = port.pipe(new ReadlineParser({ delimiter: '\r\n' }));
-    
     // Set up event handlers
     const connection = {
       port,
-      parser,
       isOpen: false,
       lastData: null,
       lastError: null,
       buffer: [],
-      options: connectionOptions
+      options: connectionOptions,
+      batch: { chunks: [], bytes: 0, timer: null }
     };
     
     // Connect event handlers
@@ -211,14 +244,19 @@ async function connectToPort(portPath, options = {}) {
  * @param {Object} connection - Connection object
  */
 function setupEventHandlers(portPath, connection) {
-  const { port, parser } = connection;
+  const { port } = connection;
   
   // Handle data received
-  parser.on('data', data => {
+  port.on('data', data => {
+    // Stamped to a fraction of a millisecond, on the same clock as the
+    // renderer's performance.timeOrigin + performance.now(), so the app can
+    // time text-mode elements by when they were read
+    const receivedAt = performance.timeOrigin + performance.now();
+    
     // Store in connection
-    connection.lastData = data;
+    connection.lastData = new Uint8Array(data.subarray(-64));
     connection.buffer.push({
-      data,
+      length: data.length,
       timestamp: Date.now()
     });
     
@@ -227,13 +265,19 @@ function setupEventHandlers(portPath, connection) {
       connection.buffer.shift();
     }
     
-    // Notify main thread
-    parentPort.postMessage({
-      type: 'data_received',
-      port: portPath,
-      data: data,
-      timestamp: Date.now()
-    });
+    if (capture) {
+      captureChunk(data, receivedAt);
+    }
+    
+    // The stream's buffer is only borrowed; the batch copies it out when it is sent
+    const { batch } = connection;
+    batch.chunks.push({ data, receivedAt });
+    batch.bytes += data.length;
+    if (batch.bytes >= BATCH_MAX_BYTES) {
+      sendBatch(portPath, connection);
+    } else if (!batch.timer) {
+      batch.timer = setTimeout(() => sendBatch(portPath, connection), BATCH_MAX_DELAY_MS);
+    }
   });
   
   // Handle errors
@@ -289,6 +333,7 @@ function setupEventHandlers(portPath, connection) {
   // Handle close
   port.on('close', () => {
     connection.isOpen = false;
+    sendBatch(portPath, connection);
     
     // Notify main thread
     parentPort.postMessage({
@@ -311,6 +356,113 @@ function setupEventHandlers(portPath, connection) {
   });
 }
 
+/**
+ * Pack the chunks received since the last batch and post them to the main thread
+ * @param {string} portPath - Path to the serial port
+ * @param {Object} connection - Connection object
+ */
+function sendBatch(portPath, connection) {
+  const { batch } = connection;
+  if (batch.timer) {
+    clearTimeout(batch.timer);
+    batch.timer = null;
+  }
+  if (batch.chunks.length === 0) return;
+  
+  const data = new Uint8Array(batch.bytes);
+  const chunks = new Float64Array(2 * batch.chunks.length);
+  let offset = 0;
+  batch.chunks.forEach((chunk, i) => {
+    data.set(chunk.data, offset);
+    offset += chunk.data.length;
+    chunks[2 * i] = offset;
+    chunks[2 * i + 1] = chunk.receivedAt;
+  });
+  
+  batch.chunks = [];
+  batch.bytes = 0;
+  
+  parentPort.postMessage({
+    type: 'data_received',
+    port: portPath,
+    data,
+    chunks,
+    timestamp: Date.now()
+  }, [data.buffer, chunks.buffer]);
+}
+
+/**
+ * Start writing every received chunk to a capture file, replacing it
+ * @param {string} path - File to write
+ * @returns {Object} - Capture result
+ */
+function startCapture(path) {
+  if (capture) {
+    throw new Error(`Already capturing to ${capture.path}`);
+  }
+  
+  const startedAt = performance.timeOrigin + performance.now();
+  const header = Buffer.alloc(20);
+  header.write(CAPTURE_MAGIC, 0, 'latin1');
+  header.writeUInt32LE(CAPTURE_VERSION, 8);
+  header.writeDoubleLE(startedAt, 12);
+  
+  const stream = fs.createWriteStream(path);
+  stream.on('error', error => {
+    console.error(`Serial capture error (${path}):`, error);
+    lastError = error.message;
+    capture = null;
+  });
+  stream.write(header);
+  capture = { stream, path, lastAt: startedAt, chunks: 0, bytes: 0 };
+  return { success: true, path };
+}
+
+/**
+ * Append a chunk to the capture: microseconds since the previous one, its
+ * length, then its bytes
+ * @param {Buffer} data - Bytes as read from the port
+ * @param {number} receivedAt - When they were read, in ms
+ */
+function captureChunk(data, receivedAt) {
+  const deltaMicros = Math.min(Math.max(Math.round((receivedAt - capture.lastAt) * 1000), 0), 0xFFFFFFFF);
+  // Longer chunks are split, the rest of the pieces 0 microseconds apart
+  for (let start = 0; start < data.length; start += CAPTURE_MAX_CHUNK) {
+    const piece = data.subarray(start, start + CAPTURE_MAX_CHUNK);
+    const record = Buffer.alloc(6 + piece.length);
+    record.writeUInt32LE(start === 0 ? deltaMicros : 0, 0);
+    record.writeUInt16LE(piece.length, 4);
+    piece.copy(record, 6);
+    capture.stream.write(record);
+  }
+  // Advance by the delta written, so rounding does not add up
+  capture.lastAt += deltaMicros / 1000;
+  capture.chunks++;
+  capture.bytes += data.length;
+}
+
+/**
+ * Finish the capture file
+ * @returns {Promise<Object>} - The file and what it holds
+ */
+function stopCapture() {
+  if (!capture) {
+    return Promise.resolve({ success: false, message: 'Not capturing' });
+  }
+  
+  const { stream, path, chunks, bytes } = capture;
+  capture = null;
+  return new Promise((resolve, reject) => {
+    stream.end(error => {
+      if (error) {
+        reject(new Error(`Failed to finish ${path}: ${error.message}`));
+      } else {
+        resolve({ success: true, path, chunks, bytes });
+      }
+    });
+  });
+}
+
 /**
  * Disconnect from a serial port
  * @param {string} portPath - Path to the serial port
@@ -329,7 +481,8 @@ function disconnectFromPort(portPath) {
     
     const connection = activeConnections.get(portPath);
     
-    // Close the port
+    // Deliver what has arrived, then close the port
+    sendBatch(portPath, connection);
     if (connection.port && connection.port.isOpen) {
       connection.port.close();
     }
@@ -371,8 +524,8 @@ function writeToPort(portPath, data) {
         return;
       }
       
-      // Write data to the port
-      connection.port.write(data, error => {
+      // Write data to the port; binary frames arrive as a Uint8Array
+      connection.port.write(typeof data === 'string' ? data : Buffer.from(data), error => {
         if (error) {
           reject(new Error(`Failed to write to ${portPath}: ${error.message}`));
         } else {
@@ -384,7 +537,7 @@ function writeToPort(portPath, data) {
               resolve({ 
                 success: true, 
                 message: `Data written to ${portPath}`,
-                bytesWritten: Buffer.isBuffer(data) ? data.length : String(data).length
+                bytesWritten: typeof data === 'string' ? Buffer.byteLength(data) : data.length
               });
             }
           });